@@ -0,0 +1,405 @@
+#include <string.h>
+
+#include "action_engine.h"
+#include "latency.h"
+
+// What a pressed key has to undo when it is released
+enum
+{
+  HELD_NONE = 0,
+  HELD_CHORD,    // release step
+  HELD_LAYER,    // momentary heldLayer
+  HELD_ONESHOT,  // one-shot heldLayer, gone now if it was used while held
+};
+
+// Looks up the action of every key on the active layers, once per change
+static void update_layers(ActionEngine *e)
+{
+  ActionTable const *t = e->table;
+  uint8_t active = 1 | e->toggled | e->oneShot;
+  for (int layer = 0; layer < KEYMAP_MAX_LAYERS; layer++)
+  {
+    if (e->momentary[layer])
+      active |= 1u << layer;
+  }
+  if (active == e->active)
+    return;
+  e->active = active;
+
+  for (int key = 0; key < t->keyCount; key++)
+  {
+    KeymapAction const *action = NULL;
+    for (int layer = t->layerCount - 1; layer >= 0 && !action; layer--)
+    {
+      KeymapAction const *a = &t->actions[layer * t->keyCount + key];
+      if ((active & (1u << layer)) && a->type != KEYMAP_ACTION_TRANSPARENT)
+        action = a;
+    }
+    e->resolved[key] = action;
+  }
+}
+
+static ActionStep *emit(ActionEngine *e, uint8_t key, bool pressed, uint8_t const *keyCode, size_t codeLen,
+                        uint16_t macro, uint32_t timeUs)
+{
+  if (e->stepCount == ACTION_STEPS)
+  {
+    e->stepsLost++;
+    return NULL;
+  }
+
+  ActionStep &s = e->steps[(e->stepHead + e->stepCount++) % ACTION_STEPS];
+  s.key = key;
+  s.pressed = pressed;
+  memset(s.keyCode, 0, sizeof(s.keyCode));
+  if (keyCode)
+    memcpy(s.keyCode, keyCode, codeLen);
+  s.macro = macro;
+  s.profile = 0;
+  s.usagePage = 0;
+  s.usage = 0;
+  s.timeUs = timeUs;
+  return &s;
+}
+
+static void hold_layer(ActionEngine *e, uint8_t key, uint8_t layer)
+{
+  e->held[key] = HELD_LAYER;
+  e->heldLayer[key] = layer;
+  e->momentary[layer]++;
+  update_layers(e);
+}
+
+static void press_action(ActionEngine *e, uint8_t key, KeymapAction const *a, uint32_t timeUs)
+{
+  if (a->type != KEYMAP_ACTION_KEY && a->type != KEYMAP_ACTION_PROFILE && a->type != KEYMAP_ACTION_USAGE &&
+      a->layer >= KEYMAP_MAX_LAYERS)
+    return;
+
+  switch (a->type)
+  {
+  case KEYMAP_ACTION_KEY:
+    e->held[key] = HELD_CHORD;
+    emit(e, key, true, a->keyCode, KEYMAP_CHORD_LEN, a->macro, timeUs);
+    break;
+
+  case KEYMAP_ACTION_MOMENTARY:
+    hold_layer(e, key, a->layer);
+    break;
+
+  case KEYMAP_ACTION_TOGGLE:
+    e->toggled ^= 1u << a->layer;
+    update_layers(e);
+    break;
+
+  case KEYMAP_ACTION_ONESHOT:
+    e->held[key] = HELD_ONESHOT;
+    e->heldLayer[key] = a->layer;
+    e->oneShot = 1u << a->layer;
+    e->oneShotKey = key;
+    e->oneShotUsed = false;
+    update_layers(e);
+    break;
+
+  case KEYMAP_ACTION_PROFILE:
+  {
+    ActionStep *s = emit(e, key, true, NULL, 0, 0, timeUs);
+    if (s)
+      s->profile = a->layer + 1;
+    break;
+  }
+
+  case KEYMAP_ACTION_USAGE:
+  {
+    e->held[key] = HELD_CHORD;
+    ActionStep *s = emit(e, key, true, NULL, 0, 0, timeUs);
+    if (s)
+    {
+      s->usagePage = a->layer;
+      s->usage = keymap_action_usage(a);
+    }
+    break;
+  }
+  }
+}
+
+static void start_press(ActionEngine *e, ActionInput const &in)
+{
+  KeymapAction const *a = e->resolved[in.key];
+
+  // The next key press uses up a one-shot layer. Pressed while the one-shot
+  // key is still held, it lasts until that key is released instead.
+  if (e->oneShot && (!a || a->type != KEYMAP_ACTION_ONESHOT))
+  {
+    if (e->held[e->oneShotKey] == HELD_ONESHOT)
+    {
+      e->oneShotUsed = true;
+    }
+    else
+    {
+      e->oneShot = 0;
+      update_layers(e);
+    }
+  }
+
+  if (!a)
+    return;
+
+  if (a->type == KEYMAP_ACTION_TAP_HOLD)
+  {
+    e->pending = true;
+    e->pendingKey = in.key;
+    e->pendingUs = in.timeUs;
+    e->pendingTermUs = a->termMs ? a->termMs * 1000u : e->table->tapTermUs;
+    e->pendingAction = *a;
+    e->examined = 0;
+    return;
+  }
+  press_action(e, in.key, a, in.timeUs);
+}
+
+static void release(ActionEngine *e, ActionInput const &in)
+{
+  uint8_t const key = in.key;
+  switch (e->held[key])
+  {
+  case HELD_CHORD:
+    emit(e, key, false, NULL, 0, 0, in.timeUs);
+    break;
+
+  case HELD_LAYER:
+    e->momentary[e->heldLayer[key]]--;
+    update_layers(e);
+    break;
+
+  case HELD_ONESHOT:
+    if (e->oneShotKey == key && e->oneShotUsed)
+    {
+      e->oneShot = 0;
+      update_layers(e);
+    }
+    break;
+  }
+  e->held[key] = HELD_NONE;
+}
+
+static void decide(ActionEngine *e, bool hold, uint32_t timeUs)
+{
+  KeymapAction const *a = &e->pendingAction;
+  uint8_t const key = e->pendingKey;
+  e->pending = false;
+  latency_tap_hold(timeUs - e->pendingUs);
+
+  // The release that decided a tap is still buffered and ends the chord
+  if (!hold)
+  {
+    e->held[key] = HELD_CHORD;
+    emit(e, key, true, a->keyCode, KEYMAP_CHORD_LEN, a->macro, timeUs);
+  }
+  else if (a->holdCode[0])
+  {
+    e->held[key] = HELD_CHORD;
+    emit(e, key, true, a->holdCode, KEYMAP_HOLD_CHORD_LEN, 0, timeUs);
+  }
+  else if (a->layer < KEYMAP_MAX_LAYERS)
+  {
+    hold_layer(e, key, a->layer);
+  }
+}
+
+static ActionInput const &buffered(ActionEngine const *e, int index)
+{
+  return e->buffer[(e->bufferHead + index) % ACTION_BUFFER];
+}
+
+// Pressed after the undecided key, before buffered change index
+static bool pressed_since(ActionEngine const *e, uint8_t key, int index)
+{
+  for (int i = 0; i < index; i++)
+  {
+    if (buffered(e, i).key == key && buffered(e, i).pressed)
+      return true;
+  }
+  return false;
+}
+
+// Goes through the buffer as far as the undecided key allows
+static void run(ActionEngine *e)
+{
+  for (;;)
+  {
+    if (!e->pending)
+    {
+      if (!e->bufferCount)
+        return;
+      ActionInput const in = e->buffer[e->bufferHead];
+      e->bufferHead = (e->bufferHead + 1) % ACTION_BUFFER;
+      e->bufferCount--;
+
+      if (in.pressed)
+      {
+        if (e->held[in.key] != HELD_NONE)
+          release(e, in);
+        start_press(e, in);
+      }
+      else
+      {
+        release(e, in);
+      }
+      continue;
+    }
+
+    if (e->examined == e->bufferCount)
+      return;
+
+    ActionInput const &in = buffered(e, e->examined);
+    if ((int32_t)(in.timeUs - e->pendingUs) >= (int32_t)e->pendingTermUs)
+      decide(e, true, e->pendingUs + e->pendingTermUs);
+    else if (in.key == e->pendingKey && !in.pressed)
+      decide(e, false, in.timeUs);
+    else if (e->table->tapHoldMode == KEYMAP_TAP_HOLD_PRESS && in.pressed)
+      decide(e, true, in.timeUs);
+    else if (e->table->tapHoldMode == KEYMAP_TAP_HOLD_PERMISSIVE && !in.pressed && pressed_since(e, in.key, e->examined))
+      decide(e, true, in.timeUs);
+    else
+      e->examined++;
+  }
+}
+
+void action_table_load(ActionTable *t, KeymapImage const *keymap)
+{
+  KeymapHeader const &h = keymap->header;
+  t->keyCount = h.keyCount;
+  t->layerCount = h.layerCount;
+  memcpy(t->actions, keymap_actions(keymap), h.layerCount * h.keyCount * sizeof(KeymapAction));
+  t->macroLen = h.macroLen;
+  memcpy(t->macros, keymap_macros(keymap), h.macroLen);
+  t->tapHoldMode = h.tapHoldMode;
+  t->tapTermUs = (h.tapTermMs ? h.tapTermMs : KEYMAP_DEFAULT_TAP_TERM_MS) * 1000u;
+}
+
+void action_init(ActionEngine *e, ActionTable const *table)
+{
+  e->table = table;
+  action_reset(e);
+}
+
+void action_switch(ActionEngine *e, ActionTable const *table)
+{
+  e->table = table;
+  e->toggled = 0;
+  e->oneShot = 0;
+  e->oneShotUsed = false;
+
+  // Layers above the new table's stay active for keys holding them, the
+  // lookup ignores them
+  action_refresh(e);
+}
+
+void action_refresh(ActionEngine *e)
+{
+  e->active = 0;
+  update_layers(e);
+}
+
+void action_reset(ActionEngine *e)
+{
+  e->toggled = 0;
+  e->oneShot = 0;
+  e->oneShotUsed = false;
+  memset(e->momentary, 0, sizeof(e->momentary));
+  memset(e->held, HELD_NONE, sizeof(e->held));
+  memset(e->heldCode, 0, sizeof(e->heldCode));
+  memset(e->heldPage, 0, sizeof(e->heldPage));
+  e->pending = false;
+  e->bufferHead = e->bufferCount = 0;
+  e->stepHead = e->stepCount = 0;
+  e->stepsLost = 0;
+
+  e->active = 0;
+  update_layers(e);
+}
+
+void action_key(ActionEngine *e, uint8_t key, bool pressed, uint32_t timeUs)
+{
+  if (key >= e->table->keyCount)
+    return;
+
+  // Only an undecided key keeps changes in the buffer
+  while (e->bufferCount == ACTION_BUFFER && e->pending)
+  {
+    decide(e, true, timeUs);
+    run(e);
+  }
+
+  ActionInput &in = e->buffer[(e->bufferHead + e->bufferCount++) % ACTION_BUFFER];
+  in.key = key;
+  in.pressed = pressed;
+  in.timeUs = timeUs;
+  run(e);
+}
+
+void action_tick(ActionEngine *e, uint32_t nowUs)
+{
+  if (e->pending && (int32_t)(nowUs - e->pendingUs) >= (int32_t)e->pendingTermUs)
+  {
+    decide(e, true, e->pendingUs + e->pendingTermUs);
+    run(e);
+  }
+}
+
+bool action_next(ActionEngine *e, ActionStep *step)
+{
+  if (!e->stepCount)
+    return false;
+
+  *step = e->steps[e->stepHead];
+  e->stepHead = (e->stepHead + 1) % ACTION_STEPS;
+  e->stepCount--;
+
+  if (step->pressed)
+  {
+    memcpy(e->heldCode[step->key], step->keyCode, KEYMAP_CHORD_LEN);
+    e->heldPage[step->key] = step->usagePage;
+    e->heldUsage[step->key] = step->usage;
+  }
+  else
+  {
+    // The release says what it ends
+    memset(e->heldCode[step->key], 0, KEYMAP_CHORD_LEN);
+    step->usagePage = e->heldPage[step->key];
+    step->usage = e->heldUsage[step->key];
+    e->heldPage[step->key] = 0;
+  }
+  return true;
+}
+
+bool action_busy(ActionEngine const *e)
+{
+  return e->stepCount != 0;
+}
+
+void action_held(ActionEngine const *e, KeyboardState *state)
+{
+  for (int key = 0; key < KEYMAP_MAX_KEYS; key++)
+  {
+    if (!e->heldCode[key][0])
+      continue;
+    for (int i = 0; i < KEYMAP_CHORD_LEN; i++)
+      keyboard_state_add(state, e->heldCode[key][i]);
+  }
+}
+
+void action_held_usages(ActionEngine const *e, UsageState *state)
+{
+  for (int key = 0; key < KEYMAP_MAX_KEYS; key++)
+  {
+    if (e->heldPage[key])
+      usage_state_add(state, e->heldPage[key], e->heldUsage[key]);
+  }
+}
+
+uint8_t action_layers(ActionEngine const *e)
+{
+  return e->active;
+}
@@ -0,0 +1,148 @@
+#ifndef ACTION_ENGINE_H_
+#define ACTION_ENGINE_H_
+
+#include <stdint.h>
+
+#include "keymap.h"
+#include "keyboard_report.h"
+
+// Turns debounced key changes into what the keys do on the active layers.
+//
+// Layer 0 is always active. MO(n) keeps layer n active while held, TG(n)
+// switches it on or off, OSL(n) activates it for the next key press, or
+// like MO(n) when that key is pressed while OSL(n) is still held. A
+// transparent action falls through to the next active layer below. The
+// action of every key is looked up once whenever the active layers change,
+// so a press is a single table index. A key keeps the action of its press
+// until it is released, so switching layers never leaves a key stuck.
+//
+// A tap-hold key is undecided when pressed, the key changes after it wait
+// in a buffer until it is decided:
+//   released within the tapping term         tap
+//   held to the end of the term              hold
+//   permissive: another key pressed and released meanwhile   hold
+//   press: another key pressed meanwhile     hold
+// Decisions go by the edge timestamps, not by when they are made, so the
+// time a key waits is at most its tapping term. Each wait goes into the
+// "taphold" latency histogram.
+//
+// What comes out is a queue of steps, each one key starting or ending a
+// chord or macro, for one report per step.
+//
+// The actions come from an ActionTable, which can be swapped for another
+// one between key changes, see action_switch().
+
+// Key changes waiting behind an undecided tap-hold key. A full buffer
+// decides it as a hold.
+#define ACTION_BUFFER 16
+#define ACTION_STEPS (2 * ACTION_BUFFER + 8)
+
+// What the keys of one keymap do, with the macros they play
+struct ActionTable
+{
+  KeymapAction actions[KEYMAP_MAX_LAYERS * KEYMAP_MAX_KEYS];
+  uint8_t macros[KEYMAP_MACRO_BYTES];
+  uint16_t macroLen;
+  uint8_t keyCount;
+  uint8_t layerCount;
+  uint8_t tapHoldMode;
+  uint32_t tapTermUs;
+};
+
+// Copies what the keys of a sealed keymap do
+void action_table_load(ActionTable *t, KeymapImage const *keymap);
+
+struct ActionStep
+{
+  uint8_t key;
+  bool pressed;
+  uint8_t keyCode[KEYMAP_CHORD_LEN];  // chord held from now on, pressed only
+  uint16_t macro;     // macro to start, offset + 1, pressed only
+  uint8_t profile;    // profile to switch to + 1, pressed only
+  uint8_t usagePage;  // HidUsagePage of a media key, mouse or gamepad button
+  uint16_t usage;     // pressed or released, usagePage 0 for a chord
+  uint32_t timeUs;    // edge the step comes from
+};
+
+struct ActionInput
+{
+  uint8_t key;
+  bool pressed;
+  uint32_t timeUs;
+};
+
+struct ActionEngine
+{
+  ActionTable const *table;
+
+  // Layers
+  uint8_t toggled;
+  uint8_t oneShot;
+  uint8_t oneShotKey;
+  bool oneShotUsed;
+  uint8_t momentary[KEYMAP_MAX_LAYERS];  // held MO keys per layer
+  uint8_t active;
+  KeymapAction const *resolved[KEYMAP_MAX_KEYS];
+
+  // What each key does until it is released, see action_engine.cpp
+  uint8_t held[KEYMAP_MAX_KEYS];
+  uint8_t heldLayer[KEYMAP_MAX_KEYS];
+  uint8_t heldCode[KEYMAP_MAX_KEYS][KEYMAP_CHORD_LEN];  // as of the steps taken
+  uint8_t heldPage[KEYMAP_MAX_KEYS];
+  uint16_t heldUsage[KEYMAP_MAX_KEYS];
+
+  // Undecided tap-hold key and the changes after it
+  bool pending;
+  uint8_t pendingKey;
+  uint32_t pendingUs;
+  uint32_t pendingTermUs;
+  KeymapAction pendingAction;  // a copy, the table may change meanwhile
+  uint8_t examined;  // buffered changes checked against it
+  ActionInput buffer[ACTION_BUFFER];
+  uint8_t bufferHead;
+  uint8_t bufferCount;
+
+  ActionStep steps[ACTION_STEPS];
+  uint8_t stepHead;
+  uint8_t stepCount;
+  uint32_t stepsLost;
+};
+
+// All keys released, table stays in use until action_switch()
+void action_init(ActionEngine *e, ActionTable const *table);
+
+// Presses from now on use table. Keys held keep what they do until they
+// are released, toggled and one-shot layers are switched off. Only call it
+// while no steps wait, the previous table is unused afterwards.
+void action_switch(ActionEngine *e, ActionTable const *table);
+
+// Looks the actions up again after the table was changed in place. Keys
+// held keep what they do until they are released.
+void action_refresh(ActionEngine *e);
+
+// Every key released and the layers back to layer 0
+void action_reset(ActionEngine *e);
+
+// A debounced change of keymap key, in edge order
+void action_key(ActionEngine *e, uint8_t key, bool pressed, uint32_t timeUs);
+
+// Decides tap-hold keys whose tapping term ran out by nowUs. Only call it
+// once every change up to nowUs went into action_key().
+void action_tick(ActionEngine *e, uint32_t nowUs);
+
+// Takes the next step, false when there is none
+bool action_next(ActionEngine *e, ActionStep *step);
+
+// Steps waiting to be taken
+bool action_busy(ActionEngine const *e);
+
+// Chords of the keys as of the steps taken so far
+void action_held(ActionEngine const *e, KeyboardState *state);
+
+// Media keys, mouse and gamepad buttons as of the steps taken so far
+void action_held_usages(ActionEngine const *e, UsageState *state);
+
+// Mask of the active layers
+uint8_t action_layers(ActionEngine const *e);
+
+#endif /* ACTION_ENGINE_H_ */
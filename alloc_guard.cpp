@@ -0,0 +1,110 @@
+#include <new>
+#include <stdlib.h>
+
+#include "pico/stdlib.h"
+
+#include "alloc_guard.h"
+
+#ifndef PLICK_ALLOC_GUARD_PANIC
+#define PLICK_ALLOC_GUARD_PANIC 0
+#endif
+
+static volatile bool armed = false;
+static volatile uint32_t allocCount = 0;
+static volatile uint32_t violations = 0;
+
+static void count_alloc(size_t size)
+{
+  allocCount++;
+  if (armed)
+  {
+    violations++;
+#if PLICK_ALLOC_GUARD_PANIC
+    panic("heap allocation of %u bytes after start-up", (unsigned)size);
+#else
+    (void)size;
+#endif
+  }
+}
+
+// Every heap allocation ends up in newlib's reentrant allocator: malloc()
+// behind pico_malloc, stdio buffers and FatFs's ff_memalloc() through it,
+// operator new below. The link wraps these (see CMakeLists.txt), so they
+// are counted whoever calls them.
+extern "C"
+{
+void *__real__malloc_r(struct _reent *r, size_t size);
+void *__real__calloc_r(struct _reent *r, size_t count, size_t size);
+void *__real__realloc_r(struct _reent *r, void *p, size_t size);
+
+void *__wrap__malloc_r(struct _reent *r, size_t size)
+{
+  count_alloc(size);
+  return __real__malloc_r(r, size);
+}
+
+void *__wrap__calloc_r(struct _reent *r, size_t count, size_t size)
+{
+  count_alloc(count * size);
+  return __real__calloc_r(r, count, size);
+}
+
+void *__wrap__realloc_r(struct _reent *r, void *p, size_t size)
+{
+  count_alloc(size);
+  return __real__realloc_r(r, p, size);
+}
+}
+
+static void *checked_alloc(size_t size)
+{
+  void *p = malloc(size ? size : 1);
+  if (!p)
+    panic("out of memory");
+  return p;
+}
+
+void *operator new(size_t size)
+{
+  return checked_alloc(size);
+}
+
+void *operator new[](size_t size)
+{
+  return checked_alloc(size);
+}
+
+void operator delete(void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete[](void *p) noexcept
+{
+  free(p);
+}
+
+void operator delete(void *p, size_t) noexcept
+{
+  free(p);
+}
+
+void operator delete[](void *p, size_t) noexcept
+{
+  free(p);
+}
+
+void alloc_guard_arm(void)
+{
+  armed = true;
+}
+
+uint32_t alloc_guard_count(void)
+{
+  return allocCount;
+}
+
+uint32_t alloc_guard_violations(void)
+{
+  return violations;
+}
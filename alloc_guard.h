@@ -0,0 +1,16 @@
+#ifndef ALLOC_GUARD_H_
+#define ALLOC_GUARD_H_
+
+#include <stdint.h>
+
+// Counts heap allocations, C++ new as well as malloc(), calloc() and
+// realloc() from C code, newlib stdio and FatFs. Once armed at the end of
+// start-up, any further allocation is a violation: the key path must not
+// touch the heap.
+// Build with PLICK_ALLOC_GUARD_PANIC=1 to stop at the first one.
+
+void alloc_guard_arm(void);
+uint32_t alloc_guard_count(void);
+uint32_t alloc_guard_violations(void);
+
+#endif /* ALLOC_GUARD_H_ */
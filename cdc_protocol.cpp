@@ -0,0 +1,110 @@
+#include <string.h>
+
+#include "cdc_protocol.h"
+#include "crc32.h"
+
+enum
+{
+  STATE_SOF = 0,
+  STATE_TYPE,
+  STATE_SEQ,
+  STATE_LEN_LO,
+  STATE_LEN_HI,
+  STATE_PAYLOAD,
+  STATE_CRC,
+};
+
+static bool known_type(uint8_t type)
+{
+  return (type >= FRAME_BEGIN && type <= FRAME_END) || (type >= FRAME_ACK && type <= FRAME_RESULT);
+}
+
+void frame_decoder_init(FrameDecoder *d)
+{
+  d->state = STATE_SOF;
+  d->pos = 0;
+}
+
+FrameDecodeResult frame_decoder_push(FrameDecoder *d, uint8_t byte)
+{
+  switch (d->state)
+  {
+  case STATE_SOF:
+    if (byte == FRAME_SOF)
+    {
+      d->crc = CRC32_INIT;
+      d->state = STATE_TYPE;
+    }
+    return FRAME_NONE;
+
+  case STATE_TYPE:
+    if (!known_type(byte))
+    {
+      // Stray start byte, this one may be the real one
+      if (byte != FRAME_SOF)
+        d->state = STATE_SOF;
+      return FRAME_NONE;
+    }
+    d->frame.type = byte;
+    d->state = STATE_SEQ;
+    break;
+
+  case STATE_SEQ:
+    d->frame.seq = byte;
+    d->state = STATE_LEN_LO;
+    break;
+
+  case STATE_LEN_LO:
+    d->frame.len = byte;
+    d->state = STATE_LEN_HI;
+    break;
+
+  case STATE_LEN_HI:
+    d->frame.len |= byte << 8;
+    if (d->frame.len > FRAME_MAX_PAYLOAD)
+    {
+      // Not a real header, look for the next start byte
+      d->state = STATE_SOF;
+      return FRAME_ERROR;
+    }
+    d->pos = 0;
+    d->state = d->frame.len ? STATE_PAYLOAD : STATE_CRC;
+    break;
+
+  case STATE_PAYLOAD:
+    d->frame.payload[d->pos++] = byte;
+    if (d->pos == d->frame.len)
+    {
+      d->pos = 0;
+      d->state = STATE_CRC;
+    }
+    break;
+
+  case STATE_CRC:
+    d->crcBytes[d->pos++] = byte;
+    if (d->pos < 4)
+      return FRAME_NONE;
+
+    d->state = STATE_SOF;
+    d->pos = 0;
+    return crc32_final(d->crc) == get_u32le(d->crcBytes) ? FRAME_READY : FRAME_ERROR;
+  }
+
+  d->crc = crc32_update(d->crc, &byte, 1);
+  return FRAME_NONE;
+}
+
+size_t frame_encode(uint8_t *out, uint8_t type, uint8_t seq, void const *payload, uint16_t len)
+{
+  out[0] = FRAME_SOF;
+  out[1] = type;
+  out[2] = seq;
+  out[3] = len & 0xFF;
+  out[4] = len >> 8;
+  if (len)
+    memcpy(&out[FRAME_HEADER_LEN], payload, len);
+
+  uint32_t const crc = crc32(&out[1], FRAME_HEADER_LEN - 1 + len);
+  put_u32le(&out[FRAME_HEADER_LEN + len], crc);
+  return FRAME_OVERHEAD + len;
+}
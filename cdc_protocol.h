@@ -0,0 +1,93 @@
+#ifndef CDC_PROTOCOL_H_
+#define CDC_PROTOCOL_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Framed upload protocol over the CDC port, shared by the firmware and the
+// host uploader in tools/.
+//
+//   0xA5 | type | seq | len (u16) | payload[len] | crc32 (u32)
+//
+// Multi-byte fields are little endian, the CRC covers type to payload.
+// Anything between frames (e.g. log text) is skipped by the decoder.
+//
+// Upload: BEGIN(seq 0, u32 size), DATA(seq 1..) and END(u32 crc32 of the
+// whole file) from the host, each answered by ACK(next expected seq). The
+// host keeps up to FRAME_WINDOW frames unacknowledged. A frame out of order
+// or damaged gets one NAK(expected seq) and the host resends from there
+// (go-back-N). END is answered by RESULT(u8 status) once the file is stored.
+
+#define FRAME_SOF 0xA5
+#define FRAME_MAX_PAYLOAD 256
+#define FRAME_HEADER_LEN 5
+#define FRAME_OVERHEAD (FRAME_HEADER_LEN + 4)
+#define FRAME_MAX_LEN (FRAME_OVERHEAD + FRAME_MAX_PAYLOAD)
+#define FRAME_WINDOW 8
+
+enum FrameType : uint8_t
+{
+  // Host to device
+  FRAME_BEGIN = 0x01,
+  FRAME_DATA = 0x02,
+  FRAME_END = 0x03,
+
+  // Device to host
+  FRAME_ACK = 0x81,
+  FRAME_NAK = 0x82,
+  FRAME_RESULT = 0x83,
+};
+
+enum UploadStatus : uint8_t
+{
+  UPLOAD_OK = 0,
+  UPLOAD_ERR_STATE,    // DATA or END without BEGIN
+  UPLOAD_ERR_SIZE,     // received size differs from BEGIN
+  UPLOAD_ERR_CRC,      // file CRC differs from END
+  UPLOAD_ERR_STORAGE,  // SD card error
+};
+
+struct Frame
+{
+  uint8_t type;
+  uint8_t seq;
+  uint16_t len;
+  uint8_t payload[FRAME_MAX_PAYLOAD];
+};
+
+enum FrameDecodeResult
+{
+  FRAME_NONE = 0,   // need more bytes
+  FRAME_READY,      // frame holds a checked frame
+  FRAME_ERROR,      // a frame was damaged and dropped
+};
+
+struct FrameDecoder
+{
+  Frame frame;
+  uint8_t state;
+  uint16_t pos;
+  uint32_t crc;
+  uint8_t crcBytes[4];
+};
+
+void frame_decoder_init(FrameDecoder *d);
+FrameDecodeResult frame_decoder_push(FrameDecoder *d, uint8_t byte);
+
+// Writes one frame to out (at least FRAME_OVERHEAD + len bytes), returns its size
+size_t frame_encode(uint8_t *out, uint8_t type, uint8_t seq, void const *payload, uint16_t len);
+
+static inline void put_u32le(uint8_t *p, uint32_t v)
+{
+  p[0] = v;
+  p[1] = v >> 8;
+  p[2] = v >> 16;
+  p[3] = v >> 24;
+}
+
+static inline uint32_t get_u32le(uint8_t const *p)
+{
+  return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+#endif /* CDC_PROTOCOL_H_ */
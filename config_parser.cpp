@@ -0,0 +1,906 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "config_parser.h"
+#include "debounce.h"
+#include "hid_keycodes.h"
+#include "macro.h"
+
+static void report_error(ConfigParser *p, char const *message)
+{
+  p->errorCount++;
+  if (p->onError)
+    p->onError(p->errorContext, p->tokenLine, p->tokenColumn, message);
+}
+
+// Up to KEYMAP_CHORD_LEN key names joined by '+' into keyCode, unused
+// slots stay 0
+static bool parse_chord(ConfigParser *p, uint8_t *keyCode, char const *names, size_t len)
+{
+  int count = 0;
+  size_t start = 0;
+
+  for (size_t i = 0; i <= len; i++)
+  {
+    if (i < len && names[i] != '+')
+      continue;
+
+    if (i == start)
+    {
+      report_error(p, "empty key name");
+      return false;
+    }
+    if (count == KEYMAP_CHORD_LEN)
+    {
+      report_error(p, "more than 6 keys in one chord");
+      return false;
+    }
+
+    HidUsage usage;
+    if (!hid_usage_lookup(&names[start], i - start, &usage))
+    {
+      report_error(p, "unknown key name");
+      return false;
+    }
+    if (usage.page != HID_PAGE_KEYBOARD)
+    {
+      report_error(p, "media, mouse and gamepad keys go alone");
+      return false;
+    }
+
+    keyCode[count++] = (uint8_t)usage.code;
+    start = i + 1;
+  }
+  return true;
+}
+
+// A media key, mouse or gamepad button, never part of a chord
+static bool parse_usage(KeymapAction *action, char const *name, size_t len)
+{
+  HidUsage usage;
+  if (!hid_usage_lookup(name, len, &usage) || usage.page == HID_PAGE_KEYBOARD)
+    return false;
+  keymap_set_usage(action, usage.page, usage.code);
+  return true;
+}
+
+static bool emit(ConfigParser *p, uint8_t byte)
+{
+  if (p->macroLen == KEYMAP_MACRO_BYTES)
+  {
+    report_error(p, "macros too long");
+    return false;
+  }
+  p->keymap->macroSpace[p->macroLen++] = byte;
+  return true;
+}
+
+// Position of the first ch outside of "text", len if there is none
+static size_t find_unquoted(char const *s, size_t len, char ch)
+{
+  bool quoted = false;
+  for (size_t i = 0; i < len; i++)
+  {
+    if (quoted && s[i] == '\\')
+      i++;
+    else if (s[i] == '"')
+      quoted = !quoted;
+    else if (!quoted && s[i] == ch)
+      return i;
+  }
+  return len;
+}
+
+// "text" into MACRO_TYPE len text
+static bool parse_macro_text(ConfigParser *p, char const *step, size_t len)
+{
+  if (!emit(p, MACRO_TYPE) || !emit(p, 0))
+    return false;
+  uint16_t const lenAt = p->macroLen - 1;
+
+  for (size_t i = 1; ; i++)
+  {
+    if (i >= len || (step[i] == '\\' && i + 1 >= len))
+    {
+      report_error(p, "unterminated string");
+      return false;
+    }
+
+    char c = step[i];
+    if (c == '"')
+    {
+      if (i != len - 1)
+      {
+        report_error(p, "text after closing quote");
+        return false;
+      }
+      break;
+    }
+    if (c == '\\')
+    {
+      c = step[++i];
+      if (c == 'n')
+        c = '\n';
+      else if (c == 't')
+        c = '\t';
+    }
+
+    uint8_t keycode;
+    bool shift;
+    if (!hid_ascii_lookup(c, &keycode, &shift))
+    {
+      report_error(p, "character cannot be typed");
+      return false;
+    }
+    if (p->macroLen - lenAt - 1 == UINT8_MAX)
+    {
+      report_error(p, "string too long");
+      return false;
+    }
+    if (!emit(p, c))
+      return false;
+  }
+
+  p->keymap->macroSpace[lenAt] = p->macroLen - lenAt - 1;
+  return true;
+}
+
+static bool parse_macro_step(ConfigParser *p, char const *step, size_t len)
+{
+  if (len == 0)
+  {
+    report_error(p, "empty macro step");
+    return false;
+  }
+
+  if (step[0] == '"')
+    return parse_macro_text(p, step, len);
+
+  // Nms
+  if (len > 2 && step[0] >= '0' && step[0] <= '9' && strncmp(&step[len - 2], "ms", 2) == 0)
+  {
+    unsigned long ms = 0;
+    for (size_t i = 0; i < len - 2; i++)
+    {
+      if (step[i] < '0' || step[i] > '9' || (ms = ms * 10 + (step[i] - '0')) > UINT16_MAX)
+      {
+        report_error(p, "invalid delay");
+        return false;
+      }
+    }
+    return emit(p, MACRO_DELAY) && emit(p, ms & 0xFF) && emit(p, ms >> 8);
+  }
+
+  // +NAME / -NAME
+  if (step[0] == '+' || step[0] == '-')
+  {
+    uint8_t keyCode[KEYMAP_CHORD_LEN] = { 0 };
+    if (!parse_chord(p, keyCode, step + 1, len - 1))
+      return false;
+    if (keyCode[1])
+    {
+      report_error(p, "hold and release take a single key");
+      return false;
+    }
+    return emit(p, step[0] == '+' ? MACRO_PRESS : MACRO_RELEASE) && emit(p, keyCode[0]) &&
+           emit(p, MACRO_SYNC);
+  }
+
+  // Tapped chord, released in reverse order
+  uint8_t keyCode[KEYMAP_CHORD_LEN] = { 0 };
+  if (!parse_chord(p, keyCode, step, len))
+    return false;
+
+  int count = 0;
+  while (count < KEYMAP_CHORD_LEN && keyCode[count])
+  {
+    if (!emit(p, MACRO_PRESS) || !emit(p, keyCode[count++]))
+      return false;
+  }
+  if (!emit(p, MACRO_SYNC))
+    return false;
+  while (count)
+  {
+    if (!emit(p, MACRO_RELEASE) || !emit(p, keyCode[--count]))
+      return false;
+  }
+  return emit(p, MACRO_SYNC);
+}
+
+static bool parse_macro(ConfigParser *p, uint16_t *macro, char const *steps, size_t len)
+{
+  uint16_t const start = p->macroLen;
+  size_t stepStart = 0;
+
+  while (stepStart <= len)
+  {
+    size_t const stepLen = find_unquoted(&steps[stepStart], len - stepStart, ',');
+    if (!parse_macro_step(p, &steps[stepStart], stepLen))
+    {
+      p->macroLen = start;
+      return false;
+    }
+    stepStart += stepLen + 1;
+  }
+
+  if (!emit(p, MACRO_END))
+  {
+    p->macroLen = start;
+    return false;
+  }
+  *macro = start + 1;
+  return true;
+}
+
+// MO(n), TG(n), OSL(n) or PF(n)
+static bool parse_layer_action(ConfigParser *p, KeymapAction *action, char const *word, size_t len)
+{
+  static struct
+  {
+    char const *prefix;
+    KeymapActionType type;
+  } const kinds[] = {
+    { "MO(", KEYMAP_ACTION_MOMENTARY },
+    { "TG(", KEYMAP_ACTION_TOGGLE },
+    { "OSL(", KEYMAP_ACTION_ONESHOT },
+    { "PF(", KEYMAP_ACTION_PROFILE },
+  };
+
+  for (size_t i = 0; i < sizeof(kinds) / sizeof(kinds[0]); i++)
+  {
+    size_t const prefixLen = strlen(kinds[i].prefix);
+    if (len <= prefixLen || strncmp(word, kinds[i].prefix, prefixLen) != 0)
+      continue;
+
+    if (len != prefixLen + 2 || word[prefixLen] < '0' || word[prefixLen] >= '0' + KEYMAP_MAX_LAYERS ||
+        word[len - 1] != ')')
+    {
+      report_error(p, kinds[i].type == KEYMAP_ACTION_PROFILE ? "invalid profile, must be 0 - 7"
+                                                             : "invalid layer, must be 0 - 7");
+      return false;
+    }
+    action->type = kinds[i].type;
+    action->layer = word[prefixLen] - '0';
+    return true;
+  }
+
+  report_error(p, "unknown layer action");
+  return false;
+}
+
+// Matrix position given by row= and col=
+enum
+{
+  PLACED_ROW = 1,
+  PLACED_COL = 2,
+};
+
+static bool parse_number(char const *text, unsigned long max, unsigned long *value)
+{
+  char *end;
+  *value = strtoul(text, &end, 10);
+  return end != text && *end == 0 && *value <= max;
+}
+
+static bool parse_key_option(ConfigParser *p, KeymapEntry *entry, KeymapAction *action, char *option, bool *hasPin,
+                             uint8_t *placed)
+{
+  unsigned long value;
+  if (strncmp(option, "hold=", 5) == 0)
+  {
+    char const *hold = option + 5;
+    size_t const len = strlen(hold);
+    action->type = KEYMAP_ACTION_TAP_HOLD;
+    if (len && hold[len - 1] == ')')
+    {
+      KeymapAction layer;
+      if (!parse_layer_action(p, &layer, hold, len))
+        return false;
+      if (layer.type != KEYMAP_ACTION_MOMENTARY)
+      {
+        report_error(p, "hold takes a chord or MO(n)");
+        return false;
+      }
+      action->layer = layer.layer;
+      memset(action->holdCode, 0, sizeof(action->holdCode));
+      return true;
+    }
+
+    uint8_t keyCode[KEYMAP_CHORD_LEN] = { 0 };
+    if (!parse_chord(p, keyCode, hold, len))
+      return false;
+    if (keyCode[KEYMAP_HOLD_CHORD_LEN])
+    {
+      report_error(p, "more than 4 keys in a hold chord");
+      return false;
+    }
+    memcpy(action->holdCode, keyCode, sizeof(action->holdCode));
+    return true;
+  }
+
+  if (strncmp(option, "term=", 5) == 0)
+  {
+    if (!parse_number(option + 5, 10000, &value) || value == 0)
+    {
+      report_error(p, "term must be 1 - 10000 ms");
+      return false;
+    }
+    action->termMs = (uint16_t)value;
+    return true;
+  }
+
+  if (p->layer || p->actionOnly)
+  {
+    report_error(p, p->actionOnly ? "only a new keymap changes pin, matrix or debounce"
+                                  : "only keys on layer 0 take this option");
+    return false;
+  }
+
+  if (strncmp(option, "pin=", 4) == 0)
+  {
+    if (!parse_number(option + 4, KEYMAP_GPIO_COUNT - 1, &value))
+    {
+      report_error(p, "invalid pin");
+      return false;
+    }
+    entry->pin = (uint8_t)value;
+    *hasPin = true;
+    return true;
+  }
+
+  KeymapMatrix const &m = p->keymap->matrix;
+  if (strncmp(option, "row=", 4) == 0 || strncmp(option, "col=", 4) == 0)
+  {
+    bool const row = option[0] == 'r';
+    if (!m.rows)
+    {
+      report_error(p, "matrix keys need rows= and cols= first");
+      return false;
+    }
+    if (!parse_number(option + 4, (row ? m.rows : m.cols) - 1, &value))
+    {
+      report_error(p, row ? "invalid row" : "invalid col");
+      return false;
+    }
+    if (row)
+      entry->row = (uint8_t)value;
+    else
+      entry->col = (uint8_t)value;
+    *placed |= row ? PLACED_ROW : PLACED_COL;
+    return true;
+  }
+
+  Debouncer d;
+  if (!debounce_parse(&d, option))
+  {
+    report_error(p, "unknown key option");
+    return false;
+  }
+  entry->debounceAlgorithm = d.algorithm;
+  entry->debounceUs = d.timeUs;
+  return true;
+}
+
+// Comma separated GPIOs for one side of the matrix, none of them used by
+// the other side
+static void parse_matrix_lines(ConfigParser *p, char const *list, uint8_t *pins, uint8_t *count,
+                               uint8_t const *otherPins, uint8_t otherCount)
+{
+  uint8_t lines[KEYMAP_MATRIX_MAX_LINES];
+  uint8_t n = 0;
+  char const *start = list;
+
+  for (;;)
+  {
+    char *end;
+    unsigned long const pin = strtoul(start, &end, 10);
+    if (end == start || (*end != ',' && *end != 0) || pin >= KEYMAP_GPIO_COUNT)
+    {
+      report_error(p, "invalid pin list");
+      return;
+    }
+    if (n == KEYMAP_MATRIX_MAX_LINES)
+    {
+      report_error(p, "more than 16 matrix lines");
+      return;
+    }
+    if (memchr(lines, (int)pin, n) || memchr(otherPins, (int)pin, otherCount))
+    {
+      report_error(p, "pin used twice in the matrix");
+      return;
+    }
+    lines[n++] = (uint8_t)pin;
+    if (*end == 0)
+      break;
+    start = end + 1;
+  }
+
+  memcpy(pins, lines, n);
+  *count = n;
+}
+
+static void parse_setting(ConfigParser *p, char const *token)
+{
+  KeymapMatrix &m = p->keymap->matrix;
+  unsigned long value;
+
+  if (strncmp(token, "poll=", 5) == 0)
+  {
+    if (!parse_number(token + 5, 10, &value) || (value != 1 && value != 2 && value != 4 && value != 8 && value != 10))
+    {
+      report_error(p, "poll must be 1, 2, 4, 8 or 10");
+      return;
+    }
+    p->pollMs = (uint8_t)value;
+    return;
+  }
+
+  if (strncmp(token, "rows=", 5) == 0 || strncmp(token, "cols=", 5) == 0)
+  {
+    if (p->matrixUsed)
+    {
+      report_error(p, "matrix settings must come before the matrix keys");
+      return;
+    }
+    if (token[0] == 'r')
+      parse_matrix_lines(p, token + 5, m.rowPins, &m.rows, m.colPins, m.cols);
+    else
+      parse_matrix_lines(p, token + 5, m.colPins, &m.cols, m.rowPins, m.rows);
+    if (m.rows * m.cols > KEYMAP_MATRIX_MAX_POSITIONS)
+      report_error(p, "matrix has more than 224 positions");
+    return;
+  }
+
+  if (strncmp(token, "diode=", 6) == 0)
+  {
+    char const *diode = token + 6;
+    if (strcmp(diode, "col2row") == 0)
+      m.diode = KEYMAP_DIODE_COL2ROW;
+    else if (strcmp(diode, "row2col") == 0)
+      m.diode = KEYMAP_DIODE_ROW2COL;
+    else if (strcmp(diode, "none") == 0)
+      m.diode = KEYMAP_DIODE_NONE;
+    else
+      report_error(p, "diode must be col2row, row2col or none");
+    return;
+  }
+
+  if (strncmp(token, "scanner=", 8) == 0)
+  {
+    char const *scanner = token + 8;
+    if (strcmp(scanner, "cpu") == 0)
+      m.scanner = KEYMAP_SCANNER_CPU;
+    else if (strcmp(scanner, "pio") == 0)
+      m.scanner = KEYMAP_SCANNER_PIO;
+    else
+      report_error(p, "scanner must be cpu or pio");
+    return;
+  }
+
+  if (strncmp(token, "scan=", 5) == 0)
+  {
+    if (!parse_number(token + 5, KEYMAP_MAX_SCAN_US, &value) || value < KEYMAP_MIN_SCAN_US)
+    {
+      report_error(p, "scan must be 20 - 10000 us");
+      return;
+    }
+    if (value < 100 && m.scanner != KEYMAP_SCANNER_PIO)
+    {
+      report_error(p, "scan below 100 us needs scanner=pio first");
+      return;
+    }
+    m.scanUs = (uint16_t)value;
+    return;
+  }
+
+  if (strncmp(token, "layer=", 6) == 0)
+  {
+    if (!parse_number(token + 6, KEYMAP_MAX_LAYERS - 1, &value))
+    {
+      report_error(p, "layer must be 0 - 7");
+      return;
+    }
+    p->layer = (uint8_t)value;
+    if (p->layer >= p->layerCount)
+      p->layerCount = p->layer + 1;
+    return;
+  }
+
+  if (strncmp(token, "tapterm=", 8) == 0)
+  {
+    if (!parse_number(token + 8, 10000, &value) || value == 0)
+    {
+      report_error(p, "tapterm must be 1 - 10000 ms");
+      return;
+    }
+    p->tapTermMs = (uint16_t)value;
+    return;
+  }
+
+  if (strncmp(token, "taphold=", 8) == 0)
+  {
+    char const *mode = token + 8;
+    if (strcmp(mode, "permissive") == 0)
+      p->tapHoldMode = KEYMAP_TAP_HOLD_PERMISSIVE;
+    else if (strcmp(mode, "timeout") == 0)
+      p->tapHoldMode = KEYMAP_TAP_HOLD_TIMEOUT;
+    else if (strcmp(mode, "press") == 0)
+      p->tapHoldMode = KEYMAP_TAP_HOLD_PRESS;
+    else
+      report_error(p, "taphold must be permissive, timeout or press");
+    return;
+  }
+
+  report_error(p, "unknown setting");
+}
+
+// The chord, macro or other action of the word in token and its options.
+// Drops the macro bytecode of the word again when it has an error.
+static bool parse_word(ConfigParser *p, KeymapEntry *entry, KeymapAction *action, bool *hasPin, uint8_t *placed)
+{
+  char *token = p->token;
+  size_t const namesLen = find_unquoted(token, p->tokenLen, ':');
+  char *option = namesLen < p->tokenLen ? &token[namesLen] : NULL;
+  bool const macro = find_unquoted(token, namesLen, ',') < namesLen || token[0] == '"';
+  uint16_t const macroStart = p->macroLen;
+
+  if (macro && p->actionOnly)
+  {
+    report_error(p, "only a new keymap adds macros");
+    return false;
+  }
+
+  memset(action, 0, sizeof(*action));
+  action->type = KEYMAP_ACTION_KEY;
+  if (namesLen == 1 && token[0] == '_')
+    action->type = KEYMAP_ACTION_TRANSPARENT;
+  else if (namesLen == 2 && strncmp(token, "XX", 2) == 0)
+    ;
+  else if (!macro && namesLen && token[namesLen - 1] == ')')
+  {
+    if (!parse_layer_action(p, action, token, namesLen))
+      return false;
+  }
+  else if (!macro && parse_usage(action, token, namesLen))
+    ;
+  else if (macro ? !parse_macro(p, &action->macro, token, namesLen) : !parse_chord(p, action->keyCode, token, namesLen))
+    return false;
+  uint8_t const tapType = action->type;
+
+  while (option)
+  {
+    *option++ = 0;
+    char *next = strchr(option, ':');
+    if (next)
+      *next = 0;
+    if (!parse_key_option(p, entry, action, option, hasPin, placed))
+    {
+      p->macroLen = macroStart;
+      return false;
+    }
+    option = next;
+  }
+
+  char const *error = NULL;
+  if (action->type == KEYMAP_ACTION_TAP_HOLD && tapType != KEYMAP_ACTION_KEY)
+    error = "only a chord or macro can have hold";
+  else if (action->termMs && action->type != KEYMAP_ACTION_TAP_HOLD)
+    error = "term needs hold";
+
+  if (error)
+  {
+    report_error(p, error);
+    p->macroLen = macroStart;
+    return false;
+  }
+  return true;
+}
+
+static void parse_token(ConfigParser *p)
+{
+  if (p->tokenTooLong)
+  {
+    report_error(p, "key definition too long");
+    return;
+  }
+
+  p->token[p->tokenLen] = 0;
+
+  // Settings are the only words with '=' before any ':' or quote
+  size_t const nameEnd = strcspn(p->token, ":\"=");
+  if (p->token[nameEnd] == '=')
+  {
+    parse_setting(p, p->token);
+    return;
+  }
+
+  if (!p->layer && p->keyCount == KEYMAP_MAX_KEYS)
+  {
+    report_error(p, "too many keys");
+    return;
+  }
+  if (p->layer && p->layerNext[p->layer] >= p->keyCount)
+  {
+    report_error(p, "more words than keys on layer 0");
+    return;
+  }
+
+  Debouncer const defaults;
+  KeymapEntry entry;
+  memset(&entry, 0, sizeof(entry));
+  entry.debounceAlgorithm = defaults.algorithm;
+  entry.debounceUs = defaults.timeUs;
+
+  KeymapAction action;
+  bool hasPin = false;
+  uint8_t placed = 0;
+  uint16_t const macroStart = p->macroLen;
+  if (!parse_word(p, &entry, &action, &hasPin, &placed))
+    return;
+
+  KeymapMatrix const &m = p->keymap->matrix;
+  char const *error = NULL;
+  if (p->layer)
+    ;
+  else if (hasPin && placed)
+    error = "pin and matrix position are exclusive";
+  else if (placed && placed != (PLACED_ROW | PLACED_COL))
+    error = "matrix keys need both row and col";
+  else if (placed)
+    entry.pin = KEYMAP_PIN_MATRIX;
+  else if (hasPin)
+    ;
+  else if (m.rows && m.cols)
+  {
+    // Next matrix position, row by row
+    if (p->matrixNext >= m.rows * m.cols)
+      error = "no matrix position left, use the row and col options";
+    else
+    {
+      entry.pin = KEYMAP_PIN_MATRIX;
+      entry.row = p->matrixNext / m.cols;
+      entry.col = p->matrixNext % m.cols;
+      p->matrixNext++;
+    }
+  }
+  else if (p->keyCount >= p->defaultPinCount)
+    error = "no default pin left, use the pin option";
+  else
+    entry.pin = p->defaultPins[p->keyCount];
+
+  if (error)
+  {
+    report_error(p, error);
+    p->macroLen = macroStart;
+    return;
+  }
+
+  // Layer 0 stages its actions like every other layer
+  if (p->layer)
+  {
+    p->keymap->actionSpace[p->layer * KEYMAP_MAX_KEYS + p->layerNext[p->layer]++] = action;
+    return;
+  }
+  if (entry.pin == KEYMAP_PIN_MATRIX)
+    p->matrixUsed = true;
+
+  p->keymap->actionSpace[p->keyCount] = action;
+  p->keymap->keys[p->keyCount++] = entry;
+}
+
+void config_parser_init(ConfigParser *p, KeymapImage *keymap, uint8_t const *defaultPins, uint8_t defaultPinCount)
+{
+  memset(p, 0, sizeof(*p));
+  memset(&keymap->matrix, 0, sizeof(keymap->matrix));
+  memset(keymap->actionSpace, 0, sizeof(keymap->actionSpace));
+  p->keymap = keymap;
+  p->defaultPins = defaultPins;
+  p->defaultPinCount = defaultPinCount;
+  p->layerCount = 1;
+  p->line = 1;
+  p->column = 1;
+}
+
+void config_parser_feed(ConfigParser *p, char const *data, size_t len)
+{
+  for (size_t i = 0; i < len; i++)
+  {
+    char const c = data[i];
+    bool space = c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == 0;
+    bool comment = c == '#';
+
+    // Inside "text" only the closing quote or the end of the line count
+    if (p->inQuote)
+    {
+      if (p->escape)
+        p->escape = false;
+      else if (c == '\\')
+        p->escape = true;
+      else if (c == '"')
+        p->inQuote = false;
+
+      if (c == '\n')
+        p->inQuote = p->escape = false;
+      else
+        space = comment = false;
+    }
+    else if (c == '"' && !p->inComment)
+    {
+      p->inQuote = true;
+    }
+
+    if ((space || comment) && (p->tokenLen || p->tokenTooLong))
+    {
+      parse_token(p);
+      p->tokenLen = 0;
+      p->tokenTooLong = false;
+    }
+
+    if (comment)
+      p->inComment = true;
+
+    if (!space && !p->inComment)
+    {
+      if (p->tokenLen == 0 && !p->tokenTooLong)
+      {
+        p->tokenLine = p->line;
+        p->tokenColumn = p->column;
+      }
+      if (p->tokenLen < CONFIG_TOKEN_MAX)
+        p->token[p->tokenLen++] = c;
+      else
+        p->tokenTooLong = true;
+    }
+
+    if (c == '\n')
+    {
+      p->inComment = false;
+      p->line++;
+      p->column = 1;
+    }
+    else if (c != '\r')
+    {
+      p->column++;
+    }
+  }
+}
+
+bool config_parser_finish(ConfigParser *p)
+{
+  if (p->tokenLen || p->tokenTooLong)
+  {
+    parse_token(p);
+    p->tokenLen = 0;
+    p->tokenTooLong = false;
+  }
+  KeymapMatrix &m = p->keymap->matrix;
+  if (!m.rows || !m.cols)
+    m.rows = m.cols = 0;
+  keymap_seal(p->keymap, p->keyCount, p->layerCount, p->keymap->macroSpace, p->macroLen);
+  p->keymap->header.pollMs = p->pollMs;
+  p->keymap->header.tapTermMs = p->tapTermMs;
+  p->keymap->header.tapHoldMode = p->tapHoldMode;
+  return p->errorCount == 0;
+}
+
+bool config_parser_action(char const *word, KeymapAction *action, config_error_cb_t onError, void *errorContext)
+{
+  ConfigParser p;
+  memset(&p, 0, sizeof(p));
+  p.onError = onError;
+  p.errorContext = errorContext;
+  p.actionOnly = true;
+  p.tokenLine = p.tokenColumn = 1;
+
+  size_t const len = strlen(word);
+  if (len == 0 || len > CONFIG_TOKEN_MAX)
+  {
+    report_error(&p, len ? "key definition too long" : "empty key definition");
+    return false;
+  }
+  memcpy(p.token, word, len + 1);
+  p.tokenLen = (uint8_t)len;
+
+  KeymapEntry entry;
+  bool hasPin = false;
+  uint8_t placed = 0;
+  return parse_word(&p, &entry, action, &hasPin, &placed);
+}
+
+//--------------------------------------------------------------------+
+// Back to text
+//--------------------------------------------------------------------+
+static void append(char *text, size_t size, size_t *len, char const *format, ...)
+{
+  if (*len >= size)
+    return;
+  va_list args;
+  va_start(args, format);
+  int const n = vsnprintf(&text[*len], size - *len, format, args);
+  va_end(args);
+  if (n > 0)
+    *len += n;
+}
+
+// First name of a usage in name order
+static char const *usage_name(uint8_t page, uint16_t code)
+{
+  for (size_t i = 0; i < hid_usage_count(); i++)
+  {
+    char const *name = hid_usage_name(i);
+    HidUsage usage;
+    if (hid_usage_lookup(name, strlen(name), &usage) && usage.page == page && usage.code == code)
+      return name;
+  }
+  return NULL;
+}
+
+static void append_chord(char *text, size_t size, size_t *len, uint8_t const *keyCode, int count)
+{
+  for (int i = 0; i < count && keyCode[i]; i++)
+  {
+    char const *name = usage_name(HID_PAGE_KEYBOARD, keyCode[i]);
+    char const *plus = i ? "+" : "";
+    if (name)
+      append(text, size, len, "%s%s", plus, name);
+    else
+      append(text, size, len, "%s0x%02X", plus, keyCode[i]);
+  }
+}
+
+void config_action_text(KeymapAction const *action, char *text, size_t size)
+{
+  static char const *const layerActions[] = { "MO", "TG", "OSL" };
+  size_t len = 0;
+  text[0] = 0;
+
+  switch (action->type)
+  {
+  case KEYMAP_ACTION_TRANSPARENT:
+    append(text, size, &len, "_");
+    return;
+
+  case KEYMAP_ACTION_MOMENTARY:
+  case KEYMAP_ACTION_TOGGLE:
+  case KEYMAP_ACTION_ONESHOT:
+    append(text, size, &len, "%s(%u)", layerActions[action->type - KEYMAP_ACTION_MOMENTARY], action->layer);
+    return;
+
+  case KEYMAP_ACTION_PROFILE:
+    append(text, size, &len, "PF(%u)", action->layer);
+    return;
+
+  case KEYMAP_ACTION_USAGE:
+  {
+    char const *name = usage_name(action->layer, keymap_action_usage(action));
+    append(text, size, &len, "%s", name ? name : "?");
+    return;
+  }
+
+  case KEYMAP_ACTION_KEY:
+  case KEYMAP_ACTION_TAP_HOLD:
+    if (action->macro)
+      append(text, size, &len, "macro@%u", action->macro - 1);
+    else if (action->keyCode[0])
+      append_chord(text, size, &len, action->keyCode, KEYMAP_CHORD_LEN);
+    else
+      append(text, size, &len, "XX");
+    break;
+
+  default:
+    append(text, size, &len, "?");
+    return;
+  }
+
+  if (action->type != KEYMAP_ACTION_TAP_HOLD)
+    return;
+  append(text, size, &len, ":hold=");
+  if (action->holdCode[0])
+    append_chord(text, size, &len, action->holdCode, KEYMAP_HOLD_CHORD_LEN);
+  else
+    append(text, size, &len, "MO(%u)", action->layer);
+  if (action->termMs)
+    append(text, size, &len, ":term=%u", action->termMs);
+}
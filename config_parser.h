@@ -0,0 +1,125 @@
+#ifndef CONFIG_PARSER_H_
+#define CONFIG_PARSER_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "keymap.h"
+
+// Streaming parser for the text keymap (data.txt). Input is fed in chunks
+// of any size, memory use is fixed and nothing is allocated.
+//
+//   # comment until the end of the line
+//   CTRL+c  CTRL+v:deferred=8000
+//   ENTER:pin=22:none
+//   CTRL+a,CTRL+c,100ms,+SHIFT,h,i,-SHIFT:pin=21
+//   "Serial: AB-1234\n":pin=20
+//
+// Every whitespace separated word defines one key: up to 6 key names joined
+// by '+', or a macro, then options each introduced by ':'
+//
+// A macro is a list of steps joined by ',' that plays once per press:
+//   CTRL+c      tap the chord
+//   +NAME       press and hold a key
+//   -NAME       release it
+//   Nms         wait N milliseconds
+//   "text"      type the text (US layout), \n \t \" and \\ escape
+// A key that is only a "text" step is a macro as well.
+//
+// Instead of a chord or macro a word can be
+//   MO(n)       layer n active while the key is held
+//   TG(n)       layer n switched on or off on each press
+//   OSL(n)      layer n active for the next key press
+//   PF(n)       switches to profile n, see profile.h
+//   MUTE        a media key, mouse or gamepad button on its own, e.g.
+//               VOLUME_UP, MOUSE_LEFT or GAMEPAD_1, see hid_keycodes.cpp
+//   XX          nothing
+//   _           transparent, what the key does on the layer below
+// see action_engine.h.
+//
+// A word of the form setting=value is a setting instead of a key:
+//   poll=N      USB polling interval in ms: 1, 2, 4, 8 or 10
+//   rows=N,N..  GPIOs of the matrix rows, up to 16, see matrix.h
+//   cols=N,N..  GPIOs of the matrix columns, up to 16
+//   diode=D     col2row (default), row2col or none
+//   scanner=S   cpu (default) or pio, see matrix.h
+//   scan=N      matrix scan period in us, 100 - 10000, default 1000. With
+//               scanner=pio from 20 us, depending on the number of lines.
+//   layer=N     following words are layer N, 0 - 7, default 0. The keys
+//               are defined on layer 0, the words of another layer are
+//               what they do there, in the same order.
+//   tapterm=N   tapping term of tap-hold keys in ms, 1 - 10000, default 200
+//   taphold=M   permissive (default), timeout or press, when a tap-hold
+//               key is a hold before its tapping term ends
+// Matrix settings come before the keys that sit in the matrix.
+//
+// Options:
+//   pin=N                       GPIO of the key. Without pin, row and col a
+//                               key takes the next matrix position, row by
+//                               row, or with no matrix the next pin from
+//                               the default pin list.
+//   row=N:col=N                 matrix position of the key
+//   none | eager[=us] | deferred[=us]   debounce algorithm, see debounce.h
+//   hold=CHORD | hold=MO(n)     makes a chord or macro a tap-hold key, with
+//                               up to 4 keys or a layer when held
+//   term=N                      tapping term of this tap-hold key in ms
+// Only the keys on layer 0 take pin, row, col and debounce options.
+
+#define CONFIG_TOKEN_MAX 255
+
+// Called for every error found, line and column are 1 based and point to
+// the start of the offending word
+typedef void (*config_error_cb_t)(void *context, uint32_t line, uint32_t column, char const *message);
+
+struct ConfigParser
+{
+  KeymapImage *keymap;
+  uint8_t const *defaultPins;
+  uint8_t defaultPinCount;
+  config_error_cb_t onError;
+  void *errorContext;
+
+  uint16_t keyCount;
+  uint16_t matrixNext;  // next default matrix position
+  bool matrixUsed;
+  uint16_t macroLen;  // bytecode staged in keymap->macroSpace
+  uint8_t layer;      // of the words being parsed
+  uint8_t layerCount;
+  uint16_t layerNext[KEYMAP_MAX_LAYERS];  // next key on each layer above 0
+  uint8_t pollMs;
+  uint16_t tapTermMs;
+  uint8_t tapHoldMode;
+  bool actionOnly;    // config_parser_action(), no macros or key options
+  uint32_t errorCount;
+
+  char token[CONFIG_TOKEN_MAX + 1];
+  uint8_t tokenLen;
+  bool tokenTooLong;
+  bool inComment;
+  bool inQuote;
+  bool escape;
+
+  uint32_t line;
+  uint32_t column;
+  uint32_t tokenLine;
+  uint32_t tokenColumn;
+};
+
+void config_parser_init(ConfigParser *p, KeymapImage *keymap, uint8_t const *defaultPins, uint8_t defaultPinCount);
+void config_parser_feed(ConfigParser *p, char const *data, size_t len);
+
+// Handles the last word and seals the keymap. Returns false if any error
+// was reported, the keymap then holds every key that parsed cleanly.
+bool config_parser_finish(ConfigParser *p);
+
+// Parses a single word as it would stand on a layer above 0, to change
+// what a key of a loaded keymap does: a chord, MO(n), TG(n), OSL(n),
+// PF(n), XX or _, with hold and term. Macros need a new keymap. Errors are
+// reported at line 1, column 1.
+bool config_parser_action(char const *word, KeymapAction *action, config_error_cb_t onError, void *errorContext);
+
+// The word for an action, which config_parser_action() reads back unless
+// it plays a macro, shown as macro@offset
+void config_action_text(KeymapAction const *action, char *text, size_t size);
+
+#endif /* CONFIG_PARSER_H_ */
@@ -0,0 +1,384 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+
+#include "console.h"
+#include "spsc_queue.h"
+#include "latency.h"
+#include "keyboard.h"
+#include "matrix.h"
+#include "profile.h"
+#include "msc_disk.h"
+#include "config_parser.h"
+#include "core1.h"
+
+#define CONSOLE_LINE_MAX 64
+#define CONSOLE_OUTPUT_LINE 96
+
+static char line[CONSOLE_LINE_MAX + 1];
+static uint8_t lineLen = 0;
+static bool lineTooLong = false;
+
+static SpscQueue<uint8_t, 512> output;
+
+// Long outputs are produced a line at a time as the queue drains
+static bool dumpingLatency = false;
+static LatencyDump latencyDump;
+static bool dumpingTrace = false;
+static GpioTraceDump traceDump;
+
+// Key changes waiting for "key commit"
+static KeymapPatch staged[KEYMAP_PATCH_MAX];
+static uint8_t stagedCount = 0;
+
+static void console_printf(char const *format, ...)
+{
+  char text[CONSOLE_OUTPUT_LINE];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(text, sizeof(text), format, args);
+  va_end(args);
+
+  if (len < 0)
+    return;
+  if (len >= (int)sizeof(text))
+    len = sizeof(text) - 1;
+  output.write((uint8_t const *)text, len);
+}
+
+static void command_latency(char const *args)
+{
+  if (strcmp(args, "reset") == 0)
+  {
+    latency_reset();
+    console_printf("latency reset\r\n");
+    return;
+  }
+  latency_dump_start(&latencyDump);
+  dumpingLatency = true;
+}
+
+static void command_trace(char const *args)
+{
+  if (strcmp(args, "start") == 0)
+  {
+    keyboard_trace_start();
+    console_printf("trace started, %u bytes\r\n", (unsigned)KEYBOARD_TRACE_BYTES);
+  }
+  else if (strcmp(args, "stop") == 0)
+  {
+    keyboard_trace_stop();
+    console_printf("trace stopped, %lu edges\r\n", (unsigned long)keyboard_trace()->edges);
+  }
+  else if (strcmp(args, "dump") == 0)
+  {
+    keyboard_trace_stop();
+    gpio_trace_dump_start(&traceDump);
+    dumpingTrace = true;
+  }
+  else
+  {
+    console_printf("ERROR: trace start|stop|dump\r\n");
+  }
+}
+
+static void command_matrix(char const *args)
+{
+  if (strcmp(args, "reset") == 0)
+  {
+    matrix_reset_stats();
+    console_printf("matrix stats reset\r\n");
+    return;
+  }
+  if (!matrix_active())
+  {
+    console_printf("no matrix\r\n");
+    return;
+  }
+
+  MatrixStats const *s = matrix_stats();
+  bool const pio = matrix_uses_pio();
+  console_printf("matrix (%s): %lu scans, %lu changed, %lu ghosted, %lu lost\r\n", pio ? "pio" : "cpu",
+                 (unsigned long)s->scans, (unsigned long)s->changed, (unsigned long)s->ghosts, (unsigned long)s->lost);
+
+  // CPU time in hundredths of a percent
+  uint32_t const elapsedUs = time_us_32() - s->sinceUs;
+  uint32_t const load = elapsedUs ? (uint32_t)(s->totalUs * 10000 / elapsedUs) : 0;
+  console_printf("cpu %lu.%02lu%%, max %lu us, last %lu us per %s\r\n", (unsigned long)(load / 100),
+                 (unsigned long)(load % 100), (unsigned long)s->maxUs, (unsigned long)s->lastUs, pio ? "drain" : "scan");
+}
+
+static void command_profile(char const *args)
+{
+  uint8_t const count = profile_count();
+  if (args[0] == 0)
+  {
+    if (!count)
+      console_printf("no profiles loaded yet\r\n");
+    for (uint8_t i = 0; i < count; i++)
+      console_printf("%c %u %s\r\n", i == profile_active() ? '*' : ' ', i, profile_name(i));
+    return;
+  }
+
+  int index = profile_find(args);
+  if (index < 0 && args[0] >= '0' && args[0] <= '9' && args[1] == 0)
+    index = args[0] - '0';
+  if (index < 0 || index >= count)
+  {
+    console_printf("ERROR: no profile '%s'\r\n", args);
+    return;
+  }
+  if (!profile_request(index))
+  {
+    console_printf("ERROR: too many profile switches waiting\r\n");
+    return;
+  }
+  console_printf("switching to profile %d %s\r\n", index, profile_name(index));
+}
+
+static void key_error(void *context, uint32_t line, uint32_t column, char const *message)
+{
+  (void)context;
+  (void)line;
+  (void)column;
+  console_printf("ERROR: %s\r\n", message);
+}
+
+static void print_action(uint8_t key, uint8_t layer, KeymapAction const *action)
+{
+  char text[CONSOLE_OUTPUT_LINE - 24];
+  config_action_text(action, text, sizeof(text));
+  console_printf("key %u layer %u %s\r\n", key, layer, text);
+}
+
+static void key_commit(bool save)
+{
+  if (!stagedCount)
+  {
+    console_printf("nothing staged\r\n");
+    return;
+  }
+  if (save && profile_active() != 0)
+  {
+    console_printf("ERROR: only the default profile is saved, in keymap.bin\r\n");
+    return;
+  }
+
+  uint32_t const start = time_us_32();
+  if (!keyboard_patch(staged, stagedCount))
+  {
+    console_printf("ERROR: staged keys do not fit the active profile, drop them\r\n");
+    return;
+  }
+  uint32_t const us = time_us_32() - start;
+  console_printf("%u keys changed in %lu us\r\n", stagedCount, (unsigned long)us);
+
+  if (save && !core1_save_patches(staged, stagedCount))
+    console_printf("ERROR: previous save still running, not saved\r\n");
+  stagedCount = 0;
+}
+
+// key N L WORD
+static void key_stage(char const *args)
+{
+  char *end;
+  unsigned long const key = strtoul(args, &end, 10);
+  unsigned long layer = 0;
+  bool const hasLayer = *end == ' ';
+  if (hasLayer)
+    layer = strtoul(end + 1, &end, 10);
+  if (end == args || (*end && *end != ' ') || key > UINT8_MAX || layer > UINT8_MAX)
+  {
+    console_printf("ERROR: key [N [LAYER WORD]|commit [save]|drop]\r\n");
+    return;
+  }
+
+  if (!hasLayer)
+  {
+    if (!keyboard_action(key, 0))
+      console_printf("ERROR: no key %lu\r\n", key);
+    for (uint8_t i = 0; keyboard_action(key, i); i++)
+      print_action(key, i, keyboard_action(key, i));
+    return;
+  }
+
+  if (!keyboard_action(key, layer))
+  {
+    console_printf("ERROR: no key %lu on layer %lu\r\n", key, layer);
+    return;
+  }
+  KeymapPatch patch;
+  patch.key = (uint8_t)key;
+  patch.layer = (uint8_t)layer;
+  if (*end != ' ')
+  {
+    console_printf("ERROR: key N LAYER WORD\r\n");
+    return;
+  }
+  if (!config_parser_action(end + 1, &patch.action, key_error, NULL))
+    return;
+
+  // Staging a key again replaces what was staged for it
+  uint8_t i = 0;
+  while (i < stagedCount && (staged[i].key != patch.key || staged[i].layer != patch.layer))
+    i++;
+  if (i == KEYMAP_PATCH_MAX)
+  {
+    console_printf("ERROR: %d keys staged already, commit them first\r\n", KEYMAP_PATCH_MAX);
+    return;
+  }
+  if (i == stagedCount)
+    stagedCount++;
+  staged[i] = patch;
+  print_action(patch.key, patch.layer, &patch.action);
+}
+
+static void command_key(char const *args)
+{
+  if (strcmp(args, "commit") == 0 || strcmp(args, "commit save") == 0)
+  {
+    key_commit(args[6] != 0);
+  }
+  else if (strcmp(args, "drop") == 0)
+  {
+    stagedCount = 0;
+    console_printf("staged keys dropped\r\n");
+  }
+  else if (args[0] == 0)
+  {
+    console_printf("%u keys staged\r\n", stagedCount);
+    for (uint8_t i = 0; i < stagedCount; i++)
+      print_action(staged[i].key, staged[i].layer, &staged[i].action);
+  }
+  else
+  {
+    key_stage(args);
+  }
+}
+
+// Bytes per us is MB/s, printed in hundredths
+static void print_rate(char const *what, uint32_t bytes, uint32_t us)
+{
+  uint32_t const rate = us ? (uint32_t)((uint64_t)bytes * 100 / us) : 0;
+  console_printf("%s %lu KiB, %lu.%02lu MB/s\r\n", what, (unsigned long)(bytes / 1024), (unsigned long)(rate / 100),
+                 (unsigned long)(rate % 100));
+}
+
+static void command_msc(char const *args)
+{
+  if (strcmp(args, "on") == 0)
+  {
+    if (!msc_expose())
+      console_printf("ERROR: card not the firmware's or no drive in this build\r\n");
+    return;
+  }
+  if (strcmp(args, "off") == 0)
+  {
+    if (!msc_return())
+      console_printf("ERROR: the host does not have the card\r\n");
+    return;
+  }
+
+  static char const *const owners[] = { "firmware", "handing over", "host", "returning" };
+  MscStats const *s = msc_stats();
+  console_printf("card: %s, %lu transfers, %lu errors\r\n", owners[msc_owner()], (unsigned long)s->transfers,
+                 (unsigned long)s->errors);
+  print_rate("read", s->readBytes, s->readUs);
+  print_rate("write", s->writeBytes, s->writeUs);
+}
+
+static void command_help(char const *args)
+{
+  (void)args;
+  console_printf("latency [reset]\r\n");
+  console_printf("trace start|stop|dump\r\n");
+  console_printf("matrix [reset]\r\n");
+  console_printf("profile [name|number]\r\n");
+  console_printf("key [N [LAYER WORD]|commit [save]|drop]\r\n");
+  console_printf("msc [on|off]\r\n");
+}
+
+struct Command
+{
+  char const *name;
+  void (*handler)(char const *args);
+};
+
+static Command const commands[] =
+{
+  { "latency", command_latency },
+  { "trace", command_trace },
+  { "matrix", command_matrix },
+  { "profile", command_profile },
+  { "key", command_key },
+  { "msc", command_msc },
+  { "help", command_help },
+};
+
+static void run_line(void)
+{
+  line[lineLen] = 0;
+
+  char *args = strchr(line, ' ');
+  if (args)
+    *args++ = 0;
+  else
+    args = line + lineLen;
+
+  if (line[0] == 0)
+    return;
+
+  for (size_t i = 0; i < sizeof(commands) / sizeof(commands[0]); i++)
+  {
+    if (strcmp(line, commands[i].name) == 0)
+    {
+      commands[i].handler(args);
+      return;
+    }
+  }
+  console_printf("ERROR: unknown command '%s'\r\n", line);
+}
+
+void console_feed(char const *data, uint32_t len)
+{
+  for (uint32_t i = 0; i < len; i++)
+  {
+    char const c = data[i];
+    if (c == '\r' || c == '\n')
+    {
+      if (lineTooLong)
+        console_printf("ERROR: line too long\r\n");
+      else
+        run_line();
+      lineLen = 0;
+      lineTooLong = false;
+    }
+    else if (lineLen < CONSOLE_LINE_MAX)
+    {
+      line[lineLen++] = c;
+    }
+    else
+    {
+      lineTooLong = true;
+    }
+  }
+}
+
+uint32_t console_output(uint8_t *out, uint32_t maxLen)
+{
+  while ((dumpingLatency || dumpingTrace) && output.space() >= CONSOLE_OUTPUT_LINE)
+  {
+    char text[CONSOLE_OUTPUT_LINE];
+    bool line;
+    if (dumpingLatency)
+      line = dumpingLatency = latency_dump_line(&latencyDump, text, sizeof(text));
+    else
+      line = dumpingTrace = gpio_trace_dump_line(keyboard_trace(), &traceDump, text, sizeof(text));
+    if (line)
+      output.write((uint8_t const *)text, strlen(text));
+  }
+  return output.read(out, maxLen);
+}
@@ -0,0 +1,39 @@
+#ifndef CONSOLE_H_
+#define CONSOLE_H_
+
+#include <stdint.h>
+
+// Text commands on the CDC port in run mode, one per line:
+//
+//   latency         print the keypress latency histograms
+//   latency reset   clear them
+//   trace start     capture key edges for replay on the host
+//   trace stop
+//   trace dump      stop and print the trace, see gpio_trace.h
+//   matrix          scanner, scan counts and the CPU time the scan takes
+//   matrix reset    clear them
+//   profile         list the keymap profiles, * marks the active one
+//   profile NAME    switch to a profile, by name or number, see profile.h
+//   key             list the staged key changes
+//   key N           what key N does on each layer, as data.txt words
+//   key N L WORD    stage WORD as what key N does on layer L, see
+//                   config_parser_action()
+//   key commit      all staged changes at once, from the next key change on
+//   key commit save and written through to keymap.bin, only the changed
+//                   records. Without it they last until the next profile
+//                   switch or keymap reload.
+//   key drop        forget the staged changes
+//   msc             who has the SD card and the drive's transfer rates
+//   msc on          hand the card to the host as a USB drive, see msc_disk.h
+//   msc off         take it back without waiting for the host to eject it
+//   help
+//
+// Output is queued and handed out by console_output() as the CDC FIFO
+// drains, nothing waits for the host.
+
+void console_feed(char const *data, uint32_t len);
+
+// Moves queued output to out, returns the number of bytes
+uint32_t console_output(uint8_t *out, uint32_t maxLen);
+
+#endif /* CONSOLE_H_ */
@@ -0,0 +1,737 @@
+#include <atomic>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <strings.h>
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "ff.h"
+
+#include "core1.h"
+#include "spsc_queue.h"
+#include "keymap_flash.h"
+#include "config_parser.h"
+#include "static_arena.h"
+#include "crc32.h"
+#include "cdc_protocol.h"
+#include "sd_storage.h"
+#include "profile.h"
+#include "msc_disk.h"
+
+static SpscQueue<uint8_t, 16> messages;     // core 1 -> core 0
+static SpscQueue<uint8_t, 1024> cdcRxQueue;  // core 0 -> core 1
+static SpscQueue<uint8_t, 1024> cdcTxQueue;  // core 1 -> core 0
+static SpscQueue<KeymapPatch, KEYMAP_PATCH_MAX> patchQueue;  // core 0 -> core 1
+static std::atomic<bool> keymapTaken{true};
+
+static bool bootMode = false;
+static bool flashHashValid = false;
+
+FRESULT fr;
+FIL fil;
+char filename[] = "data.txt";
+char keymapFilename[] = "keymap.bin";
+static char const profileDir[] = "profiles";
+
+static uint8_t const buttonPins[] = KEYMAP_DEFAULT_PINS;
+KeymapImage keymap;
+uint32_t keymapSourceHash = 0;
+
+// Scratch memory for parsing data.txt, released as soon as it is parsed:
+// the parser and one read chunk, each with room to align it
+#define PARSE_CHUNK_BYTES 512
+static uint8_t parseArenaBuffer[1024];
+static StaticArena parseArena;
+static_assert(sizeof(ConfigParser) + alignof(ConfigParser) + PARSE_CHUNK_BYTES + 4 <= sizeof(parseArenaBuffer),
+              "parseArenaBuffer too small for the parser and a read chunk");
+
+static bool mount_sd_card(void);
+static bool load_keymap_from_sd(void);
+static bool parse_keymap_text(char const *path, bool *clean);
+static bool read_keymap_text(void);
+static bool load_keymap_bin(void);
+static void save_keymap_bin(void);
+static uint32_t keymap_source_hash(void);
+static void sync_keymap(void);
+static void load_profiles(void);
+static void save_patches(void);
+static void hand_card_to_host(void);
+static void reload_after_host(void);
+
+// stdio would drive TinyUSB from both cores, so core 1 output goes through
+// a queue that core 0 writes to the CDC interface
+static void log_printf(char const *format, ...)
+{
+  char line[128];
+  va_list args;
+  va_start(args, format);
+  int len = vsnprintf(line, sizeof(line), format, args);
+  va_end(args);
+
+  if (len < 0)
+    return;
+  if (len >= (int)sizeof(line))
+    len = sizeof(line) - 1;
+
+  // Whole lines only, so log text never cuts into a protocol frame
+  if (cdcTxQueue.space() >= (uint32_t)len)
+    cdcTxQueue.write((uint8_t const *)line, len);
+}
+
+//--------------------------------------------------------------------+
+// SD Card 
+//--------------------------------------------------------------------+
+static bool mount_sd_card(void)
+{
+  fr = storage_mount();
+  if (fr != FR_OK) {
+    log_printf("ERROR: Could not mount filesystem (%d)\r\n", fr);
+    return false;
+  }
+
+  // A reset in the middle of storing an upload
+  storage_recover(filename);
+  return true;
+}
+
+// Fill keymap from keymap.bin, or from data.txt when there is no valid
+// keymap.bin. The card must be mounted.
+static bool load_keymap_from_sd(void)
+{
+  // Precompiled keymap goes straight into the key table
+  if (load_keymap_bin())
+  {
+    log_printf("Loaded %d keys from '%s'\r\n", keymap.header.keyCount, keymapFilename);
+    return true;
+  }
+
+  return read_keymap_text();
+}
+
+static void keymap_text_error(void *context, uint32_t line, uint32_t column, char const *message)
+{
+  log_printf("ERROR: %s:%lu:%lu: %s\r\n", (char const *)context, (unsigned long)line, (unsigned long)column,
+             message);
+}
+
+// Parse data.txt and cache it as keymap.bin. Keys with errors are reported
+// and left out, the rest still loads.
+static bool read_keymap_text(void)
+{
+  bool clean;
+  if (!parse_keymap_text(filename, &clean))
+    return false;
+  log_printf("Parsed %d keys from '%s'\r\n", keymap.header.keyCount, filename);
+
+  save_keymap_bin();
+  return true;
+}
+
+// Parse a keymap text file sector by sector into keymap. clean tells
+// whether it had no errors.
+static bool parse_keymap_text(char const *path, bool *clean)
+{
+  fr = f_open(&fil, path, FA_READ);
+  if (fr != FR_OK) {
+    log_printf("ERROR: Could not open file (%d)\r\n", fr);
+    return false;
+  }
+
+  // Parser state and the read buffer live in the arena rather than on the
+  // 2 KB main stack
+  arena_init(&parseArena, parseArenaBuffer, sizeof(parseArenaBuffer));
+  ConfigParser *parser = ARENA_NEW(&parseArena, ConfigParser);
+  UINT const chunkSize = PARSE_CHUNK_BYTES;
+  char *chunk = (char *)arena_alloc(&parseArena, chunkSize, 4);
+
+  config_parser_init(parser, &keymap, buttonPins, sizeof(buttonPins));
+  parser->onError = keymap_text_error;
+  parser->errorContext = (void *)path;
+
+  UINT br = 0;
+  do {
+    fr = f_read(&fil, chunk, chunkSize, &br);
+    if (fr != FR_OK) {
+      log_printf("ERROR: Could not read file (%d)\r\n", fr);
+      f_close(&fil);
+      arena_reset(&parseArena);
+      return false;
+    }
+    config_parser_feed(parser, chunk, br);
+  } while (br == chunkSize);
+
+  // Close file
+  fr = f_close(&fil);
+  if (fr != FR_OK) {
+    log_printf("ERROR: Could not close file (%d)\r\n", fr);
+    arena_reset(&parseArena);
+    return false;
+  }
+
+  *clean = config_parser_finish(parser);
+  arena_reset(&parseArena);
+  return true;
+}
+
+static bool load_keymap_bin(void)
+{
+  fr = f_open(&fil, keymapFilename, FA_READ);
+  if (fr != FR_OK)
+    return false;
+
+  UINT br = 0;
+  fr = f_read(&fil, &keymap, sizeof(keymap), &br);
+  f_close(&fil);
+
+  if (fr != FR_OK || !keymap_valid(&keymap, br))
+  {
+    log_printf("ERROR: Ignoring invalid '%s'\r\n", keymapFilename);
+    memset(&keymap, 0, sizeof(keymap));
+    return false;
+  }
+  return true;
+}
+
+// Cache the parsed text keymap so the next boot skips parsing.
+// Failing here only costs boot time, so errors are not fatal.
+static void save_keymap_bin(void)
+{
+  fr = f_open(&fil, keymapFilename, FA_WRITE | FA_CREATE_ALWAYS);
+  if (fr != FR_OK) {
+    log_printf("ERROR: Could not open file (%d)\r\n", fr);
+    return;
+  }
+
+  UINT const len = keymap_size(&keymap);
+  UINT bw = 0;
+  fr = f_write(&fil, &keymap, len, &bw);
+  if (fr != FR_OK || bw != len) {
+    log_printf("ERROR: Could not write to file (%d)\r\n", fr);
+    f_close(&fil);
+    f_unlink(keymapFilename);
+    return;
+  }
+
+  f_close(&fil);
+}
+
+// Identifies the SD files a keymap was built from by their size and
+// timestamp. A missing file hashes differently from any existing one.
+static uint32_t keymap_source_hash(void)
+{
+  char const *names[] = { filename, keymapFilename };
+  uint32_t crc = CRC32_INIT;
+
+  for (int i = 0; i < count_of(names); i++)
+  {
+    FILINFO info;
+    if (f_stat(names[i], &info) != FR_OK)
+    {
+      crc = crc32_update(crc, names[i], strlen(names[i]));
+      continue;
+    }
+    crc = crc32_update(crc, &info.fsize, sizeof(info.fsize));
+    crc = crc32_update(crc, &info.fdate, sizeof(info.fdate));
+    crc = crc32_update(crc, &info.ftime, sizeof(info.ftime));
+  }
+
+  // A patched keymap.bin may keep its size and timestamp, not its CRC
+  KeymapHeader header;
+  UINT br = 0;
+  if (f_open(&fil, keymapFilename, FA_READ) == FR_OK)
+  {
+    if (f_read(&fil, &header, sizeof(header), &br) == FR_OK && br == sizeof(header))
+      crc = crc32_update(crc, &header.crc, sizeof(header.crc));
+    f_close(&fil);
+  }
+  return crc32_final(crc);
+}
+
+// Reload and reflash the keymap when the files on the card changed since
+// the flash copy was made, or when there is no flash copy yet. The keys
+// keep running from the flash copy when the card is missing or broken.
+static void sync_keymap(void)
+{
+  if (!mount_sd_card())
+    return;
+
+  if (flashHashValid)
+  {
+    if (keymap_source_hash() == keymapSourceHash)
+      return;
+    log_printf("Keymap changed on SD card, reloading\r\n");
+  }
+
+  // Core 0 may still be copying the previous keymap
+  while (!keymapTaken.load(std::memory_order_acquire))
+    tight_loop_contents();
+
+  if (!load_keymap_from_sd())
+    return;
+
+  // Loading data.txt rewrites keymap.bin, hash what is there now
+  keymapSourceHash = keymap_source_hash();
+  flashHashValid = true;
+  if (!keymap_flash_store(&keymap, keymapSourceHash))
+    log_printf("ERROR: Could not keep the keymap in flash\r\n");
+
+  keymapTaken.store(false, std::memory_order_relaxed);
+  messages.push(CORE1_KEYMAP_READY);
+}
+
+//--------------------------------------------------------------------+
+// Profiles, see profile.h
+//--------------------------------------------------------------------+
+static bool same_keys(KeymapImage const *a, KeymapImage const *b)
+{
+  return a->header.keyCount == b->header.keyCount && memcmp(&a->matrix, &b->matrix, sizeof(a->matrix)) == 0 &&
+         memcmp(a->keys, b->keys, a->header.keyCount * sizeof(KeymapEntry)) == 0;
+}
+
+// Names of the profiles/NAME.txt files, sorted, returns how many
+static int list_profiles(char names[][PROFILE_NAME_LEN], int maxCount)
+{
+  DIR dir;
+  FILINFO info;
+  int count = 0;
+
+  if (f_opendir(&dir, profileDir) != FR_OK)
+    return 0;
+
+  while (f_readdir(&dir, &info) == FR_OK && info.fname[0])
+  {
+    size_t const len = strlen(info.fname);
+    if ((info.fattrib & AM_DIR) || len < 5 || strcasecmp(&info.fname[len - 4], ".txt") != 0)
+      continue;
+    if (len - 4 >= PROFILE_NAME_LEN)
+    {
+      log_printf("ERROR: Profile name '%s' too long\r\n", info.fname);
+      continue;
+    }
+    if (count == maxCount)
+    {
+      log_printf("ERROR: More than %d profiles, '%s' left out\r\n", maxCount, info.fname);
+      continue;
+    }
+
+    char name[PROFILE_NAME_LEN];
+    memcpy(name, info.fname, len - 4);
+    name[len - 4] = 0;
+    int i = count++;
+    for (; i > 0 && strcmp(names[i - 1], name) > 0; i--)
+      memcpy(names[i], names[i - 1], PROFILE_NAME_LEN);
+    memcpy(names[i], name, PROFILE_NAME_LEN);
+  }
+  f_closedir(&dir);
+  return count;
+}
+
+// data.txt is the default profile, the profile files are parsed with
+// keymap as scratch space and kept when they are clean and have the same
+// keys. keymap holds the default profile again afterwards.
+static void load_profiles(void)
+{
+  // Core 0 may still be copying the keymap
+  while (!keymapTaken.load(std::memory_order_acquire))
+    tight_loop_contents();
+
+  profile_clear();
+  if (keymap.header.magic != KEYMAP_MAGIC)
+    return;
+  if (!profile_add("default", &keymap))
+  {
+    log_printf("ERROR: No room for profile 'default', profiles are off\r\n");
+    return;
+  }
+
+  char names[PROFILE_MAX - 1][PROFILE_NAME_LEN];
+  int const count = list_profiles(names, PROFILE_MAX - 1);
+  for (int i = 0; i < count; i++)
+  {
+    char path[sizeof(profileDir) + PROFILE_NAME_LEN + 8];
+    snprintf(path, sizeof(path), "%s/%s.txt", profileDir, names[i]);
+
+    bool clean;
+    if (!parse_keymap_text(path, &clean))
+      continue;
+    if (!clean)
+      log_printf("ERROR: Profile '%s' has errors, left out\r\n", names[i]);
+    else if (!same_keys(&keymap, profile_image(0)))
+      log_printf("ERROR: Profile '%s' has other keys than '%s', left out\r\n", names[i], filename);
+    else if (!profile_add(names[i], &keymap))
+      log_printf("ERROR: No room for profile '%s'\r\n", names[i]);
+  }
+
+  memcpy(&keymap, profile_image(0), keymap_size(profile_image(0)));
+  profile_publish();
+  log_printf("Loaded %d profiles\r\n", profile_count());
+}
+
+//--------------------------------------------------------------------+
+// Key patches, see the console "key" command
+//--------------------------------------------------------------------+
+// Writes the changed actions into keymap and the default profile, and only
+// those records into keymap.bin. The header goes last, so a reset halfway
+// leaves a CRC mismatch and the next boot parses data.txt instead. The
+// changed CRC also makes the next boot reflash the keymap.
+static void save_patches(void)
+{
+  KeymapPatch patches[KEYMAP_PATCH_MAX];
+  uint32_t const count = patchQueue.read(patches, KEYMAP_PATCH_MAX);
+  if (!count)
+    return;
+
+  KeymapHeader const &h = keymap.header;
+  KeymapHeader stored;
+  UINT br = 0;
+  fr = f_open(&fil, keymapFilename, FA_READ | FA_WRITE);
+  if (fr != FR_OK)
+  {
+    log_printf("ERROR: Could not open file (%d)\r\n", fr);
+    return;
+  }
+  fr = f_read(&fil, &stored, sizeof(stored), &br);
+  if (fr != FR_OK || br != sizeof(stored) || h.magic != KEYMAP_MAGIC || stored.crc != h.crc)
+  {
+    log_printf("ERROR: '%s' is not the keymap in use, not saved\r\n", keymapFilename);
+    f_close(&fil);
+    return;
+  }
+
+  KeymapImage *profile = profile_count() ? profile_image(0) : NULL;
+  uint32_t saved = 0;
+  for (uint32_t i = 0; i < count && fr == FR_OK; i++)
+  {
+    KeymapPatch const &p = patches[i];
+    if (p.key >= h.keyCount || p.layer >= h.layerCount)
+    {
+      log_printf("ERROR: No key %u on layer %u in '%s'\r\n", p.key, p.layer, keymapFilename);
+      continue;
+    }
+
+    KeymapAction *action = keymap_action(&keymap, p.key, p.layer);
+    *action = p.action;
+    if (profile)
+      *keymap_action(profile, p.key, p.layer) = p.action;
+
+    UINT bw = 0;
+    fr = f_lseek(&fil, (uint8_t *)action - (uint8_t *)&keymap);
+    if (fr == FR_OK)
+      fr = f_write(&fil, action, sizeof(*action), &bw);
+    saved++;
+  }
+
+  keymap_update_crc(&keymap);
+  if (profile)
+    profile->header.crc = keymap.header.crc;
+
+  UINT bw = 0;
+  if (fr == FR_OK)
+    fr = f_lseek(&fil, 0);
+  if (fr == FR_OK)
+    fr = f_write(&fil, &keymap.header, sizeof(keymap.header), &bw);
+  FRESULT const closed = f_close(&fil);
+  if (fr == FR_OK)
+    fr = closed;
+
+  if (fr != FR_OK)
+    log_printf("ERROR: Could not write to file (%d)\r\n", fr);
+  else
+    log_printf("Saved %lu keys to '%s'\r\n", (unsigned long)saved, keymapFilename);
+}
+
+//--------------------------------------------------------------------+
+// SD card drive, see msc_disk.h
+//--------------------------------------------------------------------+
+// data.txt as the host got it
+static FILINFO handedDataInfo;
+static bool handedDataExists = false;
+
+static void hand_card_to_host(void)
+{
+  handedDataExists = f_stat(filename, &handedDataInfo) == FR_OK;
+  storage_unmount();
+
+  if (msc_hand_over())
+    log_printf("SD card handed to the host, eject it to give it back\r\n");
+  else
+    log_printf("ERROR: SD card not readable, kept it\r\n");
+}
+
+// The host may have changed any file. keymap.bin only goes when data.txt
+// changed, so saved key patches survive a look at the card.
+static void reload_after_host(void)
+{
+  log_printf("SD card back from the host\r\n");
+  if (!mount_sd_card())
+    return;
+
+  FILINFO info;
+  bool const exists = f_stat(filename, &info) == FR_OK;
+  if (exists != handedDataExists || (exists && (info.fsize != handedDataInfo.fsize ||
+                                                info.fdate != handedDataInfo.fdate ||
+                                                info.ftime != handedDataInfo.ftime)))
+  {
+    log_printf("'%s' changed, parsing it again\r\n", filename);
+    f_unlink(keymapFilename);
+  }
+
+  sync_keymap();
+  load_profiles();
+}
+
+//--------------------------------------------------------------------+
+// Framed upload, see cdc_protocol.h
+//--------------------------------------------------------------------+
+static FrameDecoder uploadDecoder;
+static bool uploadOpen = false;
+static uint8_t uploadExpectedSeq = 0;
+static bool uploadNakSent = false;
+static uint32_t uploadSize = 0;
+static uint32_t uploadReceived = 0;
+static uint32_t uploadCrc = 0;
+static uint8_t uploadLastResult = UPLOAD_ERR_STATE;
+
+// Frames go out whole or not at all. A dropped reply is recovered by the
+// host's retransmit timeout.
+static void send_frame(uint8_t type, uint8_t seq, void const *payload, uint16_t len)
+{
+  uint8_t out[FRAME_OVERHEAD + 4];
+  size_t const n = frame_encode(out, type, seq, payload, len);
+  if (cdcTxQueue.space() >= n)
+    cdcTxQueue.write(out, n);
+}
+
+static void send_nak(void)
+{
+  // One NAK per gap, the host resends everything from there anyway
+  if (uploadNakSent)
+    return;
+  uploadNakSent = true;
+  send_frame(FRAME_NAK, uploadExpectedSeq, NULL, 0);
+}
+
+static void finish_upload(uint8_t status)
+{
+  if (status == UPLOAD_OK)
+  {
+    fr = storage_upload_commit();
+    if (fr == FR_OK)
+    {
+      // Compiled keymap is stale once the text changes
+      f_unlink(keymapFilename);
+    }
+    else
+    {
+      log_printf("ERROR: Could not store '%s' (%d)\r\n", filename, fr);
+      status = UPLOAD_ERR_STORAGE;
+    }
+  }
+  else
+  {
+    storage_upload_abort();
+  }
+
+  uploadOpen = false;
+  uploadLastResult = status;
+  send_frame(FRAME_RESULT, uploadExpectedSeq, &status, 1);
+
+  StorageStats const *stats = storage_upload_stats();
+  log_printf("Upload of %lu bytes finished (%d), %lu writes in %lu us\r\n",
+             (unsigned long)uploadReceived, status,
+             (unsigned long)stats->writes, (unsigned long)stats->writeUs);
+}
+
+static void handle_upload_frame(Frame const *f)
+{
+  if (f->type == FRAME_BEGIN)
+  {
+    uploadSize = f->len >= 4 ? get_u32le(f->payload) : 0;
+    uploadReceived = 0;
+    uploadCrc = CRC32_INIT;
+    uploadExpectedSeq = f->seq + 1;
+    uploadNakSent = false;
+
+    fr = f->len >= 4 ? storage_upload_begin(filename, uploadSize) : FR_INVALID_PARAMETER;
+    uploadOpen = fr == FR_OK;
+    if (!uploadOpen)
+    {
+      log_printf("ERROR: Could not open file (%d)\r\n", fr);
+      finish_upload(UPLOAD_ERR_STORAGE);
+      return;
+    }
+    send_frame(FRAME_ACK, uploadExpectedSeq, NULL, 0);
+    return;
+  }
+
+  if (f->type != FRAME_DATA && f->type != FRAME_END)
+    return;
+
+  if (!uploadOpen)
+  {
+    // The RESULT for this END got lost, say it again
+    if (f->type == FRAME_END && (uint8_t)(f->seq + 1) == uploadExpectedSeq)
+      send_frame(FRAME_RESULT, uploadExpectedSeq, &uploadLastResult, 1);
+    else
+    {
+      uint8_t const status = UPLOAD_ERR_STATE;
+      send_frame(FRAME_RESULT, f->seq, &status, 1);
+    }
+    return;
+  }
+
+  if (f->seq != uploadExpectedSeq)
+  {
+    // Already stored, the ACK was lost or is still on its way
+    if ((uint8_t)(uploadExpectedSeq - f->seq) <= FRAME_WINDOW)
+      send_frame(FRAME_ACK, uploadExpectedSeq, NULL, 0);
+    else
+      send_nak();
+    return;
+  }
+
+  uploadExpectedSeq++;
+  uploadNakSent = false;
+
+  if (f->type == FRAME_DATA)
+  {
+    // Buffered, so the ACK goes out before the card is written
+    fr = storage_upload_write(f->payload, f->len);
+    if (fr != FR_OK)
+    {
+      log_printf("ERROR: Could not write to file (%d)\r\n", fr);
+      finish_upload(UPLOAD_ERR_STORAGE);
+      return;
+    }
+    uploadCrc = crc32_update(uploadCrc, f->payload, f->len);
+    uploadReceived += f->len;
+    send_frame(FRAME_ACK, uploadExpectedSeq, NULL, 0);
+    return;
+  }
+
+  if (f->len < 4 || uploadReceived != uploadSize)
+    finish_upload(UPLOAD_ERR_SIZE);
+  else if (crc32_final(uploadCrc) != get_u32le(f->payload))
+    finish_upload(UPLOAD_ERR_CRC);
+  else
+    finish_upload(UPLOAD_OK);
+}
+
+//--------------------------------------------------------------------+
+// Core 1 main loop
+//--------------------------------------------------------------------+
+// Boot mode: data.txt arrives as framed upload on the CDC port
+static void upload_task(void)
+{
+  uint8_t bytes[64];
+  uint32_t const len = cdcRxQueue.read(bytes, sizeof(bytes));
+
+  for (uint32_t i = 0; i < len; i++)
+  {
+    switch (frame_decoder_push(&uploadDecoder, bytes[i]))
+    {
+    case FRAME_READY:
+      handle_upload_frame(&uploadDecoder.frame);
+      break;
+    case FRAME_ERROR:
+      if (uploadOpen)
+        send_nak();
+      break;
+    default:
+      break;
+    }
+  }
+
+  // Write a full sector buffer while the host sends the next frames
+  if (uploadOpen && cdcRxQueue.empty())
+  {
+    fr = storage_task();
+    if (fr != FR_OK)
+    {
+      log_printf("ERROR: Could not write to file (%d)\r\n", fr);
+      finish_upload(UPLOAD_ERR_STORAGE);
+    }
+  }
+}
+
+static void core1_main(void)
+{
+  if (!bootMode)
+  {
+    sync_keymap();
+    load_profiles();
+  }
+
+  while (true)
+  {
+    if (bootMode)
+    {
+      upload_task();
+    }
+    else
+    {
+      // Nothing listens to the CDC port in run mode
+      uint8_t discard[64];
+      cdcRxQueue.read(discard, sizeof(discard));
+      if (msc_handover_requested())
+        hand_card_to_host();
+      if (msc_task())
+        reload_after_host();
+      profile_task();
+
+      // The card is the host's meanwhile, patches wait until it is back
+      if (msc_owner() == MSC_OWNER_FIRMWARE)
+        save_patches();
+    }
+    tight_loop_contents();
+  }
+}
+
+void core1_launch(bool boot, bool hashValid, uint32_t hash)
+{
+  bootMode = boot;
+  flashHashValid = hashValid;
+  frame_decoder_init(&uploadDecoder);
+  keymapSourceHash = hash;
+
+  // Lets core 1 park core 0 while it writes the flash
+  multicore_lockout_victim_init();
+  multicore_launch_core1(core1_main);
+}
+
+//--------------------------------------------------------------------+
+// Core 0 side
+//--------------------------------------------------------------------+
+bool core1_poll_message(uint8_t *message)
+{
+  return messages.pop(message);
+}
+
+void core1_keymap_taken(void)
+{
+  keymapTaken.store(true, std::memory_order_release);
+}
+
+uint32_t core1_cdc_rx(uint8_t const *data, uint32_t len)
+{
+  return cdcRxQueue.write(data, len);
+}
+
+bool core1_save_patches(KeymapPatch const *patches, uint8_t count)
+{
+  if (patchQueue.space() < count)
+    return false;
+  patchQueue.write(patches, count);
+  return true;
+}
+
+uint32_t core1_cdc_rx_space(void)
+{
+  return cdcRxQueue.space();
+}
+
+uint32_t core1_cdc_tx(uint8_t *data, uint32_t maxLen)
+{
+  return cdcTxQueue.read(data, maxLen);
+}
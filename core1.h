@@ -0,0 +1,43 @@
+#ifndef CORE1_H_
+#define CORE1_H_
+
+#include <stdint.h>
+
+#include "keymap.h"
+
+// Everything that can block for milliseconds runs on core 1: the SD card,
+// keymap parsing and flashing, and the boot mode upload. Core 0 is left with
+// USB servicing and key processing.
+//
+// The cores share nothing but lock-free SPSC queues, the keymap and the
+// profile tables (see profile.h). Core 1 only writes the keymap before
+// posting CORE1_KEYMAP_READY and leaves it alone until core 0 calls
+// core1_keymap_taken().
+
+enum
+{
+  CORE1_KEYMAP_READY = 1,
+};
+
+extern KeymapImage keymap;
+
+// flashHashValid: keymap already holds the flash copy built from SD files
+// with hash flashHash
+void core1_launch(bool bootMode, bool flashHashValid, uint32_t flashHash);
+
+//--------------------------------------------------------------------+
+// Core 0 side
+//--------------------------------------------------------------------+
+bool core1_poll_message(uint8_t *message);
+void core1_keymap_taken(void);
+
+// Writes changed actions through to keymap.bin on the card, see the
+// console "key" command. False when earlier ones are still waiting.
+bool core1_save_patches(KeymapPatch const *patches, uint8_t count);
+
+// CDC bytes to and from core 1, return how many were moved
+uint32_t core1_cdc_rx(uint8_t const *data, uint32_t len);
+uint32_t core1_cdc_rx_space(void);
+uint32_t core1_cdc_tx(uint8_t *data, uint32_t maxLen);
+
+#endif /* CORE1_H_ */
@@ -0,0 +1,30 @@
+#include <array>
+
+#include "crc32.h"
+
+static constexpr std::array<uint32_t, 256> make_table(void)
+{
+  std::array<uint32_t, 256> table{};
+  for (uint32_t i = 0; i < 256; i++)
+  {
+    uint32_t c = i;
+    for (int k = 0; k < 8; k++)
+    {
+      c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+    }
+    table[i] = c;
+  }
+  return table;
+}
+
+static constexpr std::array<uint32_t, 256> crcTable = make_table();
+
+uint32_t crc32_update(uint32_t crc, void const *data, size_t len)
+{
+  uint8_t const *p = (uint8_t const *)data;
+  while (len--)
+  {
+    crc = crcTable[(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+  }
+  return crc;
+}
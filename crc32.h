@@ -0,0 +1,24 @@
+#ifndef CRC32_H_
+#define CRC32_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// CRC-32 (IEEE 802.3, reflected, as used by zlib)
+
+#define CRC32_INIT 0xFFFFFFFFu
+
+// Continue a running CRC, start with CRC32_INIT and finish with crc32_final()
+uint32_t crc32_update(uint32_t crc, void const *data, size_t len);
+
+static inline uint32_t crc32_final(uint32_t crc)
+{
+  return crc ^ 0xFFFFFFFFu;
+}
+
+static inline uint32_t crc32(void const *data, size_t len)
+{
+  return crc32_final(crc32_update(CRC32_INIT, data, len));
+}
+
+#endif /* CRC32_H_ */
@@ -0,0 +1,112 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "debounce.h"
+
+// Timestamps wrap every ~71 minutes, compare by difference only
+static bool elapsed(uint32_t fromUs, uint32_t toUs, uint32_t periodUs)
+{
+  return (int32_t)(toUs - fromUs) >= (int32_t)periodUs;
+}
+
+bool debounce_edge(Debouncer *d, bool level, uint32_t timeUs)
+{
+  if (!d->changing && level != d->stable)
+  {
+    d->changing = true;
+    d->changeUs = timeUs;
+  }
+  d->raw = level;
+
+  switch (d->algorithm)
+  {
+  case DEBOUNCE_EAGER:
+    if (d->locked && elapsed(d->edgeUs, timeUs, d->timeUs))
+      d->locked = false;
+
+    if (d->locked || level == d->stable)
+      return false;
+
+    d->stable = level;
+    d->changing = false;
+    d->locked = true;
+    d->edgeUs = timeUs;
+    return true;
+
+  case DEBOUNCE_DEFERRED:
+    d->edgeUs = timeUs;
+    return false;
+
+  default:
+    if (level == d->stable)
+      return false;
+    d->stable = level;
+    d->changing = false;
+    return true;
+  }
+}
+
+bool debounce_poll(Debouncer *d, uint32_t nowUs)
+{
+  switch (d->algorithm)
+  {
+  case DEBOUNCE_EAGER:
+    if (!d->locked || !elapsed(d->edgeUs, nowUs, d->timeUs))
+      return false;
+
+    d->locked = false;
+    if (d->raw == d->stable)
+    {
+      d->changing = false;
+      return false;
+    }
+
+    // Contact changed during the lockout, report it and lock again from
+    // the moment the lockout ended.
+    d->stable = d->raw;
+    d->changing = false;
+    d->locked = true;
+    d->edgeUs += d->timeUs;
+    return true;
+
+  case DEBOUNCE_DEFERRED:
+    if (!elapsed(d->edgeUs, nowUs, d->timeUs))
+      return false;
+
+    // A glitch that settled back where it was is no change at all
+    d->changing = false;
+    if (d->raw == d->stable)
+      return false;
+
+    d->stable = d->raw;
+    return true;
+
+  default:
+    return false;
+  }
+}
+
+bool debounce_parse(Debouncer *d, char const *option)
+{
+  char const *value = strchr(option, '=');
+  size_t const nameLen = value ? (size_t)(value - option) : strlen(option);
+
+  if (nameLen == 4 && strncmp(option, "none", 4) == 0)
+    d->algorithm = DEBOUNCE_NONE;
+  else if (nameLen == 5 && strncmp(option, "eager", 5) == 0)
+    d->algorithm = DEBOUNCE_EAGER;
+  else if (nameLen == 8 && strncmp(option, "deferred", 8) == 0)
+    d->algorithm = DEBOUNCE_DEFERRED;
+  else
+    return false;
+
+  if (value)
+  {
+    char *end;
+    unsigned long const us = strtoul(value + 1, &end, 10);
+    if (end == value + 1 || *end != 0)
+      return false;
+    d->timeUs = us;
+  }
+  return true;
+}
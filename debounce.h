@@ -0,0 +1,46 @@
+#ifndef DEBOUNCE_H_
+#define DEBOUNCE_H_
+
+#include <stdint.h>
+
+// Per key debounce state machine fed with timestamped raw edges.
+//
+// EAGER    reports the first edge immediately, then ignores the contact for
+//          timeUs. A level that differs after the lockout is reported then.
+// DEFERRED reports a level only once it has been stable for timeUs.
+// NONE     reports every edge as is.
+
+#define DEBOUNCE_DEFAULT_US 5000
+
+enum DebounceAlgorithm : uint8_t
+{
+  DEBOUNCE_NONE = 0,
+  DEBOUNCE_EAGER,
+  DEBOUNCE_DEFERRED,
+};
+
+struct Debouncer
+{
+  uint8_t algorithm = DEBOUNCE_EAGER;
+  uint32_t timeUs = DEBOUNCE_DEFAULT_US;
+
+  bool raw = false;     // last level seen on the contact
+  bool stable = false;  // last level reported
+  bool locked = false;  // eager lockout running
+  uint32_t edgeUs = 0;  // eager: lockout start, deferred: last raw edge
+  bool changing = false;  // contact left stable and has not settled yet
+  uint32_t changeUs = 0;  // first edge of that change, for latency stats
+};
+
+// Feed a raw edge. Returns true when the reported level changes.
+bool debounce_edge(Debouncer *d, bool level, uint32_t timeUs);
+
+// Let time pass without an edge. Returns true when the reported level
+// changes. Call with the timestamp of the next pending edge of this key
+// before feeding it, so changes keep their order.
+bool debounce_poll(Debouncer *d, uint32_t nowUs);
+
+// Parse "none", "eager[=us]" or "deferred[=us]"
+bool debounce_parse(Debouncer *d, char const *option);
+
+#endif /* DEBOUNCE_H_ */
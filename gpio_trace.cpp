@@ -0,0 +1,158 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "gpio_trace.h"
+#include "crc32.h"
+
+enum
+{
+  DUMP_HEADER = 0,
+  DUMP_DATA,
+  DUMP_END,
+  DUMP_DONE,
+};
+
+static void put_u16le(uint8_t *p, uint16_t v)
+{
+  p[0] = (uint8_t)v;
+  p[1] = (uint8_t)(v >> 8);
+}
+
+static void put_u32le(uint8_t *p, uint32_t v)
+{
+  put_u16le(p, (uint16_t)v);
+  put_u16le(p + 2, (uint16_t)(v >> 16));
+}
+
+static uint32_t get_u32le(uint8_t const *p)
+{
+  return p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+void gpio_trace_init(GpioTrace *t, uint8_t *buffer, uint32_t size, uint32_t startUs)
+{
+  t->data = buffer;
+  t->size = size;
+  t->len = 0;
+  t->edges = 0;
+  t->lastUs = startUs;
+  t->truncated = false;
+
+  if (size < GPIO_TRACE_HEADER_LEN)
+  {
+    t->truncated = true;
+    return;
+  }
+  put_u32le(buffer, GPIO_TRACE_MAGIC);
+  put_u16le(buffer + 4, GPIO_TRACE_VERSION);
+  put_u16le(buffer + 6, 0);
+  put_u32le(buffer + 8, startUs);
+  t->len = GPIO_TRACE_HEADER_LEN;
+}
+
+bool gpio_trace_append(GpioTrace *t, uint8_t pin, bool level, uint32_t timeUs)
+{
+  if (t->truncated || t->size - t->len < GPIO_TRACE_EDGE_MAX_LEN)
+  {
+    t->truncated = true;
+    return false;
+  }
+
+  uint64_t value = (uint64_t)(timeUs - t->lastUs) << 1 | (level ? 1 : 0);
+  t->lastUs = timeUs;
+
+  uint8_t *p = t->data + t->len;
+  while (value >= 0x80)
+  {
+    *p++ = (uint8_t)(value | 0x80);
+    value >>= 7;
+  }
+  *p++ = (uint8_t)value;
+  *p++ = pin;
+
+  t->len = p - t->data;
+  t->edges++;
+  return true;
+}
+
+bool gpio_trace_reader_init(GpioTraceReader *r, uint8_t const *data, uint32_t len)
+{
+  r->data = data;
+  r->len = len;
+  r->pos = GPIO_TRACE_HEADER_LEN;
+  if (len < GPIO_TRACE_HEADER_LEN || get_u32le(data) != GPIO_TRACE_MAGIC ||
+      (data[4] | data[5] << 8) != GPIO_TRACE_VERSION)
+    return false;
+  r->timeUs = get_u32le(data + 8);
+  return true;
+}
+
+bool gpio_trace_next(GpioTraceReader *r, KeyEvent *ev)
+{
+  uint64_t value = 0;
+  uint32_t pos = r->pos;
+  for (int shift = 0; ; shift += 7)
+  {
+    if (pos >= r->len || shift > 28)
+      return false;
+    uint8_t const b = r->data[pos++];
+    value |= (uint64_t)(b & 0x7F) << shift;
+    if (!(b & 0x80))
+      break;
+  }
+  if (pos >= r->len)
+    return false;
+
+  r->timeUs += (uint32_t)(value >> 1);
+  ev->pin = r->data[pos++];
+  ev->level = value & 1;
+  ev->timeUs = r->timeUs;
+  r->pos = pos;
+  return true;
+}
+
+void gpio_trace_dump_start(GpioTraceDump *d)
+{
+  d->pos = 0;
+  d->state = DUMP_HEADER;
+}
+
+bool gpio_trace_dump_line(GpioTrace const *t, GpioTraceDump *d, char *line, size_t size)
+{
+  switch (d->state)
+  {
+  case DUMP_HEADER:
+    snprintf(line, size, "trace %lu bytes %lu edges%s\r\n", (unsigned long)t->len, (unsigned long)t->edges,
+             t->truncated ? " truncated" : "");
+    d->state = DUMP_DATA;
+    return true;
+
+  case DUMP_DATA:
+    if (d->pos < t->len && size >= 2 * GPIO_TRACE_LINE_BYTES + 4)
+    {
+      uint32_t const count = t->len - d->pos < GPIO_TRACE_LINE_BYTES ? t->len - d->pos : GPIO_TRACE_LINE_BYTES;
+      char *p = line;
+      *p++ = ':';
+      for (uint32_t i = 0; i < count; i++)
+      {
+        static char const hex[] = "0123456789ABCDEF";
+        uint8_t const b = t->data[d->pos + i];
+        *p++ = hex[b >> 4];
+        *p++ = hex[b & 15];
+      }
+      strcpy(p, "\r\n");
+      d->pos += count;
+      return true;
+    }
+    d->state = DUMP_END;
+    // fall through
+
+  case DUMP_END:
+    snprintf(line, size, "trace end %08lX\r\n", (unsigned long)crc32(t->data, t->len));
+    d->state = DUMP_DONE;
+    return true;
+
+  default:
+    return false;
+  }
+}
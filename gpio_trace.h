@@ -0,0 +1,72 @@
+#ifndef GPIO_TRACE_H_
+#define GPIO_TRACE_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "key_event_queue.h"
+
+// Compact trace of timestamped pin transitions. The device captures the
+// edges its GPIO interrupt and matrix scan see, the host simulation replays
+// them through the same key path (host/plick_replay).
+//
+// Binary layout, little endian:
+//   header  magic "PLTR" u32, version u16, reserved u16, startUs u32
+//   edge    microseconds since the previous edge (since startUs for the
+//           first) << 1 | level as an LEB128 varint, then the event
+//           source, a GPIO or a matrix position (see KEY_EVENT_MATRIX)
+// An edge takes 2 - 3 bytes while typing, 6 at most.
+//
+// Text form, as dumped over CDC:
+//   trace <bytes> bytes <edges> edges [truncated]
+//   :<up to 32 bytes of the binary trace in hex>
+//   ...
+//   trace end <CRC-32 of the binary trace in hex>
+
+#define GPIO_TRACE_MAGIC 0x52544C50u  // "PLTR"
+#define GPIO_TRACE_VERSION 2
+#define GPIO_TRACE_HEADER_LEN 12
+#define GPIO_TRACE_EDGE_MAX_LEN 6
+#define GPIO_TRACE_LINE_BYTES 32
+
+struct GpioTrace
+{
+  uint8_t *data;
+  uint32_t size;
+  uint32_t len;
+  uint32_t edges;
+  uint32_t lastUs;
+  bool truncated;  // edges were dropped because the buffer was full
+};
+
+void gpio_trace_init(GpioTrace *t, uint8_t *buffer, uint32_t size, uint32_t startUs);
+
+// Safe from the interrupt that produces the edges. Nothing else may look at
+// the trace until capture has stopped.
+bool gpio_trace_append(GpioTrace *t, uint8_t pin, bool level, uint32_t timeUs);
+
+struct GpioTraceReader
+{
+  uint8_t const *data;
+  uint32_t len;
+  uint32_t pos;
+  uint32_t timeUs;
+};
+
+// Returns false when the header is not a trace this version can read
+bool gpio_trace_reader_init(GpioTraceReader *r, uint8_t const *data, uint32_t len);
+
+// Returns false at the end of the trace or at a cut off edge
+bool gpio_trace_next(GpioTraceReader *r, KeyEvent *ev);
+
+// Text dump, one line per call. Returns false when there is nothing left.
+struct GpioTraceDump
+{
+  uint32_t pos;
+  uint8_t state;
+};
+
+void gpio_trace_dump_start(GpioTraceDump *d);
+bool gpio_trace_dump_line(GpioTrace const *t, GpioTraceDump *d, char *line, size_t size);
+
+#endif /* GPIO_TRACE_H_ */
@@ -0,0 +1,444 @@
+#include <array>
+
+#include "hid_keycodes.h"
+
+struct HidName
+{
+  char const *name;
+  HidUsage usage;
+};
+
+static constexpr HidName usageNames[] =
+{
+  // Keyboard page
+  { "a", { HID_PAGE_KEYBOARD, 0x04 } },
+  { "b", { HID_PAGE_KEYBOARD, 0x05 } },
+  { "c", { HID_PAGE_KEYBOARD, 0x06 } },
+  { "d", { HID_PAGE_KEYBOARD, 0x07 } },
+  { "e", { HID_PAGE_KEYBOARD, 0x08 } },
+  { "f", { HID_PAGE_KEYBOARD, 0x09 } },
+  { "g", { HID_PAGE_KEYBOARD, 0x0A } },
+  { "h", { HID_PAGE_KEYBOARD, 0x0B } },
+  { "i", { HID_PAGE_KEYBOARD, 0x0C } },
+  { "j", { HID_PAGE_KEYBOARD, 0x0D } },
+  { "k", { HID_PAGE_KEYBOARD, 0x0E } },
+  { "l", { HID_PAGE_KEYBOARD, 0x0F } },
+  { "m", { HID_PAGE_KEYBOARD, 0x10 } },
+  { "n", { HID_PAGE_KEYBOARD, 0x11 } },
+  { "o", { HID_PAGE_KEYBOARD, 0x12 } },
+  { "p", { HID_PAGE_KEYBOARD, 0x13 } },
+  { "q", { HID_PAGE_KEYBOARD, 0x14 } },
+  { "r", { HID_PAGE_KEYBOARD, 0x15 } },
+  { "s", { HID_PAGE_KEYBOARD, 0x16 } },
+  { "t", { HID_PAGE_KEYBOARD, 0x17 } },
+  { "u", { HID_PAGE_KEYBOARD, 0x18 } },
+  { "v", { HID_PAGE_KEYBOARD, 0x19 } },
+  { "w", { HID_PAGE_KEYBOARD, 0x1A } },
+  { "x", { HID_PAGE_KEYBOARD, 0x1B } },
+  { "y", { HID_PAGE_KEYBOARD, 0x1C } },
+  { "z", { HID_PAGE_KEYBOARD, 0x1D } },
+  { "1", { HID_PAGE_KEYBOARD, 0x1E } },
+  { "2", { HID_PAGE_KEYBOARD, 0x1F } },
+  { "3", { HID_PAGE_KEYBOARD, 0x20 } },
+  { "4", { HID_PAGE_KEYBOARD, 0x21 } },
+  { "5", { HID_PAGE_KEYBOARD, 0x22 } },
+  { "6", { HID_PAGE_KEYBOARD, 0x23 } },
+  { "7", { HID_PAGE_KEYBOARD, 0x24 } },
+  { "8", { HID_PAGE_KEYBOARD, 0x25 } },
+  { "9", { HID_PAGE_KEYBOARD, 0x26 } },
+  { "0", { HID_PAGE_KEYBOARD, 0x27 } },
+  { "ENTER", { HID_PAGE_KEYBOARD, 0x28 } },
+  { "ESC", { HID_PAGE_KEYBOARD, 0x29 } },
+  { "ESCAPE", { HID_PAGE_KEYBOARD, 0x29 } },
+  { "BACKSPACE", { HID_PAGE_KEYBOARD, 0x2A } },
+  { "TAB", { HID_PAGE_KEYBOARD, 0x2B } },
+  { "SPACE", { HID_PAGE_KEYBOARD, 0x2C } },
+  { "MINUS", { HID_PAGE_KEYBOARD, 0x2D } },
+  { "EQUAL", { HID_PAGE_KEYBOARD, 0x2E } },
+  { "BRACKET_LEFT", { HID_PAGE_KEYBOARD, 0x2F } },
+  { "BRACKET_RIGHT", { HID_PAGE_KEYBOARD, 0x30 } },
+  { "BACKSLASH", { HID_PAGE_KEYBOARD, 0x31 } },
+  { "EUROPE_1", { HID_PAGE_KEYBOARD, 0x32 } },
+  { "SEMICOLON", { HID_PAGE_KEYBOARD, 0x33 } },
+  { "APOSTROPHE", { HID_PAGE_KEYBOARD, 0x34 } },
+  { "GRAVE", { HID_PAGE_KEYBOARD, 0x35 } },
+  { "COMMA", { HID_PAGE_KEYBOARD, 0x36 } },
+  { "PERIOD", { HID_PAGE_KEYBOARD, 0x37 } },
+  { "SLASH", { HID_PAGE_KEYBOARD, 0x38 } },
+  { "CAPS_LOCK", { HID_PAGE_KEYBOARD, 0x39 } },
+  { "F1", { HID_PAGE_KEYBOARD, 0x3A } },
+  { "F2", { HID_PAGE_KEYBOARD, 0x3B } },
+  { "F3", { HID_PAGE_KEYBOARD, 0x3C } },
+  { "F4", { HID_PAGE_KEYBOARD, 0x3D } },
+  { "F5", { HID_PAGE_KEYBOARD, 0x3E } },
+  { "F6", { HID_PAGE_KEYBOARD, 0x3F } },
+  { "F7", { HID_PAGE_KEYBOARD, 0x40 } },
+  { "F8", { HID_PAGE_KEYBOARD, 0x41 } },
+  { "F9", { HID_PAGE_KEYBOARD, 0x42 } },
+  { "F10", { HID_PAGE_KEYBOARD, 0x43 } },
+  { "F11", { HID_PAGE_KEYBOARD, 0x44 } },
+  { "F12", { HID_PAGE_KEYBOARD, 0x45 } },
+  { "PRINT_SCREEN", { HID_PAGE_KEYBOARD, 0x46 } },
+  { "SCROLL_LOCK", { HID_PAGE_KEYBOARD, 0x47 } },
+  { "PAUSE", { HID_PAGE_KEYBOARD, 0x48 } },
+  { "INSERT", { HID_PAGE_KEYBOARD, 0x49 } },
+  { "HOME", { HID_PAGE_KEYBOARD, 0x4A } },
+  { "PAGE_UP", { HID_PAGE_KEYBOARD, 0x4B } },
+  { "DELETE", { HID_PAGE_KEYBOARD, 0x4C } },
+  { "END", { HID_PAGE_KEYBOARD, 0x4D } },
+  { "PAGE_DOWN", { HID_PAGE_KEYBOARD, 0x4E } },
+  { "RIGHT", { HID_PAGE_KEYBOARD, 0x4F } },
+  { "LEFT", { HID_PAGE_KEYBOARD, 0x50 } },
+  { "DOWN", { HID_PAGE_KEYBOARD, 0x51 } },
+  { "UP", { HID_PAGE_KEYBOARD, 0x52 } },
+  { "NUM_LOCK", { HID_PAGE_KEYBOARD, 0x53 } },
+  { "KEYPAD_DIVIDE", { HID_PAGE_KEYBOARD, 0x54 } },
+  { "KEYPAD_MULTIPLY", { HID_PAGE_KEYBOARD, 0x55 } },
+  { "KEYPAD_SUBTRACT", { HID_PAGE_KEYBOARD, 0x56 } },
+  { "KEYPAD_ADD", { HID_PAGE_KEYBOARD, 0x57 } },
+  { "KEYPAD_ENTER", { HID_PAGE_KEYBOARD, 0x58 } },
+  { "KEYPAD_1", { HID_PAGE_KEYBOARD, 0x59 } },
+  { "KEYPAD_2", { HID_PAGE_KEYBOARD, 0x5A } },
+  { "KEYPAD_3", { HID_PAGE_KEYBOARD, 0x5B } },
+  { "KEYPAD_4", { HID_PAGE_KEYBOARD, 0x5C } },
+  { "KEYPAD_5", { HID_PAGE_KEYBOARD, 0x5D } },
+  { "KEYPAD_6", { HID_PAGE_KEYBOARD, 0x5E } },
+  { "KEYPAD_7", { HID_PAGE_KEYBOARD, 0x5F } },
+  { "KEYPAD_8", { HID_PAGE_KEYBOARD, 0x60 } },
+  { "KEYPAD_9", { HID_PAGE_KEYBOARD, 0x61 } },
+  { "KEYPAD_0", { HID_PAGE_KEYBOARD, 0x62 } },
+  { "KEYPAD_DECIMAL", { HID_PAGE_KEYBOARD, 0x63 } },
+  { "EUROPE_2", { HID_PAGE_KEYBOARD, 0x64 } },
+  { "APPLICATION", { HID_PAGE_KEYBOARD, 0x65 } },
+  { "POWER", { HID_PAGE_KEYBOARD, 0x66 } },
+  { "KEYPAD_EQUAL", { HID_PAGE_KEYBOARD, 0x67 } },
+  { "F13", { HID_PAGE_KEYBOARD, 0x68 } },
+  { "F14", { HID_PAGE_KEYBOARD, 0x69 } },
+  { "F15", { HID_PAGE_KEYBOARD, 0x6A } },
+  { "F16", { HID_PAGE_KEYBOARD, 0x6B } },
+  { "F17", { HID_PAGE_KEYBOARD, 0x6C } },
+  { "F18", { HID_PAGE_KEYBOARD, 0x6D } },
+  { "F19", { HID_PAGE_KEYBOARD, 0x6E } },
+  { "F20", { HID_PAGE_KEYBOARD, 0x6F } },
+  { "F21", { HID_PAGE_KEYBOARD, 0x70 } },
+  { "F22", { HID_PAGE_KEYBOARD, 0x71 } },
+  { "F23", { HID_PAGE_KEYBOARD, 0x72 } },
+  { "F24", { HID_PAGE_KEYBOARD, 0x73 } },
+  { "EXECUTE", { HID_PAGE_KEYBOARD, 0x74 } },
+  { "HELP", { HID_PAGE_KEYBOARD, 0x75 } },
+  { "MENU", { HID_PAGE_KEYBOARD, 0x76 } },
+  { "SELECT", { HID_PAGE_KEYBOARD, 0x77 } },
+  { "STOP", { HID_PAGE_KEYBOARD, 0x78 } },
+  { "AGAIN", { HID_PAGE_KEYBOARD, 0x79 } },
+  { "UNDO", { HID_PAGE_KEYBOARD, 0x7A } },
+  { "CUT", { HID_PAGE_KEYBOARD, 0x7B } },
+  { "COPY", { HID_PAGE_KEYBOARD, 0x7C } },
+  { "PASTE", { HID_PAGE_KEYBOARD, 0x7D } },
+  { "FIND", { HID_PAGE_KEYBOARD, 0x7E } },
+  { "KEYPAD_COMMA", { HID_PAGE_KEYBOARD, 0x85 } },
+  { "INTERNATIONAL1", { HID_PAGE_KEYBOARD, 0x87 } },
+  { "INTERNATIONAL2", { HID_PAGE_KEYBOARD, 0x88 } },
+  { "INTERNATIONAL3", { HID_PAGE_KEYBOARD, 0x89 } },
+  { "INTERNATIONAL4", { HID_PAGE_KEYBOARD, 0x8A } },
+  { "INTERNATIONAL5", { HID_PAGE_KEYBOARD, 0x8B } },
+  { "INTERNATIONAL6", { HID_PAGE_KEYBOARD, 0x8C } },
+  { "INTERNATIONAL7", { HID_PAGE_KEYBOARD, 0x8D } },
+  { "INTERNATIONAL8", { HID_PAGE_KEYBOARD, 0x8E } },
+  { "INTERNATIONAL9", { HID_PAGE_KEYBOARD, 0x8F } },
+  { "LANG1", { HID_PAGE_KEYBOARD, 0x90 } },
+  { "LANG2", { HID_PAGE_KEYBOARD, 0x91 } },
+  { "LANG3", { HID_PAGE_KEYBOARD, 0x92 } },
+  { "LANG4", { HID_PAGE_KEYBOARD, 0x93 } },
+  { "LANG5", { HID_PAGE_KEYBOARD, 0x94 } },
+  { "LANG6", { HID_PAGE_KEYBOARD, 0x95 } },
+  { "LANG7", { HID_PAGE_KEYBOARD, 0x96 } },
+  { "LANG8", { HID_PAGE_KEYBOARD, 0x97 } },
+  { "LANG9", { HID_PAGE_KEYBOARD, 0x98 } },
+
+  // Modifiers, plain names are the left hand keys
+  { "CTRL", { HID_PAGE_KEYBOARD, 0xE0 } },
+  { "SHIFT", { HID_PAGE_KEYBOARD, 0xE1 } },
+  { "ALT", { HID_PAGE_KEYBOARD, 0xE2 } },
+  { "GUI", { HID_PAGE_KEYBOARD, 0xE3 } },
+  { "LCTRL", { HID_PAGE_KEYBOARD, 0xE0 } },
+  { "LSHIFT", { HID_PAGE_KEYBOARD, 0xE1 } },
+  { "LALT", { HID_PAGE_KEYBOARD, 0xE2 } },
+  { "LGUI", { HID_PAGE_KEYBOARD, 0xE3 } },
+  { "RCTRL", { HID_PAGE_KEYBOARD, 0xE4 } },
+  { "RSHIFT", { HID_PAGE_KEYBOARD, 0xE5 } },
+  { "RALT", { HID_PAGE_KEYBOARD, 0xE6 } },
+  { "RGUI", { HID_PAGE_KEYBOARD, 0xE7 } },
+
+  // Consumer control page
+  { "RECORD", { HID_PAGE_CONSUMER, 0x0B2 } },
+  { "FAST_FORWARD", { HID_PAGE_CONSUMER, 0x0B3 } },
+  { "REWIND", { HID_PAGE_CONSUMER, 0x0B4 } },
+  { "NEXT_TRACK", { HID_PAGE_CONSUMER, 0x0B5 } },
+  { "PREV_TRACK", { HID_PAGE_CONSUMER, 0x0B6 } },
+  { "MEDIA_STOP", { HID_PAGE_CONSUMER, 0x0B7 } },
+  { "EJECT", { HID_PAGE_CONSUMER, 0x0B8 } },
+  { "PLAY_PAUSE", { HID_PAGE_CONSUMER, 0x0CD } },
+  { "MUTE", { HID_PAGE_CONSUMER, 0x0E2 } },
+  { "VOLUME_UP", { HID_PAGE_CONSUMER, 0x0E9 } },
+  { "VOLUME_DOWN", { HID_PAGE_CONSUMER, 0x0EA } },
+  { "BRIGHTNESS_UP", { HID_PAGE_CONSUMER, 0x06F } },
+  { "BRIGHTNESS_DOWN", { HID_PAGE_CONSUMER, 0x070 } },
+  { "MEDIA_SELECT", { HID_PAGE_CONSUMER, 0x183 } },
+  { "MAIL", { HID_PAGE_CONSUMER, 0x18A } },
+  { "CALCULATOR", { HID_PAGE_CONSUMER, 0x192 } },
+  { "MY_COMPUTER", { HID_PAGE_CONSUMER, 0x194 } },
+  { "BROWSER", { HID_PAGE_CONSUMER, 0x196 } },
+  { "WWW_SEARCH", { HID_PAGE_CONSUMER, 0x221 } },
+  { "WWW_HOME", { HID_PAGE_CONSUMER, 0x223 } },
+  { "WWW_BACK", { HID_PAGE_CONSUMER, 0x224 } },
+  { "WWW_FORWARD", { HID_PAGE_CONSUMER, 0x225 } },
+  { "WWW_STOP", { HID_PAGE_CONSUMER, 0x226 } },
+  { "WWW_REFRESH", { HID_PAGE_CONSUMER, 0x227 } },
+  { "WWW_FAVORITES", { HID_PAGE_CONSUMER, 0x22A } },
+
+  // Mouse buttons
+  { "MOUSE_LEFT", { HID_PAGE_MOUSE, 1 } },
+  { "MOUSE_RIGHT", { HID_PAGE_MOUSE, 2 } },
+  { "MOUSE_MIDDLE", { HID_PAGE_MOUSE, 3 } },
+  { "MOUSE_BACK", { HID_PAGE_MOUSE, 4 } },
+  { "MOUSE_FORWARD", { HID_PAGE_MOUSE, 5 } },
+
+  // Gamepad buttons
+  { "GAMEPAD_1", { HID_PAGE_GAMEPAD, 1 } },
+  { "GAMEPAD_2", { HID_PAGE_GAMEPAD, 2 } },
+  { "GAMEPAD_3", { HID_PAGE_GAMEPAD, 3 } },
+  { "GAMEPAD_4", { HID_PAGE_GAMEPAD, 4 } },
+  { "GAMEPAD_5", { HID_PAGE_GAMEPAD, 5 } },
+  { "GAMEPAD_6", { HID_PAGE_GAMEPAD, 6 } },
+  { "GAMEPAD_7", { HID_PAGE_GAMEPAD, 7 } },
+  { "GAMEPAD_8", { HID_PAGE_GAMEPAD, 8 } },
+  { "GAMEPAD_9", { HID_PAGE_GAMEPAD, 9 } },
+  { "GAMEPAD_10", { HID_PAGE_GAMEPAD, 10 } },
+  { "GAMEPAD_11", { HID_PAGE_GAMEPAD, 11 } },
+  { "GAMEPAD_12", { HID_PAGE_GAMEPAD, 12 } },
+  { "GAMEPAD_13", { HID_PAGE_GAMEPAD, 13 } },
+  { "GAMEPAD_14", { HID_PAGE_GAMEPAD, 14 } },
+  { "GAMEPAD_15", { HID_PAGE_GAMEPAD, 15 } },
+  { "GAMEPAD_16", { HID_PAGE_GAMEPAD, 16 } },
+};
+
+static constexpr size_t USAGE_NAME_COUNT = sizeof(usageNames) / sizeof(usageNames[0]);
+
+// Compares a length delimited name with a null terminated one, like strcmp
+static constexpr int compare_name(char const *a, size_t alen, char const *b)
+{
+  size_t i = 0;
+  for (; i < alen && b[i] != 0; i++)
+  {
+    if (a[i] != b[i])
+      return (unsigned char)a[i] < (unsigned char)b[i] ? -1 : 1;
+  }
+  if (i == alen)
+    return b[i] == 0 ? 0 : -1;
+  return 1;
+}
+
+static constexpr size_t name_length(char const *s)
+{
+  size_t len = 0;
+  while (s[len])
+    len++;
+  return len;
+}
+
+static constexpr std::array<HidName, USAGE_NAME_COUNT> sort_names(void)
+{
+  std::array<HidName, USAGE_NAME_COUNT> sorted{};
+  for (size_t i = 0; i < USAGE_NAME_COUNT; i++)
+  {
+    sorted[i] = usageNames[i];
+  }
+
+  // Insertion sort, only ever runs in the compiler
+  for (size_t i = 1; i < USAGE_NAME_COUNT; i++)
+  {
+    HidName const item = sorted[i];
+    size_t j = i;
+    while (j > 0 && compare_name(item.name, name_length(item.name), sorted[j - 1].name) < 0)
+    {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+    sorted[j] = item;
+  }
+  return sorted;
+}
+
+static constexpr std::array<HidName, USAGE_NAME_COUNT> sortedNames = sort_names();
+
+static constexpr bool names_unique(void)
+{
+  for (size_t i = 1; i < USAGE_NAME_COUNT; i++)
+  {
+    if (compare_name(sortedNames[i].name, name_length(sortedNames[i].name), sortedNames[i - 1].name) == 0)
+      return false;
+  }
+  return true;
+}
+
+static_assert(names_unique(), "Duplicate key name in usageNames");
+
+bool hid_usage_lookup(char const *name, size_t len, HidUsage *usage)
+{
+  size_t lo = 0;
+  size_t hi = USAGE_NAME_COUNT;
+
+  while (lo < hi)
+  {
+    size_t const mid = (lo + hi) / 2;
+    int const cmp = compare_name(name, len, sortedNames[mid].name);
+    if (cmp == 0)
+    {
+      *usage = sortedNames[mid].usage;
+      return true;
+    }
+    if (cmp < 0)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  return false;
+}
+
+struct AsciiKey
+{
+  char c;
+  uint8_t shift;
+  uint8_t keycode;  // 0 when the character cannot be typed
+};
+
+// US layout
+static constexpr AsciiKey asciiList[] =
+{
+  { '\t', 0, 0x2B },
+  { '\n', 0, 0x28 },
+  { ' ', 0, 0x2C },
+  { '!', 1, 0x1E },
+  { '"', 1, 0x34 },
+  { '#', 1, 0x20 },
+  { '$', 1, 0x21 },
+  { '%', 1, 0x22 },
+  { '&', 1, 0x24 },
+  { '\'', 0, 0x34 },
+  { '(', 1, 0x26 },
+  { ')', 1, 0x27 },
+  { '*', 1, 0x25 },
+  { '+', 1, 0x2E },
+  { ',', 0, 0x36 },
+  { '-', 0, 0x2D },
+  { '.', 0, 0x37 },
+  { '/', 0, 0x38 },
+  { '0', 0, 0x27 },
+  { '1', 0, 0x1E },
+  { '2', 0, 0x1F },
+  { '3', 0, 0x20 },
+  { '4', 0, 0x21 },
+  { '5', 0, 0x22 },
+  { '6', 0, 0x23 },
+  { '7', 0, 0x24 },
+  { '8', 0, 0x25 },
+  { '9', 0, 0x26 },
+  { ':', 1, 0x33 },
+  { ';', 0, 0x33 },
+  { '<', 1, 0x36 },
+  { '=', 0, 0x2E },
+  { '>', 1, 0x37 },
+  { '?', 1, 0x38 },
+  { '@', 1, 0x1F },
+  { 'A', 1, 0x04 },
+  { 'B', 1, 0x05 },
+  { 'C', 1, 0x06 },
+  { 'D', 1, 0x07 },
+  { 'E', 1, 0x08 },
+  { 'F', 1, 0x09 },
+  { 'G', 1, 0x0A },
+  { 'H', 1, 0x0B },
+  { 'I', 1, 0x0C },
+  { 'J', 1, 0x0D },
+  { 'K', 1, 0x0E },
+  { 'L', 1, 0x0F },
+  { 'M', 1, 0x10 },
+  { 'N', 1, 0x11 },
+  { 'O', 1, 0x12 },
+  { 'P', 1, 0x13 },
+  { 'Q', 1, 0x14 },
+  { 'R', 1, 0x15 },
+  { 'S', 1, 0x16 },
+  { 'T', 1, 0x17 },
+  { 'U', 1, 0x18 },
+  { 'V', 1, 0x19 },
+  { 'W', 1, 0x1A },
+  { 'X', 1, 0x1B },
+  { 'Y', 1, 0x1C },
+  { 'Z', 1, 0x1D },
+  { '[', 0, 0x2F },
+  { '\\', 0, 0x31 },
+  { ']', 0, 0x30 },
+  { '^', 1, 0x23 },
+  { '_', 1, 0x2D },
+  { '`', 0, 0x35 },
+  { 'a', 0, 0x04 },
+  { 'b', 0, 0x05 },
+  { 'c', 0, 0x06 },
+  { 'd', 0, 0x07 },
+  { 'e', 0, 0x08 },
+  { 'f', 0, 0x09 },
+  { 'g', 0, 0x0A },
+  { 'h', 0, 0x0B },
+  { 'i', 0, 0x0C },
+  { 'j', 0, 0x0D },
+  { 'k', 0, 0x0E },
+  { 'l', 0, 0x0F },
+  { 'm', 0, 0x10 },
+  { 'n', 0, 0x11 },
+  { 'o', 0, 0x12 },
+  { 'p', 0, 0x13 },
+  { 'q', 0, 0x14 },
+  { 'r', 0, 0x15 },
+  { 's', 0, 0x16 },
+  { 't', 0, 0x17 },
+  { 'u', 0, 0x18 },
+  { 'v', 0, 0x19 },
+  { 'w', 0, 0x1A },
+  { 'x', 0, 0x1B },
+  { 'y', 0, 0x1C },
+  { 'z', 0, 0x1D },
+  { '{', 1, 0x2F },
+  { '|', 1, 0x31 },
+  { '}', 1, 0x30 },
+  { '~', 1, 0x35 },
+};
+
+static constexpr std::array<AsciiKey, 128> index_ascii(void)
+{
+  std::array<AsciiKey, 128> keys = {};
+  for (AsciiKey const &k : asciiList)
+    keys[(unsigned char)k.c] = k;
+  return keys;
+}
+
+static constexpr std::array<AsciiKey, 128> asciiKeys = index_ascii();
+
+bool hid_ascii_lookup(char c, uint8_t *keycode, bool *shift)
+{
+  if ((unsigned char)c >= 128 || asciiKeys[(unsigned char)c].keycode == 0)
+    return false;
+  *keycode = asciiKeys[(unsigned char)c].keycode;
+  *shift = asciiKeys[(unsigned char)c].shift;
+  return true;
+}
+
+size_t hid_usage_count(void)
+{
+  return USAGE_NAME_COUNT;
+}
+
+char const *hid_usage_name(size_t index)
+{
+  return index < USAGE_NAME_COUNT ? sortedNames[index].name : NULL;
+}
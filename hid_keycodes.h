@@ -0,0 +1,36 @@
+#ifndef HID_KEYCODES_H_
+#define HID_KEYCODES_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Key names used in the keymap file and the HID usage they stand for.
+// The table is sorted at compile time and searched by bisection, no heap.
+
+enum HidUsagePage : uint8_t
+{
+  HID_PAGE_NONE = 0,
+  HID_PAGE_KEYBOARD,   // 0x07, modifiers are usages 0xE0 - 0xE7
+  HID_PAGE_CONSUMER,   // 0x0C
+  HID_PAGE_MOUSE,      // 0x09 buttons of the mouse report, 1 - 5
+  HID_PAGE_GAMEPAD,    // 0x09 buttons of the gamepad report, 1 - 16
+};
+
+struct HidUsage
+{
+  uint8_t page;
+  uint16_t code;
+};
+
+// name does not need to be null terminated
+bool hid_usage_lookup(char const *name, size_t len, HidUsage *usage);
+
+// Keyboard usage that types an ASCII character on a US layout, and whether
+// it needs shift. Printable characters, '\n' and '\t' only.
+bool hid_ascii_lookup(char c, uint8_t *keycode, bool *shift);
+
+// Iterate over every known name, in sorted order
+size_t hid_usage_count(void);
+char const *hid_usage_name(size_t index);
+
+#endif /* HID_KEYCODES_H_ */
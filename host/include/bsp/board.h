@@ -0,0 +1,17 @@
+#ifndef SIM_BSP_BOARD_H_
+#define SIM_BSP_BOARD_H_
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t board_millis(void);
+void board_led_write(bool state);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_BSP_BOARD_H_ */
@@ -0,0 +1,58 @@
+#ifndef SIM_PICO_STDLIB_H_
+#define SIM_PICO_STDLIB_H_
+
+// Host stand-in for the parts of the Pico SDK the firmware uses. Time is
+// the simulated clock from sim_hal.h.
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef unsigned int uint;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+uint32_t time_us_32(void);
+uint64_t time_us_64(void);
+
+static inline void tight_loop_contents(void) {}
+
+#define count_of(a) (sizeof(a) / sizeof((a)[0]))
+
+typedef int32_t alarm_id_t;
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+
+// Fires from sim_advance_us() once the simulated time is reached
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past);
+bool cancel_alarm(alarm_id_t alarm_id);
+
+typedef struct repeating_timer repeating_timer_t;
+typedef bool (*repeating_timer_callback_t)(repeating_timer_t *rt);
+
+struct repeating_timer
+{
+  int64_t delay_us;
+  alarm_id_t alarm_id;
+  repeating_timer_callback_t callback;
+  void *user_data;
+};
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out);
+bool cancel_repeating_timer(repeating_timer_t *timer);
+
+// The simulated clock does not move while code runs
+static inline void busy_wait_us_32(uint32_t delay_us)
+{
+  (void)delay_us;
+}
+
+void panic(char const *fmt, ...);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_PICO_STDLIB_H_ */
@@ -0,0 +1,18 @@
+#ifndef SIM_SD_CARD_H_
+#define SIM_SD_CARD_H_
+
+#include <stdbool.h>
+
+// The card is the disk image opened with sim_disk_open()
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool sd_init_driver(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_SD_CARD_H_ */
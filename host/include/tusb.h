@@ -0,0 +1,80 @@
+#ifndef SIM_TUSB_H_
+#define SIM_TUSB_H_
+
+// Host stand-in for the TinyUSB device calls the firmware makes. The
+// endpoint and the host side are simulated in sim_hal.cpp.
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define CFG_TUD_CDC 1
+#define CFG_TUD_MSC 1
+
+#define HID_PROTOCOL_BOOT 0
+#define HID_PROTOCOL_REPORT 1
+
+#define KEYBOARD_LED_NUMLOCK (1u << 0)
+#define KEYBOARD_LED_CAPSLOCK (1u << 1)
+
+enum
+{
+  SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL = 0x1E,
+};
+
+enum
+{
+  SCSI_SENSE_NONE = 0x00,
+  SCSI_SENSE_NOT_READY = 0x02,
+  SCSI_SENSE_MEDIUM_ERROR = 0x03,
+  SCSI_SENSE_ILLEGAL_REQUEST = 0x05,
+};
+
+typedef enum
+{
+  HID_REPORT_TYPE_INVALID = 0,
+  HID_REPORT_TYPE_INPUT,
+  HID_REPORT_TYPE_OUTPUT,
+  HID_REPORT_TYPE_FEATURE,
+} hid_report_type_t;
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+bool tud_mounted(void);
+bool tud_suspended(void);
+bool tud_remote_wakeup(void);
+bool tud_connect(void);
+bool tud_disconnect(void);
+void tud_sof_cb_enable(bool en);
+
+bool tud_hid_ready(void);
+bool tud_hid_report(uint8_t report_id, void const *report, uint16_t len);
+uint8_t tud_hid_get_protocol(void);
+
+bool tud_cdc_n_connected(uint8_t itf);
+uint32_t tud_cdc_n_available(uint8_t itf);
+uint32_t tud_cdc_n_read(uint8_t itf, void *buffer, uint32_t bufsize);
+uint32_t tud_cdc_n_write(uint8_t itf, void const *buffer, uint32_t bufsize);
+uint32_t tud_cdc_n_write_available(uint8_t itf);
+uint32_t tud_cdc_n_write_flush(uint8_t itf);
+
+bool tud_msc_set_sense(uint8_t lun, uint8_t sense_key, uint8_t add_sense_code, uint8_t add_sense_qualifier);
+
+// Implemented by the firmware
+void tud_sof_cb(uint32_t frame_count);
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint16_t len);
+void tud_hid_set_protocol_cb(uint8_t instance, uint8_t protocol);
+void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16], uint8_t product_rev[4]);
+bool tud_msc_test_unit_ready_cb(uint8_t lun);
+void tud_msc_capacity_cb(uint8_t lun, uint32_t *block_count, uint16_t *block_size);
+bool tud_msc_start_stop_cb(uint8_t lun, uint8_t power_condition, bool start, bool load_eject);
+int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void *buffer, uint32_t bufsize);
+int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t *buffer, uint32_t bufsize);
+int32_t tud_msc_scsi_cb(uint8_t lun, uint8_t const scsi_cmd[16], void *buffer, uint16_t bufsize);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* SIM_TUSB_H_ */
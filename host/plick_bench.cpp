@@ -0,0 +1,595 @@
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "tusb.h"
+
+#include "sim_hal.h"
+#include "keyboard.h"
+#include "key_event_queue.h"
+#include "debounce.h"
+#include "keyboard_report.h"
+#include "type_encoder.h"
+#include "hid_keycodes.h"
+#include "config_parser.h"
+#include "sd_storage.h"
+#include "msc_disk.h"
+#include "latency.h"
+#include "matrix.h"
+#include "core1.h"
+
+// Throughput of the key pipeline and the cost of each stage, measured on
+// the host with the firmware modules running on the simulated HAL.
+//
+//   plick_bench [--events N] [--disk image|--no-disk] [--min-events-per-sec N]
+//
+// Exits with 1 when the pipeline is slower than --min-events-per-sec, so
+// the benchmark can gate a build.
+
+#define BENCH_KEYS 16
+#define BENCH_DISK_BYTES (16u * 1024 * 1024)
+#define BENCH_UPLOAD_BYTES (1024u * 1024)
+#define BENCH_UPLOAD_CHUNK 256
+#define BENCH_MSC_LBA 8192
+#define BENCH_MSC_BYTES (4u * 1024 * 1024)
+
+typedef std::chrono::steady_clock Clock;
+
+// Results go here so the measured loops are not optimized away
+static volatile uint32_t sink;
+
+static double seconds_since(Clock::time_point start)
+{
+  return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+static void print_rate(char const *name, uint64_t ops, double seconds, char const *unit)
+{
+  printf("%-16s %12.0f %s/s %10.1f ns/op\r\n", name, ops / seconds, unit, seconds * 1e9 / ops);
+}
+
+static void parser_error(void *context, uint32_t line, uint32_t column, char const *message)
+{
+  (void)context;
+  printf("ERROR: keymap %lu:%lu: %s\r\n", (unsigned long)line, (unsigned long)column, message);
+}
+
+static bool load_keymap(char const *text)
+{
+  static uint8_t const pins[] = KEYMAP_DEFAULT_PINS;
+  ConfigParser parser;
+  config_parser_init(&parser, &keymap, pins, sizeof(pins));
+  parser.onError = parser_error;
+  config_parser_feed(&parser, text, strlen(text));
+  return config_parser_finish(&parser);
+}
+
+//--------------------------------------------------------------------+
+// Stages
+//--------------------------------------------------------------------+
+// GPIO edge through the interrupt handler into the event queue
+static void bench_isr(uint32_t events)
+{
+  KeyEvent ev;
+  Clock::time_point const start = Clock::now();
+  for (uint32_t i = 0; i < events; i++)
+  {
+    sim_gpio_set(i % BENCH_KEYS, !((i / BENCH_KEYS) & 1));
+    key_event_pop(&ev);
+  }
+  print_rate("isr+queue", events, seconds_since(start), "events");
+
+  // The key path never saw these edges, leave the pins where it thinks they are
+  for (int pin = 0; pin < BENCH_KEYS; pin++)
+    sim_gpio_set(pin, false);
+  while (key_event_pop(&ev))
+    ;
+}
+
+static void bench_debounce(uint32_t events)
+{
+  Debouncer d;
+  uint32_t changes = 0;
+  Clock::time_point const start = Clock::now();
+  for (uint32_t i = 0; i < events; i++)
+  {
+    // Bounce three times, then settle past the lockout
+    uint32_t const t = i * 2000;
+    changes += debounce_poll(&d, t);
+    changes += debounce_edge(&d, (i >> 2) & 1, t);
+  }
+  sink = changes;
+  print_rate("debounce", events, seconds_since(start), "edges");
+}
+
+static void bench_report(uint32_t events)
+{
+  KeyboardState state;
+  KeyboardReportCache cache;
+  uint8_t report[KEYBOARD_REPORT_MAX_LEN];
+  uint32_t changed = 0;
+  Clock::time_point const start = Clock::now();
+  for (uint32_t i = 0; i < events; i++)
+  {
+    uint8_t const keycode = 4 + i % BENCH_KEYS;
+    if ((i / BENCH_KEYS) & 1)
+      keyboard_state_remove(&state, keycode);
+    else
+      keyboard_state_add(&state, keycode);
+
+    uint16_t const len = keyboard_report_nkro(&state, report);
+    if (keyboard_report_differs(&cache, report, len))
+    {
+      keyboard_report_store(&cache, report, len);
+      changed++;
+    }
+  }
+  sink = changed;
+  print_rate("report build", events, seconds_since(start), "reports");
+}
+
+// Edge in, report out and read by the host, with the endpoint completing
+// right away so the frame rate does not limit the loop
+static double bench_pipeline(uint32_t events)
+{
+  uint32_t const reportsBefore = sim_usb_stats()->completed;
+  Clock::time_point const start = Clock::now();
+  for (uint32_t i = 0; i < events; i++)
+  {
+    sim_gpio_set(i % BENCH_KEYS, !((i / BENCH_KEYS) & 1));
+    hid_task();
+    sim_usb_complete();
+  }
+  double const seconds = seconds_since(start);
+  print_rate("pipeline", events, seconds, "events");
+
+  uint32_t const reports = sim_usb_stats()->completed - reportsBefore;
+  if (reports != events)
+    printf("ERROR: %lu events gave %lu reports\r\n", (unsigned long)events, (unsigned long)reports);
+  return events / seconds;
+}
+
+// Same path on the simulated clock: one edge about every 2 ms, drifting
+// against the frames, and reports go out on the host's polls. Shows the
+// latency the firmware adds per stage.
+static void bench_latency(uint32_t events)
+{
+  latency_reset();
+  for (uint32_t i = 0; i < events; i++)
+  {
+    sim_gpio_set(i % BENCH_KEYS, !((i / BENCH_KEYS) & 1));
+    scan_task();
+    hid_task();
+    sim_advance_us(1937);
+  }
+  sim_advance_us(20000);
+
+  static char const *const names[] = { "debounce", "queue", "usb", "total", "taphold" };
+  for (int s = 0; s < LATENCY_STAGE_COUNT; s++)
+  {
+    LatencyHistogram const *h = latency_histogram((LatencyStage)s);
+    if (!h->count)
+      continue;
+    printf("latency %-8s %8lu samples  mean %6lu us  p50 %6lu us  p99 %6lu us\r\n", names[s], (unsigned long)h->count,
+           (unsigned long)(h->sum / h->count), (unsigned long)latency_percentile(h, 500),
+           (unsigned long)latency_percentile(h, 990));
+  }
+}
+
+// 8 x 16 matrix with a key at every position, 128 keys on 24 pins. The
+// cost per scan includes the simulated pins here, the console "matrix"
+// command shows what it is on the device.
+static void bench_matrix(uint32_t changes)
+{
+  char text[2048];
+  size_t len = snprintf(text, sizeof(text), "rows=0,1,2,3,4,5,6,7 cols=8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23\n");
+  for (int i = 0; i < 128; i++)
+    len += snprintf(text + len, sizeof(text) - len, "%c:none\n", 'a' + i % 26);
+  if (!load_keymap(text))
+    return;
+  init_buttons();
+  hid_task();
+  sim_usb_complete();
+
+  // Firmware side only, the simulated GPIO reads are left out
+  uint32_t const scans = changes * 10;
+  uint64_t const hardwareBefore = sim_hardware_ns();
+  Clock::time_point const start = Clock::now();
+  for (uint32_t i = 0; i < scans; i++)
+    matrix_scan();
+  print_rate("matrix scan", scans, seconds_since(start) - (sim_hardware_ns() - hardwareBefore) / 1e9, "scans");
+
+  // Taps walking through the matrix. Every change is seen by the 1 kHz scan
+  // and reported on the next frame.
+  matrix_reset_stats();
+  uint32_t const reportsBefore = sim_usb_stats()->completed;
+  for (uint32_t i = 0; i < changes; i++)
+  {
+    uint32_t const position = i / 2 % 128;
+    sim_matrix_key(&keymap.matrix, position / 16, position % 16, !(i & 1));
+    sim_advance_us(1000);
+    hid_task();
+  }
+  sim_advance_us(2000);
+
+  MatrixStats const *stats = matrix_stats();
+  uint32_t const reports = sim_usb_stats()->completed - reportsBefore;
+  printf("matrix 8x16      %12lu changes %8lu reports %8lu scans %lu ghosted\r\n", (unsigned long)changes,
+         (unsigned long)reports, (unsigned long)stats->scans, (unsigned long)stats->ghosts);
+  if (reports != changes)
+    printf("ERROR: %lu matrix changes gave %lu reports\r\n", (unsigned long)changes, (unsigned long)reports);
+}
+
+// Firmware time per simulated second for one scanner, with taps walking
+// through an 8x16 matrix scanned at 20 kHz
+static double run_scanner(KeymapScanner scanner, uint32_t changes)
+{
+  char text[2048];
+  size_t len = snprintf(text, sizeof(text), "scanner=%s rows=0,1,2,3,4,5,6,7 cols=8,9,10,11,12,13,14,15,16,17,18,19,20,21,22,23\n",
+                        scanner == KEYMAP_SCANNER_PIO ? "pio" : "cpu");
+  for (int i = 0; i < 128; i++)
+    len += snprintf(text + len, sizeof(text) - len, "%c:none\n", 'a' + i % 26);
+  if (!load_keymap(text))
+    return 0;
+  // The parser keeps the CPU scanner at 100 us and up
+  keymap.matrix.scanUs = 50;
+  init_buttons();
+  hid_task();
+  sim_usb_complete();
+
+  matrix_reset_stats();
+  uint32_t const reportsBefore = sim_usb_stats()->completed;
+  uint64_t const hardwareBefore = sim_hardware_ns();
+  Clock::time_point const start = Clock::now();
+  for (uint32_t i = 0; i < changes; i++)
+  {
+    uint32_t const position = i / 2 % 128;
+    sim_matrix_key(&keymap.matrix, position / 16, position % 16, !(i & 1));
+    sim_advance_us(1000);
+    hid_task();
+  }
+  sim_advance_us(2000);
+  double const seconds = seconds_since(start) - (sim_hardware_ns() - hardwareBefore) / 1e9;
+
+  bool const pio = scanner == KEYMAP_SCANNER_PIO;
+  MatrixStats const *stats = matrix_stats();
+  uint32_t const reports = sim_usb_stats()->completed - reportsBefore;
+  double const msPerSecond = seconds * 1000 / ((changes + 2) / 1000.0);
+  printf("matrix %s 20 kHz %12.3f ms/s %8lu reports %8lu scans %lu changed\r\n", pio ? "pio" : "cpu", msPerSecond,
+         (unsigned long)reports, (unsigned long)stats->scans, (unsigned long)stats->changed);
+  if (reports != changes)
+    printf("ERROR: %lu matrix changes gave %lu reports\r\n", (unsigned long)changes, (unsigned long)reports);
+  if (pio != matrix_uses_pio())
+    printf("ERROR: matrix is not using the %s scanner\r\n", pio ? "pio" : "cpu");
+  return msPerSecond;
+}
+
+// Both scanners on the same matrix and taps. Host time counts only the
+// firmware side, the PIO and the GPIO reads are left out. On the device
+// the CPU scanner also waits for every driven line to settle.
+static void bench_scanners(uint32_t changes)
+{
+  double const cpu = run_scanner(KEYMAP_SCANNER_CPU, changes);
+  double const pio = run_scanner(KEYMAP_SCANNER_PIO, changes);
+  double const settle = 8 * MATRIX_SETTLE_US * 20000 / 1000.0;
+  if (cpu > 0)
+    printf("matrix pio saves %12.1f %% of the cpu scanner, plus %.0f ms/s settling on the device\r\n",
+           (cpu - pio) * 100 / cpu, settle);
+}
+
+// A dual-role key, a when tapped and SHIFT when held, in rolls with the
+// next key and in shifted taps, 30 ms between edges. The tapping term is
+// 200 ms, the histogram shows how long the key actually kept the keys
+// after it waiting.
+static void run_tap_hold(char const *mode, uint32_t sequences)
+{
+  char text[128];
+  snprintf(text, sizeof(text), "taphold=%s a:pin=0:none:hold=SHIFT b:pin=1:none\n", mode);
+
+  // Keys left pressed by the benchmarks before
+  sim_gpio_set(0, false);
+  sim_gpio_set(1, false);
+  hid_task();
+  sim_advance_us(2000);
+  if (!load_keymap(text))
+    return;
+  init_buttons();
+  hid_task();
+  sim_usb_complete();
+
+  // pin and level per edge, a roll and then a shifted b
+  static uint8_t const edges[][2] = { { 0, 1 }, { 1, 1 }, { 0, 0 }, { 1, 0 }, { 0, 1 }, { 1, 1 }, { 1, 0 }, { 0, 0 } };
+  latency_reset();
+  uint32_t const reportsBefore = sim_usb_stats()->completed;
+  for (uint32_t i = 0; i < sequences * 4; i++)
+  {
+    uint8_t const *edge = edges[i % 8];
+    sim_gpio_set(edge[0], edge[1]);
+    for (int ms = 0; ms < 30; ms++)
+    {
+      scan_task();
+      hid_task();
+      sim_advance_us(1000);
+    }
+  }
+  sim_advance_us(20000);
+
+  LatencyHistogram const *h = latency_histogram(LATENCY_TAP_HOLD);
+  printf("taphold %-10s %8lu decided  p50 %6lu us  max %6lu us %8lu reports\r\n", mode, (unsigned long)h->count,
+         (unsigned long)latency_percentile(h, 500), (unsigned long)h->max,
+         (unsigned long)(sim_usb_stats()->completed - reportsBefore));
+}
+
+static void bench_tap_hold(uint32_t sequences)
+{
+  run_tap_hold("permissive", sequences);
+  run_tap_hold("timeout", sequences);
+  run_tap_hold("press", sequences);
+}
+
+static void bench_type(uint32_t chars)
+{
+  static char const text[] = "The quick brown fox jumps over the lazy dog. PACK MY BOX with 5 dozen liquor jugs!\n";
+  uint32_t const len = sizeof(text) - 1;
+  uint32_t reports = 0;
+  uint32_t typed = 0;
+  Clock::time_point const start = Clock::now();
+  while (typed < chars)
+  {
+    TypeEncoder e;
+    KeyboardState report;
+    type_encoder_init(&e, text, len);
+    while (type_encoder_next(&e, &report))
+      reports++;
+    typed += len;
+  }
+  double const seconds = seconds_since(start);
+  sink = reports;
+  print_rate("type encoder", typed, seconds, "chars");
+  printf("type encoder     %12.2f chars/report\r\n", (double)typed / reports);
+}
+
+// Every name of the key name table in turn, as the parser looks them up
+static void bench_keycodes(uint32_t rounds)
+{
+  size_t const count = hid_usage_count();
+  uint32_t found = 0;
+  Clock::time_point const start = Clock::now();
+  for (uint32_t r = 0; r < rounds; r++)
+  {
+    for (size_t i = 0; i < count; i++)
+    {
+      char const *name = hid_usage_name(i);
+      HidUsage usage;
+      found += hid_usage_lookup(name, strlen(name), &usage);
+    }
+  }
+  double const seconds = seconds_since(start);
+  sink = found;
+  if (found != rounds * count)
+    printf("ERROR: key name did not resolve\r\n");
+  print_rate("key name lookup", (uint64_t)rounds * count, seconds, "names");
+}
+
+static void bench_parser(uint32_t rounds)
+{
+  // Every kind of key the parser knows, 128 keys in all with macros on
+  // every fourth so they fit the macro space
+  static char text[16384];
+  size_t len = 0;
+  len += snprintf(text + len, sizeof(text) - len, "# benchmark keymap\npoll=1\n");
+  for (int i = 0; i < KEYMAP_MAX_KEYS; i++)
+  {
+    char const *line;
+    switch (i % 8)
+    {
+    case 0:
+      line = "CTRL+SHIFT+a:pin=%d:eager=5000\n";
+      break;
+    case 1:
+      line = "ENTER:pin=%d:deferred=8000\n";
+      break;
+    case 2:
+      line = "CTRL+a,CTRL+c,10ms,+SHIFT,h,i,-SHIFT:pin=%d\n";
+      break;
+    case 3:
+      line = "\"ok\\n\":pin=%d:none\n";
+      break;
+    default:
+      line = "SHIFT+F1:pin=%d\n";
+      break;
+    }
+    len += snprintf(text + len, sizeof(text) - len, line, i % NUM_BANK0_GPIOS);
+  }
+
+  static uint8_t const pins[] = KEYMAP_DEFAULT_PINS;
+  static KeymapImage image;
+  uint32_t errors = 0;
+  Clock::time_point const start = Clock::now();
+  for (uint32_t r = 0; r < rounds; r++)
+  {
+    ConfigParser parser;
+    config_parser_init(&parser, &image, pins, sizeof(pins));
+    if (r == 0)
+      parser.onError = parser_error;
+    // Fed in CDC sized chunks like an upload
+    for (size_t pos = 0; pos < len; pos += 64)
+      config_parser_feed(&parser, text + pos, len - pos < 64 ? len - pos : 64);
+    errors += !config_parser_finish(&parser);
+  }
+  double const seconds = seconds_since(start);
+  if (errors)
+    printf("ERROR: benchmark keymap did not parse\r\n");
+  printf("%-16s %12.2f MB/s %10.1f us/keymap\r\n", "config parser", (double)len * rounds / seconds / 1e6,
+         seconds * 1e6 / rounds);
+}
+
+static void bench_storage(char const *image)
+{
+  if (!sim_disk_open(image, BENCH_DISK_BYTES))
+    return;
+
+  FRESULT fr = storage_mount();
+  if (fr != FR_OK)
+  {
+    printf("ERROR: Could not mount %s (%d)\r\n", image, fr);
+    return;
+  }
+  storage_recover("bench.bin");
+
+  static uint8_t chunk[BENCH_UPLOAD_CHUNK];
+  for (int i = 0; i < BENCH_UPLOAD_CHUNK; i++)
+    chunk[i] = (uint8_t)i;
+
+  Clock::time_point const start = Clock::now();
+  fr = storage_upload_begin("bench.bin", BENCH_UPLOAD_BYTES);
+  for (uint32_t sent = 0; fr == FR_OK && sent < BENCH_UPLOAD_BYTES; sent += BENCH_UPLOAD_CHUNK)
+  {
+    fr = storage_upload_write(chunk, BENCH_UPLOAD_CHUNK);
+    if (fr == FR_OK)
+      fr = storage_task();
+  }
+  if (fr == FR_OK)
+    fr = storage_upload_commit();
+  else
+    storage_upload_abort();
+  double const seconds = seconds_since(start);
+
+  if (fr != FR_OK)
+  {
+    printf("ERROR: Upload to %s failed (%d)\r\n", image, fr);
+    return;
+  }
+  StorageStats const *stats = storage_upload_stats();
+  printf("%-16s %12.2f MB/s %10lu f_write calls\r\n", "storage upload", BENCH_UPLOAD_BYTES / seconds / 1e6,
+         (unsigned long)stats->writes);
+  sim_disk_close();
+}
+
+// The host's side of the drive: each chunk is asked for again until core 1,
+// here the same thread, has served it
+static bool msc_chunk(bool write, uint32_t lba, uint8_t *buffer, uint32_t size)
+{
+  int32_t r;
+  while ((r = write ? tud_msc_write10_cb(0, lba, 0, buffer, size) : tud_msc_read10_cb(0, lba, 0, buffer, size)) == 0)
+    msc_task();
+  return r == (int32_t)size;
+}
+
+static bool msc_pass(bool write, uint8_t *data, uint32_t chunk, char const *name)
+{
+  Clock::time_point const start = Clock::now();
+  for (uint32_t pos = 0; pos < BENCH_MSC_BYTES; pos += chunk)
+  {
+    if (!msc_chunk(write, BENCH_MSC_LBA + pos / MSC_BLOCK_SIZE, data + pos, chunk))
+    {
+      printf("ERROR: %s failed at byte %lu\r\n", name, (unsigned long)pos);
+      return false;
+    }
+  }
+  printf("%-16s %12.2f MB/s %10lu B chunks\r\n", name, BENCH_MSC_BYTES / seconds_since(start) / 1e6,
+         (unsigned long)chunk);
+  return true;
+}
+
+// Reads a stretch of the card and writes it back unchanged, as the host
+// would through the USB drive, then ejects it
+static void bench_msc(char const *image)
+{
+  if (!sim_disk_open(image, BENCH_DISK_BYTES) || storage_mount() != FR_OK)
+    return;
+
+  msc_expose();
+  storage_unmount();
+  if (!msc_hand_over())
+  {
+    printf("ERROR: Could not hand %s to the host\r\n", image);
+    return;
+  }
+
+  static uint8_t data[BENCH_MSC_BYTES];
+  static uint8_t check[BENCH_MSC_BYTES];
+  bool ok = msc_pass(false, data, MSC_BLOCK_SIZE, "msc read") && msc_pass(false, data, MSC_TRANSFER_BYTES, "msc read") &&
+            msc_pass(true, data, MSC_TRANSFER_BYTES, "msc write") &&
+            msc_pass(false, check, MSC_TRANSFER_BYTES, "msc read back");
+  if (ok && memcmp(data, check, sizeof(data)) != 0)
+    printf("ERROR: msc read back differs\r\n");
+
+  tud_msc_start_stop_cb(0, 0, false, true);
+  while (!msc_task())
+  {
+  }
+  if (storage_mount() != FR_OK)
+    printf("ERROR: Could not mount %s after the eject\r\n", image);
+  storage_unmount();
+  sim_disk_close();
+}
+
+//--------------------------------------------------------------------+
+// Main
+//--------------------------------------------------------------------+
+int main(int argc, char **argv)
+{
+  uint32_t events = 1000000;
+  char const *disk = "plick_sim.img";
+  double minEventsPerSec = 0;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--events") == 0 && i + 1 < argc)
+      events = strtoul(argv[++i], NULL, 10);
+    else if (strcmp(argv[i], "--disk") == 0 && i + 1 < argc)
+      disk = argv[++i];
+    else if (strcmp(argv[i], "--no-disk") == 0)
+      disk = NULL;
+    else if (strcmp(argv[i], "--min-events-per-sec") == 0 && i + 1 < argc)
+      minEventsPerSec = strtod(argv[++i], NULL);
+    else
+    {
+      printf("usage: %s [--events N] [--disk image|--no-disk] [--min-events-per-sec N]\r\n", argv[0]);
+      return 2;
+    }
+  }
+  if (events < BENCH_KEYS * 2)
+    events = BENCH_KEYS * 2;
+
+  // Keys that report every edge, so each edge is one report
+  char text[BENCH_KEYS * 24];
+  size_t len = 0;
+  for (int i = 0; i < BENCH_KEYS; i++)
+    len += snprintf(text + len, sizeof(text) - len, "%c:pin=%d:none\n", 'a' + i, i);
+  if (!load_keymap(text))
+    return 2;
+
+  tud_sof_cb_enable(true);
+  init_buttons();
+  hid_task();  // the empty report every new key table starts with
+  sim_usb_complete();
+
+  bench_isr(events);
+  bench_debounce(events);
+  bench_report(events);
+  double const eventsPerSec = bench_pipeline(events);
+  bench_latency(events / 100);
+  bench_tap_hold(events / 10000 + 1);
+  bench_matrix(events / 1000 / 256 * 256 + 256);
+  bench_scanners(events / 1000 / 256 * 256 + 256);
+  bench_type(events);
+  bench_keycodes(events / 1000 + 1);
+  bench_parser(events / 10000 + 1);
+  if (disk)
+  {
+    bench_storage(disk);
+    bench_msc(disk);
+  }
+
+  if (eventsPerSec < minEventsPerSec)
+  {
+    printf("ERROR: pipeline %.0f events/s is below %.0f\r\n", eventsPerSec, minEventsPerSec);
+    return 1;
+  }
+  return 0;
+}
@@ -0,0 +1,446 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+#include <vector>
+
+#include "pico/stdlib.h"
+#include "tusb.h"
+
+#include "sim_hal.h"
+#include "keyboard.h"
+#include "keyboard_report.h"
+#include "config_parser.h"
+#include "gpio_trace.h"
+#include "key_event_queue.h"
+#include "latency.h"
+#include "crc32.h"
+#include "core1.h"
+
+// Replays a GPIO trace (see gpio_trace.h) through the key path on the
+// simulated HAL and compares the reports the host reads against a golden
+// file:
+//
+//   plick_replay keymap.txt trace [--golden file [--update]] [--tolerance-us N]
+//
+// The trace is either binary or the text dumped by the "trace dump" console
+// command. The golden file lists every report with the time the host read
+// it, relative to the first edge, then the latency summary per stage. The
+// edges come at fixed times, so a report that arrives later than in the
+// golden file is latency the firmware added for that event.
+//
+// Exits with 1 when a report differs, or arrives or a p99 latency grows by
+// more than the tolerance. --update writes the golden file instead.
+
+// The main loop on the device takes a few us per pass, the simulation steps
+// in coarser slices so long traces replay quickly
+#define REPLAY_LOOP_US 20
+#define REPLAY_LEAD_US 100000
+#define REPLAY_TAIL_US 200000
+
+struct ReportRecord
+{
+  uint32_t timeUs;
+  std::vector<uint8_t> report;
+};
+
+struct LatencyRecord
+{
+  char stage[16];
+  uint32_t count;
+  uint32_t mean;
+  uint32_t p50;
+  uint32_t p99;
+  uint32_t max;
+};
+
+struct ReplayResult
+{
+  std::vector<ReportRecord> reports;
+  std::vector<LatencyRecord> latency;
+};
+
+static ReplayResult result;
+static uint64_t baseUs;
+
+static void on_report(uint8_t const *report, uint16_t len)
+{
+  ReportRecord r;
+  r.timeUs = (uint32_t)(time_us_64() - baseUs);
+  r.report.assign(report, report + len);
+  result.reports.push_back(r);
+}
+
+static void parser_error(void *context, uint32_t line, uint32_t column, char const *message)
+{
+  printf("ERROR: %s:%lu:%lu: %s\r\n", (char const *)context, (unsigned long)line, (unsigned long)column, message);
+}
+
+static bool read_file(char const *path, std::vector<uint8_t> *data)
+{
+  FILE *f = fopen(path, "rb");
+  if (!f)
+  {
+    printf("ERROR: Could not open %s\r\n", path);
+    return false;
+  }
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+    data->insert(data->end(), chunk, chunk + n);
+  fclose(f);
+  return true;
+}
+
+static bool load_keymap(char const *path)
+{
+  std::vector<uint8_t> text;
+  if (!read_file(path, &text))
+    return false;
+
+  static uint8_t const pins[] = KEYMAP_DEFAULT_PINS;
+  ConfigParser parser;
+  config_parser_init(&parser, &keymap, pins, sizeof(pins));
+  parser.onError = parser_error;
+  parser.errorContext = (void *)path;
+  config_parser_feed(&parser, (char const *)text.data(), text.size());
+  return config_parser_finish(&parser);
+}
+
+static int hex_digit(char c)
+{
+  if (c >= '0' && c <= '9')
+    return c - '0';
+  if (c >= 'A' && c <= 'F')
+    return c - 'A' + 10;
+  if (c >= 'a' && c <= 'f')
+    return c - 'a' + 10;
+  return -1;
+}
+
+// Text form back to binary. Lines that are not part of the dump, like
+// console output around it, are skipped.
+static bool parse_trace_text(char const *path, std::vector<uint8_t> const &text, std::vector<uint8_t> *trace)
+{
+  bool ended = false;
+  size_t pos = 0;
+  while (pos < text.size() && !ended)
+  {
+    size_t end = pos;
+    while (end < text.size() && text[end] != '\n')
+      end++;
+    std::string line((char const *)&text[pos], end - pos);
+    pos = end + 1;
+    while (!line.empty() && (line.back() == '\r' || line.back() == ' '))
+      line.pop_back();
+
+    unsigned long crc;
+    if (line[0] == ':')
+    {
+      for (size_t i = 1; i + 1 < line.size(); i += 2)
+      {
+        int const hi = hex_digit(line[i]);
+        int const lo = hex_digit(line[i + 1]);
+        if (hi < 0 || lo < 0)
+        {
+          printf("ERROR: %s: bad hex in '%s'\r\n", path, line.c_str());
+          return false;
+        }
+        trace->push_back((uint8_t)(hi << 4 | lo));
+      }
+    }
+    else if (sscanf(line.c_str(), "trace end %lx", &crc) == 1)
+    {
+      if (crc != crc32(trace->data(), trace->size()))
+      {
+        printf("ERROR: %s: CRC mismatch, the dump is damaged\r\n", path);
+        return false;
+      }
+      ended = true;
+    }
+    else if (line.find(" truncated") != std::string::npos && line.compare(0, 6, "trace ") == 0)
+    {
+      printf("%s: trace was truncated on the device, replaying what was captured\r\n", path);
+    }
+  }
+
+  if (!ended)
+  {
+    printf("ERROR: %s: no 'trace end' line\r\n", path);
+    return false;
+  }
+  return true;
+}
+
+static bool load_trace(char const *path, std::vector<uint8_t> *trace)
+{
+  std::vector<uint8_t> data;
+  if (!read_file(path, &data))
+    return false;
+
+  GpioTraceReader reader;
+  if (gpio_trace_reader_init(&reader, data.data(), data.size()))
+  {
+    *trace = data;
+    return true;
+  }
+  if (!parse_trace_text(path, data, trace))
+    return false;
+  if (!gpio_trace_reader_init(&reader, trace->data(), trace->size()))
+  {
+    printf("ERROR: %s: not a trace this version can read\r\n", path);
+    return false;
+  }
+  return true;
+}
+
+// Main loop passes until the simulated clock reaches untilUs
+static void run_until(uint64_t untilUs)
+{
+  while (time_us_64() < untilUs)
+  {
+    scan_task();
+    hid_task();
+    uint64_t const left = untilUs - time_us_64();
+    sim_advance_us(left < REPLAY_LOOP_US ? (uint32_t)left : REPLAY_LOOP_US);
+  }
+  scan_task();
+  hid_task();
+}
+
+static void replay(std::vector<uint8_t> const &trace)
+{
+  GpioTraceReader reader;
+  gpio_trace_reader_init(&reader, trace.data(), trace.size());
+
+  // Times in the trace are the device's, the replay starts after a lead in
+  // so the key table has settled and its first report is out
+  tud_sof_cb_enable(true);
+  init_buttons();
+  baseUs = time_us_64() + REPLAY_LEAD_US;
+  run_until(baseUs);
+
+  latency_reset();
+  sim_usb_set_report_cb(on_report);
+  uint32_t const startUs = reader.timeUs;
+
+  KeyEvent ev;
+  uint32_t edges = 0;
+  while (gpio_trace_next(&reader, &ev))
+  {
+    run_until(baseUs + (uint32_t)(ev.timeUs - startUs));
+    if (ev.pin >= KEY_EVENT_MATRIX)
+    {
+      // The scan finds it again, on the simulated matrix
+      uint8_t const position = ev.pin - KEY_EVENT_MATRIX;
+      if (keymap.matrix.cols)
+        sim_matrix_key(&keymap.matrix, position / keymap.matrix.cols, position % keymap.matrix.cols, ev.level);
+    }
+    else
+    {
+      sim_gpio_edge(ev.pin, ev.level);
+    }
+    edges++;
+  }
+  run_until(time_us_64() + REPLAY_TAIL_US);
+  if (reader.pos != reader.len)
+    printf("WARNING: trace ends in the middle of an edge\r\n");
+
+  static char const *const names[] = { "debounce", "queue", "usb", "total", "taphold" };
+  for (int s = 0; s < LATENCY_STAGE_COUNT; s++)
+  {
+    LatencyHistogram const *h = latency_histogram((LatencyStage)s);
+    LatencyRecord r;
+    snprintf(r.stage, sizeof(r.stage), "%s", names[s]);
+    r.count = h->count;
+    r.mean = h->count ? (uint32_t)(h->sum / h->count) : 0;
+    r.p50 = latency_percentile(h, 500);
+    r.p99 = latency_percentile(h, 990);
+    r.max = h->max;
+    result.latency.push_back(r);
+  }
+  printf("replayed %lu edges, %lu reports\r\n", (unsigned long)edges, (unsigned long)result.reports.size());
+}
+
+//--------------------------------------------------------------------+
+// Golden files
+//--------------------------------------------------------------------+
+static void write_golden(FILE *f, char const *tracePath, ReplayResult const &r)
+{
+  char const *name = strrchr(tracePath, '/');
+  fprintf(f, "# plick_replay %s\n", name ? name + 1 : tracePath);
+  for (ReportRecord const &rec : r.reports)
+  {
+    fprintf(f, "report %lu ", (unsigned long)rec.timeUs);
+    for (uint8_t b : rec.report)
+      fprintf(f, "%02X", b);
+    fprintf(f, "\n");
+  }
+  for (LatencyRecord const &l : r.latency)
+  {
+    fprintf(f, "latency %s n=%lu mean=%lu p50=%lu p99=%lu max=%lu\n", l.stage, (unsigned long)l.count,
+            (unsigned long)l.mean, (unsigned long)l.p50, (unsigned long)l.p99, (unsigned long)l.max);
+  }
+}
+
+static bool read_golden(char const *path, ReplayResult *r)
+{
+  FILE *f = fopen(path, "r");
+  if (!f)
+  {
+    printf("ERROR: Could not open %s, create it with --update\r\n", path);
+    return false;
+  }
+
+  char line[1024];
+  while (fgets(line, sizeof(line), f))
+  {
+    unsigned long timeUs;
+    char hex[sizeof(line)];
+    LatencyRecord l;
+    unsigned long count, mean, p50, p99, max;
+
+    if (sscanf(line, "report %lu %1023s", &timeUs, hex) == 2)
+    {
+      ReportRecord rec;
+      rec.timeUs = timeUs;
+      for (size_t i = 0; hex[i] && hex[i + 1]; i += 2)
+        rec.report.push_back((uint8_t)(hex_digit(hex[i]) << 4 | hex_digit(hex[i + 1])));
+      r->reports.push_back(rec);
+    }
+    else if (sscanf(line, "latency %15s n=%lu mean=%lu p50=%lu p99=%lu max=%lu", l.stage, &count, &mean, &p50, &p99,
+                    &max) == 6)
+    {
+      l.count = count;
+      l.mean = mean;
+      l.p50 = p50;
+      l.p99 = p99;
+      l.max = max;
+      r->latency.push_back(l);
+    }
+  }
+  fclose(f);
+  return true;
+}
+
+static bool compare(ReplayResult const &golden, ReplayResult const &actual, uint32_t toleranceUs)
+{
+  bool ok = true;
+  size_t const count = golden.reports.size() < actual.reports.size() ? golden.reports.size() : actual.reports.size();
+
+  int32_t latest = 0;
+  int32_t earliest = 0;
+  for (size_t i = 0; i < count; i++)
+  {
+    ReportRecord const &g = golden.reports[i];
+    ReportRecord const &a = actual.reports[i];
+    if (g.report != a.report)
+    {
+      printf("FAIL: report %lu at %lu us differs from the golden one\r\n", (unsigned long)i, (unsigned long)a.timeUs);
+      return false;
+    }
+
+    int32_t const delta = (int32_t)(a.timeUs - g.timeUs);
+    if (delta > (int32_t)toleranceUs && ok)
+    {
+      printf("FAIL: report %lu arrived %ld us later than in the golden file\r\n", (unsigned long)i, (long)delta);
+      ok = false;
+    }
+    if (delta > latest)
+      latest = delta;
+    if (delta < earliest)
+      earliest = delta;
+  }
+  if (golden.reports.size() != actual.reports.size())
+  {
+    printf("FAIL: %lu reports, golden file has %lu\r\n", (unsigned long)actual.reports.size(),
+           (unsigned long)golden.reports.size());
+    ok = false;
+  }
+
+  for (LatencyRecord const &a : actual.latency)
+  {
+    for (LatencyRecord const &g : golden.latency)
+    {
+      if (strcmp(a.stage, g.stage) != 0)
+        continue;
+      if (a.p99 > g.p99 + toleranceUs)
+      {
+        printf("FAIL: %s p99 latency %lu us, golden %lu us\r\n", a.stage, (unsigned long)a.p99, (unsigned long)g.p99);
+        ok = false;
+      }
+      printf("latency %-8s p50 %6lu us (golden %6lu)  p99 %6lu us (golden %6lu)\r\n", a.stage, (unsigned long)a.p50,
+             (unsigned long)g.p50, (unsigned long)a.p99, (unsigned long)g.p99);
+    }
+  }
+
+  printf("report times vs golden: %ld us earliest, %+ld us latest\r\n", (long)earliest, (long)latest);
+  return ok;
+}
+
+//--------------------------------------------------------------------+
+// Main
+//--------------------------------------------------------------------+
+int main(int argc, char **argv)
+{
+  char const *keymapPath = NULL;
+  char const *tracePath = NULL;
+  char const *goldenPath = NULL;
+  bool update = false;
+  bool usage = false;
+  uint32_t toleranceUs = 0;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (strcmp(argv[i], "--golden") == 0 && i + 1 < argc)
+      goldenPath = argv[++i];
+    else if (strcmp(argv[i], "--update") == 0)
+      update = true;
+    else if (strcmp(argv[i], "--tolerance-us") == 0 && i + 1 < argc)
+      toleranceUs = strtoul(argv[++i], NULL, 10);
+    else if (!keymapPath)
+      keymapPath = argv[i];
+    else if (!tracePath)
+      tracePath = argv[i];
+    else
+      usage = true;
+  }
+  if (usage || !keymapPath || !tracePath || (update && !goldenPath))
+  {
+    printf("usage: %s keymap.txt trace [--golden file [--update]] [--tolerance-us N]\r\n", argv[0]);
+    return 2;
+  }
+
+  std::vector<uint8_t> trace;
+  if (!load_keymap(keymapPath) || !load_trace(tracePath, &trace))
+    return 2;
+
+  replay(trace);
+
+  if (!goldenPath)
+  {
+    write_golden(stdout, tracePath, result);
+    return 0;
+  }
+  if (update)
+  {
+    FILE *f = fopen(goldenPath, "w");
+    if (!f)
+    {
+      printf("ERROR: Could not write %s\r\n", goldenPath);
+      return 2;
+    }
+    write_golden(f, tracePath, result);
+    fclose(f);
+    return 0;
+  }
+
+  ReplayResult golden;
+  if (!read_golden(goldenPath, &golden))
+    return 2;
+  if (!compare(golden, result, toleranceUs))
+    return 1;
+  printf("OK: %lu reports match %s\r\n", (unsigned long)result.reports.size(), goldenPath);
+  return 0;
+}
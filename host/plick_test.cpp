@@ -0,0 +1,385 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "hid_keycodes.h"
+#include "type_encoder.h"
+#include "keymap.h"
+#include "config_parser.h"
+
+// Checks of single firmware modules against a reference, one case per run
+// so each is its own ctest:
+//
+//   plick_test keycodes   key names give the usages of the HID tables,
+//                         every name resolves, near misses do not
+//   plick_test type       typed reports decode back to the text
+//   plick_test keymap     images out of the parser's limits are rejected
+//
+// Prints what differs and exits with 1 on a failure.
+
+static int failures = 0;
+
+static void fail(char const *format, char const *text)
+{
+  printf("FAIL: ");
+  printf(format, text);
+  printf("\r\n");
+  failures++;
+}
+
+//--------------------------------------------------------------------+
+// Key names
+//--------------------------------------------------------------------+
+// Reference: a straight search through the names the table hands out
+static bool known_name(char const *name, size_t len)
+{
+  for (size_t i = 0; i < hid_usage_count(); i++)
+  {
+    char const *n = hid_usage_name(i);
+    if (strlen(n) == len && memcmp(n, name, len) == 0)
+      return true;
+  }
+  return false;
+}
+
+static void check_variant(char const *name, size_t len)
+{
+  HidUsage usage;
+  bool const found = hid_usage_lookup(name, len, &usage);
+  if (found != known_name(name, len))
+  {
+    char text[64];
+    snprintf(text, sizeof(text), "%.*s", (int)len, name);
+    fail(found ? "'%s' resolves but is no key name" : "'%s' does not resolve", text);
+  }
+}
+
+// Known answers from the HID Usage Tables (keyboard page 0x07, consumer
+// page 0x0C, buttons page 0x09), written out apart from hid_keycodes.cpp
+struct KnownUsage
+{
+  char const *name;
+  uint8_t page;
+  uint16_t code;
+};
+
+static KnownUsage const knownUsages[] = {
+  { "a", HID_PAGE_KEYBOARD, 0x04 },
+  { "z", HID_PAGE_KEYBOARD, 0x1D },
+  { "1", HID_PAGE_KEYBOARD, 0x1E },
+  { "0", HID_PAGE_KEYBOARD, 0x27 },
+  { "ENTER", HID_PAGE_KEYBOARD, 0x28 },
+  { "ESC", HID_PAGE_KEYBOARD, 0x29 },
+  { "SPACE", HID_PAGE_KEYBOARD, 0x2C },
+  { "F1", HID_PAGE_KEYBOARD, 0x3A },
+  { "F2", HID_PAGE_KEYBOARD, 0x3B },
+  { "F3", HID_PAGE_KEYBOARD, 0x3C },
+  { "F4", HID_PAGE_KEYBOARD, 0x3D },
+  { "F5", HID_PAGE_KEYBOARD, 0x3E },
+  { "F6", HID_PAGE_KEYBOARD, 0x3F },
+  { "F7", HID_PAGE_KEYBOARD, 0x40 },
+  { "F8", HID_PAGE_KEYBOARD, 0x41 },
+  { "F9", HID_PAGE_KEYBOARD, 0x42 },
+  { "F10", HID_PAGE_KEYBOARD, 0x43 },
+  { "F11", HID_PAGE_KEYBOARD, 0x44 },
+  { "F12", HID_PAGE_KEYBOARD, 0x45 },
+  { "F13", HID_PAGE_KEYBOARD, 0x68 },
+  { "F14", HID_PAGE_KEYBOARD, 0x69 },
+  { "F15", HID_PAGE_KEYBOARD, 0x6A },
+  { "F16", HID_PAGE_KEYBOARD, 0x6B },
+  { "F17", HID_PAGE_KEYBOARD, 0x6C },
+  { "F18", HID_PAGE_KEYBOARD, 0x6D },
+  { "F19", HID_PAGE_KEYBOARD, 0x6E },
+  { "F20", HID_PAGE_KEYBOARD, 0x6F },
+  { "F21", HID_PAGE_KEYBOARD, 0x70 },
+  { "F22", HID_PAGE_KEYBOARD, 0x71 },
+  { "F23", HID_PAGE_KEYBOARD, 0x72 },
+  { "F24", HID_PAGE_KEYBOARD, 0x73 },
+  { "NUM_LOCK", HID_PAGE_KEYBOARD, 0x53 },
+  { "KEYPAD_DIVIDE", HID_PAGE_KEYBOARD, 0x54 },
+  { "KEYPAD_MULTIPLY", HID_PAGE_KEYBOARD, 0x55 },
+  { "KEYPAD_SUBTRACT", HID_PAGE_KEYBOARD, 0x56 },
+  { "KEYPAD_ADD", HID_PAGE_KEYBOARD, 0x57 },
+  { "KEYPAD_ENTER", HID_PAGE_KEYBOARD, 0x58 },
+  { "KEYPAD_1", HID_PAGE_KEYBOARD, 0x59 },
+  { "KEYPAD_2", HID_PAGE_KEYBOARD, 0x5A },
+  { "KEYPAD_3", HID_PAGE_KEYBOARD, 0x5B },
+  { "KEYPAD_4", HID_PAGE_KEYBOARD, 0x5C },
+  { "KEYPAD_5", HID_PAGE_KEYBOARD, 0x5D },
+  { "KEYPAD_6", HID_PAGE_KEYBOARD, 0x5E },
+  { "KEYPAD_7", HID_PAGE_KEYBOARD, 0x5F },
+  { "KEYPAD_8", HID_PAGE_KEYBOARD, 0x60 },
+  { "KEYPAD_9", HID_PAGE_KEYBOARD, 0x61 },
+  { "KEYPAD_0", HID_PAGE_KEYBOARD, 0x62 },
+  { "KEYPAD_DECIMAL", HID_PAGE_KEYBOARD, 0x63 },
+  { "KEYPAD_EQUAL", HID_PAGE_KEYBOARD, 0x67 },
+  { "KEYPAD_COMMA", HID_PAGE_KEYBOARD, 0x85 },
+  { "CTRL", HID_PAGE_KEYBOARD, 0xE0 },
+  { "SHIFT", HID_PAGE_KEYBOARD, 0xE1 },
+  { "ALT", HID_PAGE_KEYBOARD, 0xE2 },
+  { "GUI", HID_PAGE_KEYBOARD, 0xE3 },
+  { "LCTRL", HID_PAGE_KEYBOARD, 0xE0 },
+  { "LSHIFT", HID_PAGE_KEYBOARD, 0xE1 },
+  { "LALT", HID_PAGE_KEYBOARD, 0xE2 },
+  { "LGUI", HID_PAGE_KEYBOARD, 0xE3 },
+  { "RCTRL", HID_PAGE_KEYBOARD, 0xE4 },
+  { "RSHIFT", HID_PAGE_KEYBOARD, 0xE5 },
+  { "RALT", HID_PAGE_KEYBOARD, 0xE6 },
+  { "RGUI", HID_PAGE_KEYBOARD, 0xE7 },
+  { "MUTE", HID_PAGE_CONSUMER, 0xE2 },
+  { "VOLUME_UP", HID_PAGE_CONSUMER, 0xE9 },
+  { "VOLUME_DOWN", HID_PAGE_CONSUMER, 0xEA },
+  { "MOUSE_LEFT", HID_PAGE_MOUSE, 1 },
+  { "MOUSE_RIGHT", HID_PAGE_MOUSE, 2 },
+  { "MOUSE_MIDDLE", HID_PAGE_MOUSE, 3 },
+  { "MOUSE_BACK", HID_PAGE_MOUSE, 4 },
+  { "MOUSE_FORWARD", HID_PAGE_MOUSE, 5 },
+  { "GAMEPAD_1", HID_PAGE_GAMEPAD, 1 },
+  { "GAMEPAD_2", HID_PAGE_GAMEPAD, 2 },
+  { "GAMEPAD_3", HID_PAGE_GAMEPAD, 3 },
+  { "GAMEPAD_4", HID_PAGE_GAMEPAD, 4 },
+  { "GAMEPAD_5", HID_PAGE_GAMEPAD, 5 },
+  { "GAMEPAD_6", HID_PAGE_GAMEPAD, 6 },
+  { "GAMEPAD_7", HID_PAGE_GAMEPAD, 7 },
+  { "GAMEPAD_8", HID_PAGE_GAMEPAD, 8 },
+  { "GAMEPAD_9", HID_PAGE_GAMEPAD, 9 },
+  { "GAMEPAD_10", HID_PAGE_GAMEPAD, 10 },
+  { "GAMEPAD_11", HID_PAGE_GAMEPAD, 11 },
+  { "GAMEPAD_12", HID_PAGE_GAMEPAD, 12 },
+  { "GAMEPAD_13", HID_PAGE_GAMEPAD, 13 },
+  { "GAMEPAD_14", HID_PAGE_GAMEPAD, 14 },
+  { "GAMEPAD_15", HID_PAGE_GAMEPAD, 15 },
+  { "GAMEPAD_16", HID_PAGE_GAMEPAD, 16 },
+};
+
+static void test_keycodes(void)
+{
+  for (KnownUsage const &k : knownUsages)
+  {
+    HidUsage usage;
+    char text[96];
+    if (!hid_usage_lookup(k.name, strlen(k.name), &usage))
+    {
+      fail("'%s' does not resolve", k.name);
+    }
+    else if (usage.page != k.page || usage.code != k.code)
+    {
+      snprintf(text, sizeof(text), "%s is page %u usage 0x%02X, not page %u usage 0x%02X", k.name, usage.page,
+               usage.code, k.page, k.code);
+      fail("%s", text);
+    }
+  }
+
+  size_t const count = hid_usage_count();
+  if (count == 0)
+    fail("%s", "no key names");
+
+  for (size_t i = 0; i < count; i++)
+  {
+    char const *name = hid_usage_name(i);
+    size_t const len = strlen(name);
+    if (i && strcmp(hid_usage_name(i - 1), name) >= 0)
+      fail("'%s' out of order", name);
+
+    // Every name, also when it is followed by more text
+    HidUsage usage;
+    char buffer[64];
+    snprintf(buffer, sizeof(buffer), "%s+x", name);
+    if (!hid_usage_lookup(name, len, &usage) || !hid_usage_lookup(buffer, len, &usage))
+      fail("'%s' does not resolve", name);
+    else if (usage.page == HID_PAGE_NONE)
+      fail("'%s' has no usage page", name);
+
+    // Near misses: one character short or too many, a wrong last
+    // character, the other case of the first
+    check_variant(name, len - 1);
+    snprintf(buffer, sizeof(buffer), "%s_", name);
+    check_variant(buffer, len + 1);
+    snprintf(buffer, sizeof(buffer), "%s", name);
+    buffer[len - 1] = '~';
+    check_variant(buffer, len);
+    snprintf(buffer, sizeof(buffer), "%s", name);
+    buffer[0] ^= 0x20;
+    check_variant(buffer, len);
+  }
+
+  static char const *const misses[] = { "", " ", "ENTE", "ENTERR", "enter", "CTRL+", "F25", "0x04" };
+  for (char const *miss : misses)
+    check_variant(miss, strlen(miss));
+}
+
+//--------------------------------------------------------------------+
+// Typing text
+//--------------------------------------------------------------------+
+#define SHIFT_USAGE 0xE1
+
+// Reference: the host's view of a report stream. Keys new in a report are
+// typed in usage order with the shift state of that report.
+static bool decode_reports(char const *text, char *decoded, size_t size)
+{
+  // Character of each key, unshifted and shifted
+  char chars[256][2] = {};
+  for (int c = 1; c < 128; c++)
+  {
+    uint8_t keycode;
+    bool shift;
+    if (hid_ascii_lookup((char)c, &keycode, &shift))
+      chars[keycode][shift] = (char)c;
+  }
+
+  TypeEncoder e;
+  type_encoder_init(&e, text, (uint16_t)strlen(text));
+  KeyboardState previous;
+  KeyboardState report;
+  size_t len = 0;
+  int reports = 0;
+  while (type_encoder_next(&e, &report))
+  {
+    if (++reports > 4 * (int)strlen(text) + 2)
+    {
+      fail("'%s' never ends", text);
+      return false;
+    }
+
+    bool const shift = keyboard_state_has(&report, SHIFT_USAGE);
+    for (int usage = 0; usage < 0xE0; usage++)
+    {
+      if (!keyboard_state_has(&report, (uint8_t)usage) || keyboard_state_has(&previous, (uint8_t)usage))
+        continue;
+      char const c = chars[usage][shift];
+      if (!c || len + 1 >= size)
+      {
+        fail("'%s' presses a key that types nothing", text);
+        return false;
+      }
+      decoded[len++] = c;
+    }
+    previous = report;
+  }
+  decoded[len] = 0;
+
+  if (!keyboard_state_empty(&previous))
+    fail("'%s' leaves keys pressed", text);
+  return true;
+}
+
+static void test_type(void)
+{
+  static char const *const texts[] = {
+    "a",
+    "aaaa",                        // repeated characters
+    "aabbccddeeff",
+    "AaAaBBbb",                    // shift changes
+    "Hello, World!\n",
+    "a!b@c#d$e%f^",
+    "zyxwvutsrqponm",              // non-ascending runs
+    "abcdefghijklmnopqrstuvwxyz",  // more than 6 keys ascending
+    "PACK MY BOX with 5 dozen liquor jugs\t\"quoted\"\\",
+    "1234567890-=[]\\;',./`",
+    "!@#$%^&*()_+{}|:\"<>?~",
+  };
+
+  for (char const *text : texts)
+  {
+    char decoded[256];
+    if (decode_reports(text, decoded, sizeof(decoded)) && strcmp(decoded, text) != 0)
+    {
+      fail("'%s' typed as:", text);
+      printf("      '%s'\r\n", decoded);
+    }
+  }
+
+  // Characters without a key are skipped
+  char decoded[64];
+  if (decode_reports("a\x01" "b\x7f", decoded, sizeof(decoded)) && strcmp(decoded, "ab") != 0)
+    fail("'%s' typed for a<01>b<7f>", decoded);
+}
+
+//--------------------------------------------------------------------+
+// Keymap images
+//--------------------------------------------------------------------+
+static KeymapImage image;
+
+static bool parse_keymap(char const *text)
+{
+  static uint8_t const pins[] = KEYMAP_DEFAULT_PINS;
+  ConfigParser parser;
+  config_parser_init(&parser, &image, pins, sizeof(pins));
+  config_parser_feed(&parser, text, strlen(text));
+  return config_parser_finish(&parser);
+}
+
+// A change with a correct CRC, as a host writing keymap.bin could make it
+static void check_rejected(char const *what, void (*change)(KeymapMatrix *m))
+{
+  static KeymapImage changed;
+  changed = image;
+  change(&changed.matrix);
+  keymap_update_crc(&changed);
+  if (keymap_valid(&changed, keymap_size(&changed)))
+    fail("image with %s accepted", what);
+}
+
+static void test_keymap(void)
+{
+  if (!parse_keymap("rows=0,1,2,3 cols=4,5,6,7 scanner=pio scan=50 a b c d:pin=20 e:row=3:col=3"))
+  {
+    fail("%s", "test keymap does not parse");
+    return;
+  }
+  if (!keymap_valid(&image, keymap_size(&image)))
+    fail("%s", "parsed image rejected");
+
+  check_rejected("17 rows", [](KeymapMatrix *m) { m->rows = KEYMAP_MATRIX_MAX_LINES + 1; });
+  check_rejected("255 cols", [](KeymapMatrix *m) { m->cols = 255; });
+  check_rejected("16x16 positions", [](KeymapMatrix *m) { m->rows = m->cols = KEYMAP_MATRIX_MAX_LINES; });
+  check_rejected("an unknown diode", [](KeymapMatrix *m) { m->diode = KEYMAP_DIODE_NONE + 1; });
+  check_rejected("an unknown scanner", [](KeymapMatrix *m) { m->scanner = KEYMAP_SCANNER_PIO + 1; });
+  check_rejected("a row on GPIO 30", [](KeymapMatrix *m) { m->rowPins[3] = KEYMAP_GPIO_COUNT; });
+  check_rejected("a column on GPIO 255", [](KeymapMatrix *m) { m->colPins[0] = 255; });
+  check_rejected("a 10 us scan", [](KeymapMatrix *m) { m->scanUs = 10; });
+
+  // Pins past the used lines do not matter
+  static KeymapImage changed;
+  changed = image;
+  changed.matrix.rowPins[KEYMAP_MATRIX_MAX_LINES - 1] = 255;
+  keymap_update_crc(&changed);
+  if (!keymap_valid(&changed, keymap_size(&changed)))
+    fail("%s", "unused matrix line checked");
+}
+
+//--------------------------------------------------------------------+
+// Main
+//--------------------------------------------------------------------+
+struct TestCase
+{
+  char const *name;
+  void (*run)(void);
+};
+
+static TestCase const cases[] =
+{
+  { "keycodes", test_keycodes },
+  { "type", test_type },
+  { "keymap", test_keymap },
+};
+
+int main(int argc, char **argv)
+{
+  for (TestCase const &c : cases)
+  {
+    if (argc == 2 && strcmp(argv[1], c.name) == 0)
+    {
+      c.run();
+      if (failures)
+        return 1;
+      printf("%s: ok\r\n", c.name);
+      return 0;
+    }
+  }
+
+  printf("usage: %s <case>, one of:", argv[0]);
+  for (TestCase const &c : cases)
+    printf(" %s", c.name);
+  printf("\r\n");
+  return 2;
+}
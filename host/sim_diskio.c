@@ -0,0 +1,149 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "ff.h"
+#include "diskio.h"
+
+#include "sd_card.h"
+#include "sim_hal.h"
+
+// FatFs disk layer on a disk image file, drive 0 only
+
+#define SIM_SECTOR_SIZE 512
+
+static int imageFd = -1;
+static LBA_t sectorCount = 0;
+
+bool sim_disk_open(char const *path, uint32_t sizeBytes)
+{
+  sim_disk_close();
+
+  imageFd = open(path, O_RDWR | O_CREAT, 0644);
+  if (imageFd < 0)
+  {
+    printf("ERROR: Could not open disk image %s\r\n", path);
+    return false;
+  }
+
+  struct stat st;
+  if (fstat(imageFd, &st) != 0)
+  {
+    sim_disk_close();
+    return false;
+  }
+
+  bool const created = st.st_size == 0;
+  if (created)
+  {
+    if (ftruncate(imageFd, sizeBytes) != 0)
+    {
+      sim_disk_close();
+      return false;
+    }
+    st.st_size = sizeBytes;
+  }
+  sectorCount = (LBA_t)(st.st_size / SIM_SECTOR_SIZE);
+
+  if (created)
+  {
+#if FF_USE_MKFS
+    static BYTE work[FF_MAX_SS * 4];
+    FRESULT const fr = f_mkfs("0:", 0, work, sizeof(work));
+    if (fr != FR_OK)
+    {
+      printf("ERROR: Could not format disk image %s (%d)\r\n", path, fr);
+      sim_disk_close();
+      return false;
+    }
+#else
+    printf("ERROR: %s is empty and FatFs is built without f_mkfs, use a formatted image\r\n", path);
+    sim_disk_close();
+    return false;
+#endif
+  }
+  return true;
+}
+
+void sim_disk_close(void)
+{
+  if (imageFd >= 0)
+    close(imageFd);
+  imageFd = -1;
+  sectorCount = 0;
+}
+
+bool sd_init_driver(void)
+{
+  return imageFd >= 0;
+}
+
+DSTATUS disk_status(BYTE pdrv)
+{
+  return pdrv == 0 && imageFd >= 0 ? 0 : STA_NOINIT;
+}
+
+DSTATUS disk_initialize(BYTE pdrv)
+{
+  return disk_status(pdrv);
+}
+
+DRESULT disk_read(BYTE pdrv, BYTE *buff, LBA_t sector, UINT count)
+{
+  if (disk_status(pdrv))
+    return RES_NOTRDY;
+  if (sector + count > sectorCount)
+    return RES_PARERR;
+
+  size_t const len = (size_t)count * SIM_SECTOR_SIZE;
+  if (pread(imageFd, buff, len, (off_t)sector * SIM_SECTOR_SIZE) != (ssize_t)len)
+    return RES_ERROR;
+  return RES_OK;
+}
+
+DRESULT disk_write(BYTE pdrv, BYTE const *buff, LBA_t sector, UINT count)
+{
+  if (disk_status(pdrv))
+    return RES_NOTRDY;
+  if (sector + count > sectorCount)
+    return RES_PARERR;
+
+  size_t const len = (size_t)count * SIM_SECTOR_SIZE;
+  if (pwrite(imageFd, buff, len, (off_t)sector * SIM_SECTOR_SIZE) != (ssize_t)len)
+    return RES_ERROR;
+  return RES_OK;
+}
+
+DRESULT disk_ioctl(BYTE pdrv, BYTE cmd, void *buff)
+{
+  if (disk_status(pdrv))
+    return RES_NOTRDY;
+
+  switch (cmd)
+  {
+  case CTRL_SYNC:
+    return fsync(imageFd) == 0 ? RES_OK : RES_ERROR;
+  case GET_SECTOR_COUNT:
+    *(LBA_t *)buff = sectorCount;
+    return RES_OK;
+  case GET_SECTOR_SIZE:
+    *(WORD *)buff = SIM_SECTOR_SIZE;
+    return RES_OK;
+  case GET_BLOCK_SIZE:
+    *(DWORD *)buff = 1;
+    return RES_OK;
+  default:
+    return RES_PARERR;
+  }
+}
+
+DWORD get_fattime(void)
+{
+  time_t const now = time(NULL);
+  struct tm t;
+  localtime_r(&now, &t);
+  return (DWORD)(t.tm_year - 80) << 25 | (DWORD)(t.tm_mon + 1) << 21 | (DWORD)t.tm_mday << 16 |
+         (DWORD)t.tm_hour << 11 | (DWORD)t.tm_min << 5 | (DWORD)(t.tm_sec / 2);
+}
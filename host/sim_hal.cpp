@@ -0,0 +1,697 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "bsp/board.h"
+#include "tusb.h"
+
+#include "sim_hal.h"
+#include "usb_descriptors.h"
+#include "keyboard_report.h"
+#include "keymap.h"
+#include "pio_scan.h"
+#include "core1.h"
+
+// Owned by core 1 on the target, see core1.h
+KeymapImage keymap;
+
+// There is no core 1 to write key patches to the card
+bool core1_save_patches(KeymapPatch const *patches, uint8_t count)
+{
+  (void)patches;
+  (void)count;
+  return false;
+}
+
+//--------------------------------------------------------------------+
+// Time
+//--------------------------------------------------------------------+
+#define SIM_ALARMS 8
+#define SIM_FRAME_US 1000
+
+struct SimAlarm
+{
+  bool used;
+  uint64_t atUs;
+  alarm_callback_t callback;
+  void *userData;
+};
+
+static uint64_t nowUs = 0;
+static SimAlarm alarms[SIM_ALARMS];
+static int firingAlarm = -1;
+static bool firingCancelled = false;
+
+static void usb_frame(void);
+
+uint32_t time_us_32(void)
+{
+  return (uint32_t)nowUs;
+}
+
+uint64_t time_us_64(void)
+{
+  return nowUs;
+}
+
+uint32_t board_millis(void)
+{
+  return (uint32_t)(nowUs / 1000);
+}
+
+void board_led_write(bool state)
+{
+  (void)state;
+}
+
+alarm_id_t add_alarm_in_us(uint64_t us, alarm_callback_t callback, void *user_data, bool fire_if_past)
+{
+  (void)fire_if_past;
+  for (int i = 0; i < SIM_ALARMS; i++)
+  {
+    if (alarms[i].used)
+      continue;
+    alarms[i].used = true;
+    alarms[i].atUs = nowUs + us;
+    alarms[i].callback = callback;
+    alarms[i].userData = user_data;
+    return i + 1;
+  }
+  return -1;
+}
+
+bool cancel_alarm(alarm_id_t alarm_id)
+{
+  int const i = alarm_id - 1;
+  if (i < 0 || i >= SIM_ALARMS)
+    return false;
+  if (i == firingAlarm)
+    firingCancelled = true;
+  bool const was = alarms[i].used;
+  alarms[i].used = false;
+  return was;
+}
+
+static int64_t repeating_timer_alarm_cb(alarm_id_t id, void *user_data)
+{
+  (void)id;
+  repeating_timer_t *rt = (repeating_timer_t *)user_data;
+  if (!rt->callback(rt))
+    return 0;
+  // Negative delays count from the previous firing, like the SDK
+  return rt->delay_us;
+}
+
+bool add_repeating_timer_us(int64_t delay_us, repeating_timer_callback_t callback, void *user_data,
+                            repeating_timer_t *out)
+{
+  if (delay_us == 0)
+    delay_us = 1;
+  out->delay_us = delay_us;
+  out->callback = callback;
+  out->user_data = user_data;
+  out->alarm_id = add_alarm_in_us(delay_us < 0 ? -delay_us : delay_us, repeating_timer_alarm_cb, out, true);
+  return out->alarm_id > 0;
+}
+
+bool cancel_repeating_timer(repeating_timer_t *timer)
+{
+  bool const was = timer->alarm_id > 0 && cancel_alarm(timer->alarm_id);
+  timer->alarm_id = 0;
+  return was;
+}
+
+void panic(char const *fmt, ...)
+{
+  va_list args;
+  va_start(args, fmt);
+  vfprintf(stderr, fmt, args);
+  va_end(args);
+  abort();
+}
+
+void sim_advance_us(uint32_t us)
+{
+  uint64_t const endUs = nowUs + us;
+
+  for (;;)
+  {
+    // Earliest of the next frame start and the alarms due in this step
+    uint64_t nextUs = (nowUs / SIM_FRAME_US + 1) * SIM_FRAME_US;
+    int alarm = -1;
+    for (int i = 0; i < SIM_ALARMS; i++)
+    {
+      if (alarms[i].used && alarms[i].atUs < nextUs)
+      {
+        nextUs = alarms[i].atUs > nowUs ? alarms[i].atUs : nowUs;
+        alarm = i;
+      }
+    }
+    if (nextUs > endUs)
+      break;
+
+    nowUs = nextUs;
+    if (alarm < 0)
+    {
+      usb_frame();
+      continue;
+    }
+
+    // Rescheduled in the same slot, so the id stays valid
+    SimAlarm const a = alarms[alarm];
+    alarms[alarm].used = false;
+    firingAlarm = alarm;
+    firingCancelled = false;
+    int64_t const again = a.callback(alarm + 1, a.userData);
+    firingAlarm = -1;
+    if (again && !firingCancelled && !alarms[alarm].used)
+    {
+      alarms[alarm] = a;
+      alarms[alarm].atUs = again < 0 ? a.atUs - again : nowUs + again;
+    }
+  }
+  nowUs = endUs;
+}
+
+// Host time spent in the simulated hardware, counted once when nested
+static uint64_t hardwareNs = 0;
+static int hardwareDepth = 0;
+
+static uint64_t host_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+struct HardwareTime
+{
+  uint64_t startNs;
+
+  HardwareTime()
+  {
+    if (!hardwareDepth++)
+      startNs = host_ns();
+  }
+
+  ~HardwareTime()
+  {
+    if (!--hardwareDepth)
+      hardwareNs += host_ns() - startNs;
+  }
+};
+
+uint64_t sim_hardware_ns(void)
+{
+  return hardwareNs;
+}
+
+//--------------------------------------------------------------------+
+// GPIO
+//--------------------------------------------------------------------+
+#define SIM_SWITCHES 256
+
+struct SimSwitch
+{
+  uint8_t anode;
+  uint8_t cathode;
+  bool diode;
+};
+
+static bool gpioLevel[NUM_BANK0_GPIOS];
+static uint32_t gpioIrqMask[NUM_BANK0_GPIOS];
+static gpio_irq_callback_t gpioCallback = NULL;
+static uint32_t gpioOutMask = 0;
+static uint32_t gpioOutLow = 0;  // outputs set to 0
+static uint32_t gpioPullUp = 0;
+
+static SimSwitch switches[SIM_SWITCHES];
+static int switchCount = 0;
+
+// Pins a chain of closed switches pulls low from the outputs driving low
+static uint32_t pulled_low(void)
+{
+  uint32_t low = gpioOutMask & gpioOutLow;
+  if (!low || !switchCount)
+    return low;
+
+  for (bool grew = true; grew;)
+  {
+    grew = false;
+    for (int i = 0; i < switchCount; i++)
+    {
+      SimSwitch const &sw = switches[i];
+      uint32_t const a = 1u << sw.anode;
+      uint32_t const k = 1u << sw.cathode;
+      if ((low & k) && !(low & a))
+      {
+        low |= a;
+        grew = true;
+      }
+      if (!sw.diode && (low & a) && !(low & k))
+      {
+        low |= k;
+        grew = true;
+      }
+    }
+  }
+  return low;
+}
+
+void gpio_init(uint gpio)
+{
+  (void)gpio;
+}
+
+void gpio_set_dir(uint gpio, bool out)
+{
+  if (gpio >= NUM_BANK0_GPIOS)
+    return;
+  if (out)
+    gpioOutMask |= 1u << gpio;
+  else
+    gpioOutMask &= ~(1u << gpio);
+}
+
+uint32_t gpio_get_all(void)
+{
+  HardwareTime const hardware;
+  uint32_t levels = 0;
+  for (int i = 0; i < NUM_BANK0_GPIOS; i++)
+  {
+    if (gpioLevel[i] || (gpioPullUp & (1u << i)))
+      levels |= 1u << i;
+  }
+  uint32_t const out = gpioOutMask & ~gpioOutLow;
+  return ((levels & ~gpioOutMask) | out) & ~pulled_low();
+}
+
+bool gpio_get(uint gpio)
+{
+  return gpio < NUM_BANK0_GPIOS && (gpio_get_all() & (1u << gpio));
+}
+
+void gpio_put(uint gpio, bool value)
+{
+  if (gpio >= NUM_BANK0_GPIOS)
+    return;
+  if (value)
+    gpioOutLow &= ~(1u << gpio);
+  else
+    gpioOutLow |= 1u << gpio;
+}
+
+void gpio_pull_up(uint gpio)
+{
+  if (gpio < NUM_BANK0_GPIOS)
+    gpioPullUp |= 1u << gpio;
+}
+
+void gpio_disable_pulls(uint gpio)
+{
+  if (gpio < NUM_BANK0_GPIOS)
+    gpioPullUp &= ~(1u << gpio);
+}
+
+void sim_switch_set(unsigned anode, unsigned cathode, bool closed, bool diode)
+{
+  if (anode >= NUM_BANK0_GPIOS || cathode >= NUM_BANK0_GPIOS)
+    return;
+
+  for (int i = 0; i < switchCount; i++)
+  {
+    if (switches[i].anode == anode && switches[i].cathode == cathode)
+    {
+      if (!closed)
+        switches[i] = switches[--switchCount];
+      return;
+    }
+  }
+  if (closed && switchCount < SIM_SWITCHES)
+    switches[switchCount++] = { (uint8_t)anode, (uint8_t)cathode, diode };
+}
+
+void sim_matrix_key(KeymapMatrix const *m, uint8_t row, uint8_t col, bool pressed)
+{
+  if (row >= m->rows || col >= m->cols)
+    return;
+
+  // The read side is the anode: it is pulled low through the diode by the
+  // driven line
+  uint8_t const rowPin = m->rowPins[row];
+  uint8_t const colPin = m->colPins[col];
+  if (m->diode == KEYMAP_DIODE_ROW2COL)
+    sim_switch_set(rowPin, colPin, pressed, true);
+  else
+    sim_switch_set(colPin, rowPin, pressed, m->diode != KEYMAP_DIODE_NONE);
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled)
+{
+  if (gpio >= NUM_BANK0_GPIOS)
+    return;
+  if (enabled)
+    gpioIrqMask[gpio] |= event_mask;
+  else
+    gpioIrqMask[gpio] &= ~event_mask;
+}
+
+void gpio_set_irq_enabled_with_callback(uint gpio, uint32_t event_mask, bool enabled, gpio_irq_callback_t callback)
+{
+  gpioCallback = callback;
+  gpio_set_irq_enabled(gpio, event_mask, enabled);
+}
+
+void sim_gpio_set(unsigned pin, bool level)
+{
+  if (pin < NUM_BANK0_GPIOS && gpioLevel[pin] != level)
+    sim_gpio_edge(pin, level);
+}
+
+void sim_gpio_edge(unsigned pin, bool level)
+{
+  if (pin >= NUM_BANK0_GPIOS)
+    return;
+
+  gpioLevel[pin] = level;
+  uint32_t const edge = level ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL;
+  if ((gpioIrqMask[pin] & edge) && gpioCallback)
+    gpioCallback(pin, edge);
+}
+
+//--------------------------------------------------------------------+
+// PIO scanner
+//--------------------------------------------------------------------+
+// The state machine and its DMA as one timer: every period the drive lines
+// are pulled low in turn and the pins sampled into the ring, all at once.
+// Costs host time, but none of the firmware's.
+static uint32_t pioRing[PIO_SCAN_RING_WORDS];
+static uint32_t pioMasks[PIO_SCAN_MAX_LINES];
+static uint8_t pioLines;
+static uint32_t pioHead;
+static bool pioRunning = false;
+static repeating_timer_t pioTimer;
+
+static bool pio_scan_timer_cb(repeating_timer_t *rt)
+{
+  (void)rt;
+  HardwareTime const hardware;
+  uint32_t const outMask = gpioOutMask;
+  uint32_t const outLow = gpioOutLow;
+  for (int i = 0; i < (pioLines ? pioLines : 1); i++)
+  {
+    gpioOutMask = outMask | pioMasks[i];
+    gpioOutLow = outLow | pioMasks[i];
+    pioRing[pioHead++ % PIO_SCAN_RING_WORDS] = gpio_get_all();
+  }
+  gpioOutMask = outMask;
+  gpioOutLow = outLow;
+  return true;
+}
+
+bool pio_scan_start(uint8_t const *drivePins, uint8_t lines, uint32_t periodUs)
+{
+  pio_scan_stop();
+  if (lines > PIO_SCAN_MAX_LINES || periodUs < PIO_SCAN_MIN_US(lines ? lines : 1))
+    return false;
+
+  uint8_t base = NUM_BANK0_GPIOS;
+  uint8_t top = 0;
+  memset(pioMasks, 0, sizeof(pioMasks));
+  for (int i = 0; i < lines; i++)
+  {
+    pioMasks[i] = 1u << drivePins[i];
+    if (drivePins[i] < base)
+      base = drivePins[i];
+    if (drivePins[i] > top)
+      top = drivePins[i];
+  }
+  if (lines && top - base >= 32)
+    return false;
+
+  pioLines = lines;
+  pioHead = 0;
+  pioRunning = add_repeating_timer_us(-(int64_t)periodUs, pio_scan_timer_cb, NULL, &pioTimer);
+  return pioRunning;
+}
+
+void pio_scan_stop(void)
+{
+  if (pioRunning)
+    cancel_repeating_timer(&pioTimer);
+  pioRunning = false;
+}
+
+uint32_t pio_scan_head(void)
+{
+  return pioHead;
+}
+
+uint32_t const volatile *pio_scan_ring(void)
+{
+  return pioRing;
+}
+
+//--------------------------------------------------------------------+
+// USB
+//--------------------------------------------------------------------+
+static bool usbMounted = true;
+static bool usbSuspended = false;
+static bool sofEnabled = false;
+static uint8_t hidProtocol = HID_PROTOCOL_REPORT;
+static uint8_t pollMs = PLICK_POLL_MS;
+
+static bool endpointBusy = false;
+static uint8_t endpointReport[1 + KEYBOARD_REPORT_MAX_LEN];  // report ID first, if any
+static uint16_t endpointLen = 0;
+static SimUsbStats usbStats;
+static sim_report_cb_t reportCallback = NULL;
+
+static_assert(sizeof(usbStats.last) >= sizeof(endpointReport), "SimUsbStats.last too small");
+
+bool tud_mounted(void)
+{
+  return usbMounted;
+}
+
+bool tud_suspended(void)
+{
+  return usbSuspended;
+}
+
+bool tud_remote_wakeup(void)
+{
+  if (!usbSuspended)
+    return false;
+  usbSuspended = false;
+  return true;
+}
+
+bool tud_connect(void)
+{
+  usbMounted = true;
+  return true;
+}
+
+bool tud_disconnect(void)
+{
+  usbMounted = false;
+  endpointBusy = false;
+  return true;
+}
+
+void tud_sof_cb_enable(bool en)
+{
+  sofEnabled = en;
+}
+
+bool tud_hid_ready(void)
+{
+  return usbMounted && !usbSuspended && !endpointBusy;
+}
+
+// Like TinyUSB the report ID goes on the bus in front of the report
+bool tud_hid_report(uint8_t report_id, void const *report, uint16_t len)
+{
+  uint16_t const idLen = report_id ? 1 : 0;
+  if (!tud_hid_ready() || idLen + len > sizeof(endpointReport))
+    return false;
+
+  endpointReport[0] = report_id;
+  memcpy(&endpointReport[idLen], report, len);
+  endpointLen = idLen + len;
+  endpointBusy = true;
+  usbStats.reports++;
+  return true;
+}
+
+uint8_t tud_hid_get_protocol(void)
+{
+  return hidProtocol;
+}
+
+bool usb_poll_interval_valid(uint8_t ms)
+{
+  return ms == 1 || ms == 2 || ms == 4 || ms == 8 || ms == 10;
+}
+
+void usb_set_poll_interval(uint8_t ms)
+{
+  if (usb_poll_interval_valid(ms))
+    pollMs = ms;
+}
+
+uint8_t usb_poll_interval(void)
+{
+  return pollMs;
+}
+
+void sim_usb_set_report_cb(sim_report_cb_t cb)
+{
+  reportCallback = cb;
+}
+
+void sim_usb_set_mounted(bool mounted)
+{
+  usbMounted = mounted;
+  if (!mounted)
+    endpointBusy = false;
+}
+
+void sim_usb_set_suspended(bool suspended)
+{
+  usbSuspended = suspended;
+}
+
+void sim_usb_set_protocol(uint8_t protocol)
+{
+  hidProtocol = protocol;
+  tud_hid_set_protocol_cb(0, protocol);
+}
+
+bool sim_usb_complete(void)
+{
+  if (!endpointBusy)
+    return false;
+
+  endpointBusy = false;
+  memcpy(usbStats.last, endpointReport, endpointLen);
+  usbStats.lastLen = endpointLen;
+  usbStats.completed++;
+  if (reportCallback)
+    reportCallback(usbStats.last, usbStats.lastLen);
+  tud_hid_report_complete_cb(0, usbStats.last, usbStats.lastLen);
+  return true;
+}
+
+SimUsbStats const *sim_usb_stats(void)
+{
+  return &usbStats;
+}
+
+// The host polls the endpoint once every pollMs frames
+static void usb_frame(void)
+{
+  if (!usbMounted || usbSuspended)
+    return;
+
+  usbStats.frames++;
+  if (sofEnabled)
+    tud_sof_cb(usbStats.frames);
+  if (usbStats.frames % pollMs == 0)
+    sim_usb_complete();
+}
+
+//--------------------------------------------------------------------+
+// CDC
+//--------------------------------------------------------------------+
+#define SIM_CDC_FIFO 4096
+
+struct SimFifo
+{
+  uint8_t data[SIM_CDC_FIFO];
+  uint32_t len;
+};
+
+static SimFifo cdcRx;  // host to device
+static SimFifo cdcTx;  // device to host
+
+static uint32_t fifo_write(SimFifo *f, void const *data, uint32_t len)
+{
+  if (len > SIM_CDC_FIFO - f->len)
+    len = SIM_CDC_FIFO - f->len;
+  memcpy(f->data + f->len, data, len);
+  f->len += len;
+  return len;
+}
+
+static uint32_t fifo_read(SimFifo *f, void *data, uint32_t maxLen)
+{
+  uint32_t const len = maxLen < f->len ? maxLen : f->len;
+  memcpy(data, f->data, len);
+  memmove(f->data, f->data + len, f->len - len);
+  f->len -= len;
+  return len;
+}
+
+bool tud_cdc_n_connected(uint8_t itf)
+{
+  (void)itf;
+  return usbMounted;
+}
+
+uint32_t tud_cdc_n_available(uint8_t itf)
+{
+  (void)itf;
+  return cdcRx.len;
+}
+
+uint32_t tud_cdc_n_read(uint8_t itf, void *buffer, uint32_t bufsize)
+{
+  (void)itf;
+  return fifo_read(&cdcRx, buffer, bufsize);
+}
+
+uint32_t tud_cdc_n_write(uint8_t itf, void const *buffer, uint32_t bufsize)
+{
+  (void)itf;
+  return fifo_write(&cdcTx, buffer, bufsize);
+}
+
+uint32_t tud_cdc_n_write_available(uint8_t itf)
+{
+  (void)itf;
+  return SIM_CDC_FIFO - cdcTx.len;
+}
+
+uint32_t tud_cdc_n_write_flush(uint8_t itf)
+{
+  (void)itf;
+  return 0;
+}
+
+uint32_t sim_cdc_host_write(void const *data, uint32_t len)
+{
+  return fifo_write(&cdcRx, data, len);
+}
+
+uint32_t sim_cdc_host_read(void *data, uint32_t maxLen)
+{
+  return fifo_read(&cdcTx, data, maxLen);
+}
+
+//--------------------------------------------------------------------+
+// MSC, the bench plays the host by calling the callbacks directly
+//--------------------------------------------------------------------+
+bool tud_msc_set_sense(uint8_t lun, uint8_t sense_key, uint8_t add_sense_code, uint8_t add_sense_qualifier)
+{
+  (void)lun;
+  (void)sense_key;
+  (void)add_sense_code;
+  (void)add_sense_qualifier;
+  return true;
+}
@@ -0,0 +1,91 @@
+#ifndef SIM_HAL_H_
+#define SIM_HAL_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Host side of the stand-ins in host/include: a simulated clock, GPIO pins,
+// the PIO key scanner (pio_scan.h), the keyboard endpoint with its host, a
+// CDC port and an SD card backed by a disk image file. The firmware modules
+// run unchanged on top of it.
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+//--------------------------------------------------------------------+
+// Time
+//--------------------------------------------------------------------+
+// Moves the clock forward. Alarms, SOFs and endpoint polls that fall into
+// the step run at their own time, in order.
+void sim_advance_us(uint32_t us);
+
+// Host time spent simulating hardware: GPIO reads and the PIO scanner. The
+// rest of the time the firmware runs is the firmware's own.
+uint64_t sim_hardware_ns(void);
+
+//--------------------------------------------------------------------+
+// GPIO
+//--------------------------------------------------------------------+
+// Sets a pin level and runs the edge interrupt if it is enabled
+void sim_gpio_set(unsigned pin, bool level);
+
+// Runs the edge interrupt for level even if the pin already had it, like a
+// glitch that was over before the interrupt read the pin
+void sim_gpio_edge(unsigned pin, bool level);
+
+// Opens or closes a switch between two pins. An input pin that a chain of
+// closed switches connects to an output driving low reads low. With a
+// diode current only flows from anode to cathode, so only the anode side
+// is pulled low through the switch.
+void sim_switch_set(unsigned anode, unsigned cathode, bool closed, bool diode);
+
+//--------------------------------------------------------------------+
+// USB
+//--------------------------------------------------------------------+
+struct SimUsbStats
+{
+  uint32_t reports;     // handed to the endpoint
+  uint32_t completed;   // read by the host
+  uint32_t frames;
+  uint8_t last[32];     // last report read by the host, report ID first
+  uint16_t lastLen;
+};
+
+// Called with every report the host reads
+typedef void (*sim_report_cb_t)(uint8_t const *report, uint16_t len);
+
+void sim_usb_set_report_cb(sim_report_cb_t cb);
+void sim_usb_set_mounted(bool mounted);
+void sim_usb_set_suspended(bool suspended);
+void sim_usb_set_protocol(uint8_t protocol);
+
+// Host reads the report in flight now instead of on its next poll. Returns
+// false if the endpoint was idle.
+bool sim_usb_complete(void);
+
+struct SimUsbStats const *sim_usb_stats(void);
+
+// Host end of the CDC port
+uint32_t sim_cdc_host_write(void const *data, uint32_t len);
+uint32_t sim_cdc_host_read(void *data, uint32_t maxLen);
+
+//--------------------------------------------------------------------+
+// SD card
+//--------------------------------------------------------------------+
+// Uses the image at path as the card. A missing image is created with
+// sizeBytes and formatted.
+bool sim_disk_open(char const *path, uint32_t sizeBytes);
+void sim_disk_close(void);
+
+#ifdef __cplusplus
+}
+
+struct KeymapMatrix;
+
+// Presses the matrix key at row, col: closes its switch, with the diode
+// the matrix describes
+void sim_matrix_key(KeymapMatrix const *m, uint8_t row, uint8_t col, bool pressed);
+#endif
+
+#endif /* SIM_HAL_H_ */
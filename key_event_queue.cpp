@@ -0,0 +1,41 @@
+#include "key_event_queue.h"
+#include "spsc_queue.h"
+
+static SpscQueue<KeyEvent, KEY_EVENT_QUEUE_SIZE> events;
+
+// Same split as the queue for the overflow counter: the producer counts,
+// the consumer remembers how many it has already reported.
+static std::atomic<uint32_t> overflowCount{0};
+static uint32_t overflowReported = 0;
+
+bool key_event_push(KeyEvent const &event)
+{
+  if (events.push(event))
+    return true;
+
+  overflowCount.store(overflowCount.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+  return false;
+}
+
+bool key_event_pop(KeyEvent *event)
+{
+  return events.pop(event);
+}
+
+bool key_event_peek(KeyEvent *event)
+{
+  return events.peek(event);
+}
+
+bool key_event_available(void)
+{
+  return !events.empty();
+}
+
+uint32_t key_event_take_overflow(void)
+{
+  uint32_t const count = overflowCount.load(std::memory_order_acquire);
+  uint32_t const dropped = count - overflowReported;
+  overflowReported = count;
+  return dropped;
+}
@@ -0,0 +1,38 @@
+#ifndef KEY_EVENT_QUEUE_H_
+#define KEY_EVENT_QUEUE_H_
+
+#include <stdint.h>
+
+// Lock-free single producer / single consumer queue of key edges.
+// Producers are the GPIO interrupt and the matrix scan timer, which run at
+// the same priority and never interrupt each other. Consumer is the HID
+// path in the main loop.
+
+// Must be a power of two
+#define KEY_EVENT_QUEUE_SIZE 256
+
+// Event sources: GPIOs of direct keys, then the matrix positions (see
+// matrix.h) from KEY_EVENT_MATRIX on
+#define KEY_EVENT_MATRIX 32
+#define KEY_EVENT_SOURCES 256
+
+struct KeyEvent
+{
+  uint8_t pin;      // event source
+  uint8_t level;
+  uint32_t timeUs;
+};
+
+// Producer side, safe to call from interrupt context.
+// Returns false and counts an overflow when the queue is full.
+bool key_event_push(KeyEvent const &event);
+
+// Consumer side
+bool key_event_pop(KeyEvent *event);
+bool key_event_peek(KeyEvent *event);
+bool key_event_available(void);
+
+// Returns the number of events dropped since the last call
+uint32_t key_event_take_overflow(void);
+
+#endif /* KEY_EVENT_QUEUE_H_ */
@@ -0,0 +1,612 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+
+#include "tusb.h"
+#include "usb_descriptors.h"
+#include "keyboard.h"
+#include "key_event_queue.h"
+#include "debounce.h"
+#include "keyboard_report.h"
+#include "report_scheduler.h"
+#include "keymap.h"
+#include "action_engine.h"
+#include "profile.h"
+#include "macro.h"
+#include "latency.h"
+#include "matrix.h"
+#include "core1.h"
+
+struct Button
+{
+  uint8_t buttonPin;  // event source, see KEY_EVENT_MATRIX
+  uint8_t key;        // keymap entry
+  bool pressed = false;
+  Debouncer debounce;
+};
+
+static void button_irq_cb(uint gpio, uint32_t events);
+static void matrix_change_cb(uint8_t source, bool level, uint32_t timeUs);
+
+// Fixed key table, nothing on the key path touches the heap
+static Button buttonGroup[KEYMAP_MAX_KEYS];
+static uint8_t buttonCount = 0;
+static int8_t buttonIndexByPin[KEY_EVENT_SOURCES];
+static bool keyboardReportDirty = true;
+
+// What the keys do and the macros they play come from a copy of the
+// keymap, core 1 may load a new one at any time. See profile.h.
+static ActionEngine engine;
+static MacroPlayer macroPlayer;
+static volatile bool macroWake = false;
+
+// Set once per USB frame by the scan loop, see scan_task()
+static bool scanDue = false;
+static uint32_t nextScanUs = 0;
+
+// Edge capture, see keyboard_trace_start()
+static uint8_t traceBuffer[KEYBOARD_TRACE_BYTES];
+static GpioTrace trace;
+static volatile bool traceCapturing = false;
+
+// Pending re-enumeration after the polling interval changed
+static bool reconnectPending = false;
+static uint32_t reconnectAtUs = 0;
+
+//--------------------------------------------------------------------+
+// Scan loop
+//--------------------------------------------------------------------+
+// Edges are handled as they arrive, the scan loop only looks for debounce
+// timeouts and tapping terms that ran out without a new edge. It runs once per USB frame,
+// SCAN_LEAD_US before the next SOF, so a key that settled goes into the
+// endpoint just in time for the frame the host polls next. Without SOFs
+// (not mounted, suspended) it keeps running on the timer alone.
+#define SCAN_PERIOD_US 1000
+#define SCAN_LEAD_US 100
+
+void tud_sof_cb(uint32_t frame_count)
+{
+  (void)frame_count;
+  nextScanUs = time_us_32() + SCAN_PERIOD_US - SCAN_LEAD_US;
+}
+
+void scan_task(void)
+{
+  uint32_t const now = time_us_32();
+  if ((int32_t)(now - nextScanUs) < 0)
+    return;
+
+  nextScanUs += SCAN_PERIOD_US;
+  if ((int32_t)(now - nextScanUs) >= 0)
+    nextScanUs = now + SCAN_PERIOD_US;  // fell behind, skip the missed ticks
+  scanDue = true;
+}
+
+// The host reads the polling interval only while enumerating
+static void apply_poll_interval(uint8_t pollMs)
+{
+  if (pollMs == usb_poll_interval() || !usb_poll_interval_valid(pollMs))
+    return;
+
+  usb_set_poll_interval(pollMs);
+  if (tud_mounted())
+  {
+    tud_disconnect();
+    reconnectPending = true;
+    reconnectAtUs = time_us_32() + 100000;
+  }
+}
+
+void usb_reconnect_task(void)
+{
+  if (reconnectPending && (int32_t)(time_us_32() - reconnectAtUs) >= 0)
+  {
+    reconnectPending = false;
+    tud_connect();
+  }
+}
+
+//--------------------------------------------------------------------+
+// Key table
+//--------------------------------------------------------------------+
+void init_buttons(void)
+{
+  uint32_t const edges = GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL;
+
+  // Called again when the keymap is reloaded
+  for (int i = 0; i < buttonCount; i++)
+  {
+    if (buttonGroup[i].buttonPin < NUM_BANK0_GPIOS)
+      gpio_set_irq_enabled(buttonGroup[i].buttonPin, edges, false);
+  }
+  buttonCount = 0;
+  keyboardReportDirty = true;
+  memset(buttonIndexByPin, -1, sizeof(buttonIndexByPin));
+
+  ActionTable *table = profile_reset_table();
+  action_table_load(table, &keymap);
+  macro_reset(&macroPlayer, table->macros, table->macroLen);
+  action_init(&engine, table);
+
+  apply_poll_interval(keymap.header.pollMs ? keymap.header.pollMs : PLICK_POLL_MS);
+
+  uint32_t directPins = 0;
+  for (int i = 0; i < keymap.header.keyCount; i++)
+  {
+    KeymapEntry const &entry = keymap.keys[i];
+    KeymapMatrix const &m = keymap.matrix;
+    uint8_t source;
+    if (entry.pin < NUM_BANK0_GPIOS)
+      source = entry.pin;
+    else if (entry.pin == KEYMAP_PIN_MATRIX && entry.row < m.rows && entry.col < m.cols)
+      source = KEY_EVENT_MATRIX + entry.row * m.cols + entry.col;
+    else
+      continue;
+
+    Button &b = buttonGroup[buttonCount];
+    b = Button();
+    b.buttonPin = source;
+    b.key = i;
+    b.debounce.algorithm = entry.debounceAlgorithm;
+    b.debounce.timeUs = entry.debounceUs;
+
+    buttonIndexByPin[b.buttonPin] = buttonCount++;
+    if (source < NUM_BANK0_GPIOS)
+    {
+      gpio_init(source);
+      gpio_set_dir(source, GPIO_IN);
+      directPins |= 1u << source;
+    }
+  }
+
+  // Matrix keys get their edges from the scanner, and so do the direct
+  // pins when the PIO samples them
+  matrix_init(&keymap.matrix, directPins, matrix_change_cb);
+  uint32_t const sampledPins = matrix_sampled_pins();
+
+  // Other edges are captured by interrupt, so a press is timestamped when
+  // it happens instead of on the next poll of the main loop.
+  bool callbackSet = false;
+  for (int i = 0; i < buttonCount; i++)
+  {
+    uint8_t const pin = buttonGroup[i].buttonPin;
+    if (pin >= NUM_BANK0_GPIOS || (sampledPins & (1u << pin)))
+      continue;
+    if (!callbackSet)
+      gpio_set_irq_enabled_with_callback(pin, edges, true, &button_irq_cb);
+    else
+      gpio_set_irq_enabled(pin, edges, true);
+    callbackSet = true;
+  }
+}
+
+KeymapAction const *keyboard_action(uint8_t key, uint8_t layer)
+{
+  ActionTable const *t = engine.table;
+  if (key >= t->keyCount || layer >= t->layerCount)
+    return NULL;
+  return &t->actions[layer * t->keyCount + key];
+}
+
+bool keyboard_patch(KeymapPatch const *patches, uint8_t count)
+{
+  ActionTable *t = profile_active_table();
+  for (uint8_t i = 0; i < count; i++)
+  {
+    if (patches[i].key >= t->keyCount || patches[i].layer >= t->layerCount)
+      return false;
+  }
+
+  for (uint8_t i = 0; i < count; i++)
+    t->actions[patches[i].layer * t->keyCount + patches[i].key] = patches[i].action;
+  action_refresh(&engine);
+  return true;
+}
+
+// Both producers of key events, they run at the same interrupt priority
+static void push_key_event(KeyEvent const &ev)
+{
+  if (traceCapturing)
+    gpio_trace_append(&trace, ev.pin, ev.level, ev.timeUs);
+  key_event_push(ev);
+}
+
+static void button_irq_cb(uint gpio, uint32_t events)
+{
+  KeyEvent ev;
+  ev.pin = gpio;
+  ev.timeUs = time_us_32();
+
+  // Both edges may be latched when the contact bounces faster than the
+  // interrupt is serviced, the pin itself is the only reliable level then.
+  if (events == GPIO_IRQ_EDGE_RISE)
+    ev.level = 1;
+  else if (events == GPIO_IRQ_EDGE_FALL)
+    ev.level = 0;
+  else
+    ev.level = gpio_get(gpio);
+
+  push_key_event(ev);
+}
+
+static void matrix_change_cb(uint8_t source, bool level, uint32_t timeUs)
+{
+  KeyEvent ev;
+  ev.pin = source;
+  ev.level = level;
+  ev.timeUs = timeUs;
+  push_key_event(ev);
+}
+
+static bool key_level(Button const &b)
+{
+  if (b.buttonPin >= KEY_EVENT_MATRIX)
+    return matrix_pressed(b.buttonPin - KEY_EVENT_MATRIX);
+  return gpio_get(b.buttonPin);
+}
+
+// The interrupts only append while traceCapturing is set and the main loop
+// cannot interrupt them, so clearing the flag is enough to own the trace
+void keyboard_trace_start(void)
+{
+  traceCapturing = false;
+  gpio_trace_init(&trace, traceBuffer, sizeof(traceBuffer), time_us_32());
+  traceCapturing = true;
+}
+
+void keyboard_trace_stop(void)
+{
+  traceCapturing = false;
+}
+
+GpioTrace const *keyboard_trace(void)
+{
+  return &trace;
+}
+
+//--------------------------------------------------------------------+
+// USB HID
+//--------------------------------------------------------------------+
+// Every held key goes into one report, so chords from several buttons are
+// sent together instead of overwriting each other. Nothing is sent when the
+// report equals the last one the host got. The keyboard goes before the
+// other reports, see report_scheduler.h.
+static bool send_keyboard_report(void)
+{
+  KeyboardState state = macroPlayer.held;
+  action_held(&engine, &state);
+
+  uint8_t report[KEYBOARD_REPORT_MAX_LEN];
+  uint16_t len;
+#if PLICK_NKRO
+  if (tud_hid_get_protocol() == HID_PROTOCOL_REPORT)
+    len = keyboard_report_nkro(&state, report);
+  else
+#endif
+    len = keyboard_report_boot(&state, report);
+
+  //printf("tud hid report\r\n");
+  if (!report_scheduler_set(REPORT_ID_KEYBOARD, report, len) || report_scheduler_send() != REPORT_ID_KEYBOARD)
+  {
+    latency_report_dropped();
+    return false;
+  }
+
+  latency_report_queued(time_us_32());
+  return true;
+}
+
+// Media keys, mouse and gamepad buttons, each report only when it changed
+static void set_usage_reports(void)
+{
+  UsageState state;
+  action_held_usages(&engine, &state);
+
+  uint8_t report[KEYBOARD_REPORT_MAX_LEN];
+  report_scheduler_set(REPORT_ID_CONSUMER_CONTROL, report, usage_report_consumer(&state, report));
+  report_scheduler_set(REPORT_ID_MOUSE, report, usage_report_mouse(&state, report));
+  report_scheduler_set(REPORT_ID_GAMEPAD, report, usage_report_gamepad(&state, report));
+}
+
+static bool send_usage_reports(void)
+{
+  set_usage_reports();
+  if (!report_scheduler_send())
+  {
+    latency_report_dropped();
+    return false;
+  }
+
+  latency_report_queued(time_us_32());
+  return true;
+}
+
+static void set_button_pressed(Button &b, uint32_t timeUs)
+{
+  b.pressed = b.debounce.stable;
+  action_key(&engine, b.key, b.pressed, timeUs);
+
+  // Layer keys and undecided tap-hold keys change no report right away
+  if (!action_busy(&engine))
+    latency_report_dropped();
+}
+
+// One report per step, a macro key starts its macro on the press. Returns
+// true when every step is taken and the endpoint is still free.
+static bool take_steps(void)
+{
+  ActionStep step;
+  while (tud_hid_ready())
+  {
+    if (!action_next(&engine, &step))
+      return true;
+    if (step.pressed && step.macro && macro_start(&macroPlayer, step.macro - 1, step.timeUs))
+      macroWake = true;
+    if (step.pressed && step.profile && !profile_request(step.profile - 1))
+      printf("ERROR: No profile %u\r\n", step.profile - 1);
+    if (step.usagePage)
+      send_usage_reports();
+    else
+      send_keyboard_report();
+  }
+  return false;
+}
+
+// A profile core 1 made ready goes in between key changes, once nothing
+// of the old one is left to play
+static void switch_profile(void)
+{
+  ActionTable const *next = profile_ready();
+  if (!next || action_busy(&engine) || macroPlayer.running)
+    return;
+
+  uint32_t const start = time_us_32();
+  action_switch(&engine, next);
+  macro_set_code(&macroPlayer, next->macros, next->macroLen);
+  profile_switched();
+  uint32_t const us = time_us_32() - start;
+
+  printf("Profile %u '%s' active, switched in %lu us\r\n", profile_active(), profile_name(profile_active()),
+         (unsigned long)us);
+}
+
+static int64_t macro_alarm_cb(alarm_id_t id, void *user_data)
+{
+  (void)id;
+  (void)user_data;
+  macroWake = true;
+  return 0;
+}
+
+// Steps the macro whenever the endpoint is free, one report per step. Runs
+// only when woken by a macro key, the report complete callback or the alarm
+// at the end of a delay, and never waits itself.
+static void macro_task(void)
+{
+  while (macroWake && tud_hid_ready())
+  {
+    uint32_t const now = time_us_32();
+    switch (macro_run(&macroPlayer, now))
+    {
+    case MACRO_REPORT:
+      // Not sent when held keys already made the report look like this,
+      // go on with the next step right away then
+      send_keyboard_report();
+      break;
+
+    case MACRO_WAIT:
+      macroWake = false;
+      if (add_alarm_in_us(macroPlayer.resumeUs - now, macro_alarm_cb, NULL, true) < 0)
+        macroWake = true;  // no alarm slot free, poll instead
+      return;
+
+    default:
+      macroWake = false;
+      return;
+    }
+  }
+}
+
+// Applies debounced changes in edge order until one of them changes the
+// report. That report is sent and the rest waits for the endpoint, so every
+// state the keys went through reaches the host, one report per frame.
+// Debouncing and tap-hold decisions run on the edge timestamps, so a late
+// report never changes what was detected.
+static void process_key_events(void)
+{
+  KeyEvent ev;
+
+  while (take_steps() && key_event_peek(&ev))
+  {
+    int8_t const index = buttonIndexByPin[ev.pin];
+    if (index < 0)
+    {
+      key_event_pop(&ev);
+      continue;
+    }
+
+    Button &b = buttonGroup[index];
+
+    // A level that settled before this edge is reported first
+    bool changed = debounce_poll(&b.debounce, ev.timeUs);
+    if (!changed)
+    {
+      key_event_pop(&ev);
+      changed = debounce_edge(&b.debounce, ev.level, ev.timeUs);
+    }
+
+    if (changed)
+    {
+      // Timed from the edge that started the change
+      latency_key_decided(b.debounce.changeUs, time_us_32());
+      set_button_pressed(b, ev.timeUs);
+    }
+  }
+
+  // Debounce timeouts and tapping terms, once per scan tick. A tick that
+  // finds the endpoint busy finishes once it is free again.
+  if (scanDue)
+  {
+    uint32_t const now = time_us_32();
+    int i = 0;
+    for (; i < buttonCount && take_steps() && !key_event_available(); i++)
+    {
+      Button &b = buttonGroup[i];
+      if (debounce_poll(&b.debounce, now))
+      {
+        latency_key_decided(b.debounce.changeUs, now);
+        set_button_pressed(b, now);
+      }
+    }
+    if (i == buttonCount && take_steps() && !key_event_available())
+    {
+      action_tick(&engine, now);
+      take_steps();
+      scanDue = false;
+    }
+  }
+
+  // Key states changed without an event, e.g. resync or protocol switch
+  if (keyboardReportDirty && tud_hid_ready())
+  {
+    keyboardReportDirty = false;
+    set_usage_reports();
+    send_keyboard_report();
+  }
+
+  // Keys first, then the reports they left waiting, macros fill the frames
+  // left free
+  if (!key_event_available() && !action_busy(&engine))
+  {
+    report_scheduler_send();
+    macro_task();
+  }
+}
+
+// The actions start over from the keys held now. Their steps are taken
+// without reports, the next report has them all.
+static void sync_actions(uint32_t nowUs)
+{
+  ActionStep step;
+  action_reset(&engine);
+  for (int i = 0; i < buttonCount; i++)
+  {
+    if (!buttonGroup[i].pressed)
+      continue;
+    action_key(&engine, buttonGroup[i].key, true, nowUs);
+    while (action_next(&engine, &step))
+      ;
+  }
+  keyboardReportDirty = true;
+}
+
+// Queue overflowed, the edge history is incomplete so take the pin levels
+// as the new truth and let the next reports catch up.
+static void resync_buttons(void)
+{
+  for (int i = 0; i < buttonCount; i++)
+  {
+    bool const level = key_level(buttonGroup[i]);
+    buttonGroup[i].pressed = level;
+    buttonGroup[i].debounce.raw = level;
+    buttonGroup[i].debounce.stable = level;
+    buttonGroup[i].debounce.locked = false;
+    buttonGroup[i].debounce.changing = false;
+  }
+  sync_actions(time_us_32());
+}
+
+void hid_task(void)
+{
+  KeyEvent ev;
+
+  if (key_event_take_overflow())
+  {
+    resync_buttons();
+  }
+
+  if (tud_suspended())
+  {
+    bool wakeup = false;
+    bool changed = false;
+    while (key_event_pop(&ev))
+    {
+      int8_t const index = buttonIndexByPin[ev.pin];
+      if (index < 0)
+        continue;
+      Button &b = buttonGroup[index];
+      // A level that settled before this edge counts first
+      if (debounce_poll(&b.debounce, ev.timeUs))
+      {
+        b.pressed = b.debounce.stable;
+        changed = true;
+        wakeup |= b.pressed;
+      }
+      if (debounce_edge(&b.debounce, ev.level, ev.timeUs))
+      {
+        b.pressed = b.debounce.stable;
+        changed = true;
+        wakeup |= b.pressed;
+      }
+    }
+
+    // Deferred keys settle without another edge
+    uint32_t const now = time_us_32();
+    for (int i = 0; i < buttonCount; i++)
+    {
+      Button &b = buttonGroup[i];
+      if (debounce_poll(&b.debounce, now))
+      {
+        b.pressed = b.debounce.stable;
+        changed = true;
+        wakeup |= b.pressed;
+      }
+    }
+    if (changed)
+      sync_actions(time_us_32());
+    if (wakeup)
+    {
+      //printf("tud wakeup\r\n");
+      tud_remote_wakeup();
+    }
+    return;
+  }
+
+  switch_profile();
+  process_key_events();
+
+  if (macroPlayer.finished)
+  {
+    macroPlayer.finished = false;
+    uint32_t const us = macroPlayer.finishedUs ? macroPlayer.finishedUs : 1;
+    printf("Macro: %lu reports, %lu chars in %lu us (%lu reports/s, %lu chars/s)\r\n",
+           (unsigned long)macroPlayer.finishedReports, (unsigned long)macroPlayer.finishedChars, (unsigned long)us,
+           (unsigned long)((uint64_t)macroPlayer.finishedReports * 1000000 / us),
+           (unsigned long)((uint64_t)macroPlayer.finishedChars * 1000000 / us));
+  }
+}
+
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint16_t len)
+{
+  (void)instance;
+  (void)report;
+  (void)len;
+
+  latency_report_complete(time_us_32());
+
+  // Endpoint is free again, queue the next change now instead of waiting
+  // for the next pass of the main loop
+  process_key_events();
+}
+
+void tud_hid_set_protocol_cb(uint8_t instance, uint8_t protocol)
+{
+  (void)instance;
+  (void)protocol;
+
+  // Report layout changed, the host needs fresh ones
+  report_scheduler_invalidate();
+  keyboardReportDirty = true;
+}
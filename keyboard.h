@@ -0,0 +1,38 @@
+#ifndef KEYBOARD_H_
+#define KEYBOARD_H_
+
+#include "gpio_trace.h"
+#include "keymap.h"
+
+// Key path on core 0: GPIO edges, debouncing, macros and the keyboard
+// reports, plus the scan tick and the polling interval they depend on.
+// Owns the TinyUSB HID report, protocol and SOF callbacks.
+
+// (Re)builds the key table from keymap (see core1.h)
+void init_buttons(void);
+
+// Main loop steps, none of them blocks
+void scan_task(void);
+void hid_task(void);
+void usb_reconnect_task(void);
+
+// Captures the edges the GPIO interrupt sees, for replay on the host.
+// Starting drops the previous trace, the trace may only be read while
+// capture is stopped.
+#define KEYBOARD_TRACE_BYTES 8192
+
+void keyboard_trace_start(void);
+void keyboard_trace_stop(void);
+GpioTrace const *keyboard_trace(void);
+
+// What key does on layer in the table the keys run from, NULL when there
+// is no such key or layer
+KeymapAction const *keyboard_action(uint8_t key, uint8_t layer);
+
+// Changes the actions of the table the keys run from, all at once and in
+// effect from the next key change on. False without changing anything
+// when a patch is out of range. The next profile switch or keymap reload
+// drops them.
+bool keyboard_patch(KeymapPatch const *patches, uint8_t count);
+
+#endif /* KEYBOARD_H_ */
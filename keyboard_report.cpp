@@ -0,0 +1,143 @@
+#include <string.h>
+
+#include "keyboard_report.h"
+#include "hid_keycodes.h"
+
+#define MODIFIER_USAGE_FIRST 0xE0
+
+void keyboard_state_clear(KeyboardState *s)
+{
+  memset(s->usage, 0, sizeof(s->usage));
+}
+
+void keyboard_state_add(KeyboardState *s, uint8_t keycode)
+{
+  if (keycode == 0)
+    return;
+  s->usage[keycode >> 3] |= (uint8_t)(1u << (keycode & 7));
+}
+
+void keyboard_state_remove(KeyboardState *s, uint8_t keycode)
+{
+  s->usage[keycode >> 3] &= (uint8_t)~(1u << (keycode & 7));
+}
+
+void keyboard_state_merge(KeyboardState *s, KeyboardState const *other)
+{
+  for (size_t i = 0; i < sizeof(s->usage); i++)
+    s->usage[i] |= other->usage[i];
+}
+
+bool keyboard_state_has(KeyboardState const *s, uint8_t keycode)
+{
+  return s->usage[keycode >> 3] & (1u << (keycode & 7));
+}
+
+bool keyboard_state_empty(KeyboardState const *s)
+{
+  for (size_t i = 0; i < sizeof(s->usage); i++)
+  {
+    if (s->usage[i])
+      return false;
+  }
+  return true;
+}
+
+uint8_t keyboard_state_modifier(KeyboardState const *s)
+{
+  // 0xE0 - 0xE7 is exactly one byte of the bitmap
+  return s->usage[MODIFIER_USAGE_FIRST >> 3];
+}
+
+uint16_t keyboard_report_boot(KeyboardState const *s, uint8_t *report)
+{
+  memset(report, 0, KEYBOARD_BOOT_REPORT_LEN);
+  report[0] = keyboard_state_modifier(s);
+
+  int count = 0;
+  for (int byte = 0; byte < (MODIFIER_USAGE_FIRST >> 3); byte++)
+  {
+    uint8_t bits = s->usage[byte];
+    while (bits)
+    {
+      uint8_t const bit = __builtin_ctz(bits);
+      bits &= bits - 1;
+
+      if (count == KEYBOARD_BOOT_KEYS)
+      {
+        memset(&report[2], KEYBOARD_ERROR_ROLLOVER, KEYBOARD_BOOT_KEYS);
+        return KEYBOARD_BOOT_REPORT_LEN;
+      }
+      report[2 + count++] = (uint8_t)(byte * 8 + bit);
+    }
+  }
+  return KEYBOARD_BOOT_REPORT_LEN;
+}
+
+uint16_t keyboard_report_nkro(KeyboardState const *s, uint8_t *report)
+{
+  report[0] = keyboard_state_modifier(s);
+  memcpy(&report[1], s->usage, KEYBOARD_NKRO_KEY_BYTES);
+  return KEYBOARD_NKRO_REPORT_LEN;
+}
+
+void usage_state_add(UsageState *s, uint8_t page, uint16_t usage)
+{
+  switch (page)
+  {
+  case HID_PAGE_CONSUMER:
+    if (!s->consumer)
+      s->consumer = usage;
+    break;
+
+  case HID_PAGE_MOUSE:
+    if (usage >= 1 && usage <= 8)
+      s->mouseButtons |= (uint8_t)(1u << (usage - 1));
+    break;
+
+  case HID_PAGE_GAMEPAD:
+    if (usage >= 1 && usage <= 32)
+      s->gamepadButtons |= 1u << (usage - 1);
+    break;
+  }
+}
+
+uint16_t usage_report_consumer(UsageState const *s, uint8_t *report)
+{
+  report[0] = (uint8_t)s->consumer;
+  report[1] = (uint8_t)(s->consumer >> 8);
+  return CONSUMER_REPORT_LEN;
+}
+
+// No pointer movement, only the buttons
+uint16_t usage_report_mouse(UsageState const *s, uint8_t *report)
+{
+  memset(report, 0, MOUSE_REPORT_LEN);
+  report[0] = s->mouseButtons;
+  return MOUSE_REPORT_LEN;
+}
+
+// Axes centered, hat released
+uint16_t usage_report_gamepad(UsageState const *s, uint8_t *report)
+{
+  memset(report, 0, GAMEPAD_REPORT_LEN);
+  for (int i = 0; i < 4; i++)
+    report[7 + i] = (uint8_t)(s->gamepadButtons >> (8 * i));
+  return GAMEPAD_REPORT_LEN;
+}
+
+bool keyboard_report_differs(KeyboardReportCache const *c, uint8_t const *report, uint16_t len)
+{
+  return c->len != len || memcmp(c->report, report, len) != 0;
+}
+
+void keyboard_report_store(KeyboardReportCache *c, uint8_t const *report, uint16_t len)
+{
+  memcpy(c->report, report, len);
+  c->len = len;
+}
+
+void keyboard_report_invalidate(KeyboardReportCache *c)
+{
+  c->len = 0;
+}
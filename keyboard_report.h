@@ -0,0 +1,75 @@
+#ifndef KEYBOARD_REPORT_H_
+#define KEYBOARD_REPORT_H_
+
+#include <stdint.h>
+
+// Keyboard page usages held at the same time, collected from every key
+// and turned into either a boot protocol or an NKRO bitmap report.
+
+// Boot report: modifier, reserved, 6 keycodes
+#define KEYBOARD_BOOT_REPORT_LEN 8
+#define KEYBOARD_BOOT_KEYS 6
+
+// NKRO report: modifier, then one bit per usage 0x00 - 0xDF
+#define KEYBOARD_NKRO_USAGE_MAX 0xDF
+#define KEYBOARD_NKRO_KEY_BYTES ((KEYBOARD_NKRO_USAGE_MAX + 1) / 8)
+#define KEYBOARD_NKRO_REPORT_LEN (1 + KEYBOARD_NKRO_KEY_BYTES)
+
+#define KEYBOARD_REPORT_MAX_LEN KEYBOARD_NKRO_REPORT_LEN
+
+// Usage sent in every boot slot when more than 6 keys are held
+#define KEYBOARD_ERROR_ROLLOVER 0x01
+
+struct KeyboardState
+{
+  uint8_t usage[32] = { 0 };  // one bit per usage 0x00 - 0xFF
+};
+
+void keyboard_state_clear(KeyboardState *s);
+void keyboard_state_add(KeyboardState *s, uint8_t keycode);
+void keyboard_state_remove(KeyboardState *s, uint8_t keycode);
+void keyboard_state_merge(KeyboardState *s, KeyboardState const *other);
+bool keyboard_state_has(KeyboardState const *s, uint8_t keycode);
+bool keyboard_state_empty(KeyboardState const *s);
+
+// Modifier byte built from usages 0xE0 - 0xE7
+uint8_t keyboard_state_modifier(KeyboardState const *s);
+
+// Fill report, return its length
+uint16_t keyboard_report_boot(KeyboardState const *s, uint8_t *report);
+uint16_t keyboard_report_nkro(KeyboardState const *s, uint8_t *report);
+
+// Media keys, mouse and gamepad buttons held. Each goes into a report of
+// its own next to the keyboard's, see report_scheduler.h.
+struct UsageState
+{
+  uint16_t consumer = 0;  // one consumer control usage at a time
+  uint8_t mouseButtons = 0;   // bit 0 is button 1
+  uint32_t gamepadButtons = 0;
+};
+
+// Layouts of TinyUSB's TUD_HID_REPORT_DESC_CONSUMER, _MOUSE and _GAMEPAD
+#define CONSUMER_REPORT_LEN 2
+#define MOUSE_REPORT_LEN 5     // buttons, x, y, wheel, pan
+#define GAMEPAD_REPORT_LEN 11  // x, y, z, rz, rx, ry, hat, 32 buttons
+
+// A usage of a HidUsagePage other than the keyboard's. With several
+// consumer usages held the first one wins.
+void usage_state_add(UsageState *s, uint8_t page, uint16_t usage);
+
+uint16_t usage_report_consumer(UsageState const *s, uint8_t *report);
+uint16_t usage_report_mouse(UsageState const *s, uint8_t *report);
+uint16_t usage_report_gamepad(UsageState const *s, uint8_t *report);
+
+// Last report handed to the endpoint, so only changes go on the bus
+struct KeyboardReportCache
+{
+  uint8_t report[KEYBOARD_REPORT_MAX_LEN];
+  uint16_t len = 0;  // 0 forces the next report out
+};
+
+bool keyboard_report_differs(KeyboardReportCache const *c, uint8_t const *report, uint16_t len);
+void keyboard_report_store(KeyboardReportCache *c, uint8_t const *report, uint16_t len);
+void keyboard_report_invalidate(KeyboardReportCache *c);
+
+#endif /* KEYBOARD_REPORT_H_ */
@@ -0,0 +1,111 @@
+#include <string.h>
+
+#include "keymap.h"
+#include "crc32.h"
+
+// Matrix, entries, actions and macros are one block, which is what the CRC
+// covers
+static size_t body_size(KeymapHeader const &h)
+{
+  return sizeof(KeymapMatrix) + h.keyCount * sizeof(KeymapEntry) +
+         h.layerCount * h.keyCount * sizeof(KeymapAction) + h.macroLen;
+}
+
+void keymap_seal(KeymapImage *image, uint16_t keyCount, uint8_t layerCount, uint8_t const *macros,
+                 uint16_t macroLen)
+{
+  // Every layer moves down to a lower address, so they go in order
+  KeymapAction *actions = (KeymapAction *)&image->keys[keyCount];
+  for (int layer = 0; layer < layerCount; layer++)
+  {
+    memmove(&actions[layer * keyCount], &image->actionSpace[layer * KEYMAP_MAX_KEYS],
+            keyCount * sizeof(KeymapAction));
+  }
+  memmove(&actions[layerCount * keyCount], macros, macroLen);
+
+  image->header.magic = KEYMAP_MAGIC;
+  image->header.version = KEYMAP_VERSION;
+  image->header.keyCount = keyCount;
+  image->header.macroLen = macroLen;
+  image->header.pollMs = 0;
+  image->header.layerCount = layerCount;
+  image->header.tapTermMs = 0;
+  image->header.tapHoldMode = KEYMAP_TAP_HOLD_PERMISSIVE;
+  image->header.reserved = 0;
+  keymap_update_crc(image);
+}
+
+KeymapAction const *keymap_actions(KeymapImage const *image)
+{
+  return (KeymapAction const *)&image->keys[image->header.keyCount];
+}
+
+uint8_t const *keymap_macros(KeymapImage const *image)
+{
+  return (uint8_t const *)&keymap_actions(image)[image->header.layerCount * image->header.keyCount];
+}
+
+KeymapAction *keymap_action(KeymapImage *image, uint8_t key, uint8_t layer)
+{
+  return (KeymapAction *)&image->keys[image->header.keyCount] + layer * image->header.keyCount + key;
+}
+
+void keymap_update_crc(KeymapImage *image)
+{
+  image->header.crc = crc32(&image->matrix, body_size(image->header));
+}
+
+void keymap_set_usage(KeymapAction *action, uint8_t page, uint16_t usage)
+{
+  action->type = KEYMAP_ACTION_USAGE;
+  action->layer = page;
+  action->keyCode[0] = (uint8_t)usage;
+  action->keyCode[1] = (uint8_t)(usage >> 8);
+}
+
+uint16_t keymap_action_usage(KeymapAction const *action)
+{
+  return action->keyCode[0] | action->keyCode[1] << 8;
+}
+
+static bool lines_valid(uint8_t const *pins, uint8_t count)
+{
+  for (int i = 0; i < count; i++)
+  {
+    if (pins[i] >= KEYMAP_GPIO_COUNT)
+      return false;
+  }
+  return true;
+}
+
+// matrix.cpp sizes its state and the key event sources by these limits
+static bool matrix_valid(KeymapMatrix const &m)
+{
+  if (m.rows > KEYMAP_MATRIX_MAX_LINES || m.cols > KEYMAP_MATRIX_MAX_LINES ||
+      m.rows * m.cols > KEYMAP_MATRIX_MAX_POSITIONS || m.diode > KEYMAP_DIODE_NONE || m.scanner > KEYMAP_SCANNER_PIO)
+    return false;
+  if (m.scanUs && (m.scanUs < KEYMAP_MIN_SCAN_US || m.scanUs > KEYMAP_MAX_SCAN_US))
+    return false;
+  return lines_valid(m.rowPins, m.rows) && lines_valid(m.colPins, m.cols);
+}
+
+bool keymap_valid(KeymapImage const *image, size_t len)
+{
+  if (len < sizeof(KeymapHeader))
+    return false;
+
+  KeymapHeader const &h = image->header;
+  if (h.magic != KEYMAP_MAGIC || h.version != KEYMAP_VERSION || h.keyCount > KEYMAP_MAX_KEYS ||
+      h.layerCount > KEYMAP_MAX_LAYERS || h.macroLen > KEYMAP_MACRO_BYTES)
+    return false;
+
+  if (len < keymap_size(image) || !matrix_valid(image->matrix))
+    return false;
+
+  return crc32(&image->matrix, body_size(h)) == h.crc;
+}
+
+size_t keymap_size(KeymapImage const *image)
+{
+  return sizeof(KeymapHeader) + body_size(image->header);
+}
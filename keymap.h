@@ -0,0 +1,174 @@
+#ifndef KEYMAP_H_
+#define KEYMAP_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Binary keymap as stored in keymap.bin. The file is the header followed by
+// the matrix description, keyCount entries, layerCount * keyCount actions
+// (layer by layer) and macroLen bytes of macro bytecode (see macro.h), so it
+// can be read into a KeymapImage with one f_read. All fields are little
+// endian, like the RP2040.
+
+#define KEYMAP_MAGIC 0x4D4B4C50u  // "PLKM"
+#define KEYMAP_VERSION 4
+#define KEYMAP_MAX_KEYS 128
+#define KEYMAP_MAX_LAYERS 8
+#define KEYMAP_CHORD_LEN 6
+#define KEYMAP_HOLD_CHORD_LEN 4
+#define KEYMAP_MACRO_BYTES 1024
+
+// GPIOs a key or matrix line can use, NUM_BANK0_GPIOS of the RP2040
+#define KEYMAP_GPIO_COUNT 30
+
+// GPIOs of keys that do not name their pin, in order
+#define KEYMAP_DEFAULT_PINS { 26, 27 }
+
+// Key matrix, see matrix.h. A key with pin KEYMAP_PIN_MATRIX sits at row,
+// col of the matrix instead of on a GPIO of its own.
+#define KEYMAP_MATRIX_MAX_LINES 16
+#define KEYMAP_MATRIX_MAX_POSITIONS 224
+#define KEYMAP_PIN_MATRIX 0xFF
+#define KEYMAP_MIN_SCAN_US 20
+#define KEYMAP_MAX_SCAN_US 10000
+
+enum KeymapDiode : uint8_t
+{
+  KEYMAP_DIODE_COL2ROW = 0,  // rows are driven, columns read
+  KEYMAP_DIODE_ROW2COL,      // columns are driven, rows read
+  KEYMAP_DIODE_NONE,         // rows are driven, ghosting is possible
+};
+
+enum KeymapScanner : uint8_t
+{
+  KEYMAP_SCANNER_CPU = 0,    // timer interrupt, direct pins by edge interrupt
+  KEYMAP_SCANNER_PIO,        // PIO and DMA, direct pins sampled as well
+};
+
+// What a key does on one layer, see action_engine.h
+enum KeymapActionType : uint8_t
+{
+  KEYMAP_ACTION_TRANSPARENT = 0,  // the action of the next active layer below
+  KEYMAP_ACTION_KEY,              // chord or macro, nothing when both are empty
+  KEYMAP_ACTION_MOMENTARY,        // layer active while held
+  KEYMAP_ACTION_TOGGLE,           // layer switched on or off on each press
+  KEYMAP_ACTION_ONESHOT,          // layer active for the next key press
+  KEYMAP_ACTION_TAP_HOLD,         // chord or macro on a tap, hold chord or layer when held
+  KEYMAP_ACTION_PROFILE,          // switches to profile layer on press, see profile.h
+  KEYMAP_ACTION_USAGE,            // media key, mouse or gamepad button, see keymap_set_usage()
+};
+
+// Tap-hold keys decided before their tapping term runs out
+enum KeymapTapHoldMode : uint8_t
+{
+  KEYMAP_TAP_HOLD_PERMISSIVE = 0,  // hold once another key is pressed and released
+  KEYMAP_TAP_HOLD_TIMEOUT,         // only the tapping term decides a hold
+  KEYMAP_TAP_HOLD_PRESS,           // hold once another key is pressed
+};
+
+#define KEYMAP_DEFAULT_TAP_TERM_MS 200
+
+struct KeymapHeader
+{
+  uint32_t magic;
+  uint16_t version;
+  uint16_t keyCount;
+  uint32_t crc;       // CRC-32 of the matrix, entries, actions and macros
+  uint16_t macroLen;
+  uint8_t pollMs;     // USB polling interval, 0 for the build default
+  uint8_t layerCount;
+  uint16_t tapTermMs; // 0 for the default
+  uint8_t tapHoldMode;  // KeymapTapHoldMode
+  uint8_t reserved;
+};
+
+struct KeymapMatrix
+{
+  uint8_t rows;       // 0 when there is no matrix
+  uint8_t cols;
+  uint8_t diode;      // KeymapDiode
+  uint8_t scanner;    // KeymapScanner
+  uint16_t scanUs;    // scan period, 0 for the default
+  uint16_t reserved2;
+  uint8_t rowPins[KEYMAP_MATRIX_MAX_LINES];
+  uint8_t colPins[KEYMAP_MATRIX_MAX_LINES];
+};
+
+// The physical key, what it does is in the actions
+struct KeymapEntry
+{
+  uint8_t pin;        // GPIO or KEYMAP_PIN_MATRIX
+  uint8_t debounceAlgorithm;
+  uint8_t row;        // matrix position, when pin is KEYMAP_PIN_MATRIX
+  uint8_t col;
+  uint32_t debounceUs;
+};
+
+struct KeymapAction
+{
+  uint8_t type;       // KeymapActionType
+  uint8_t layer;      // of a layer action, the hold layer of a tap-hold key, a profile or a usage page
+  uint8_t keyCode[KEYMAP_CHORD_LEN];  // chord, or the tap of a tap-hold key
+  uint16_t macro;     // offset into the macros + 1, 0 for a plain chord
+  uint8_t holdCode[KEYMAP_HOLD_CHORD_LEN];  // hold chord, empty to hold the layer
+  uint16_t termMs;    // tapping term, 0 for the keymap's
+};
+
+// Actions start right after keys[keyCount] and macros right after them,
+// actionSpace and macroSpace only make room for them when all keys and
+// layers are used. The parser stages actions in actionSpace with
+// KEYMAP_MAX_KEYS per layer.
+struct KeymapImage
+{
+  KeymapHeader header;
+  KeymapMatrix matrix;
+  KeymapEntry keys[KEYMAP_MAX_KEYS];
+  KeymapAction actionSpace[KEYMAP_MAX_LAYERS * KEYMAP_MAX_KEYS];
+  uint8_t macroSpace[KEYMAP_MACRO_BYTES];
+};
+
+// What key does on layer from now on, for changing a loaded keymap in
+// place, see the console "key" command
+struct KeymapPatch
+{
+  uint8_t key;
+  uint8_t layer;
+  KeymapAction action;
+};
+
+#define KEYMAP_PATCH_MAX 16
+
+static_assert(sizeof(KeymapHeader) == 20, "KeymapHeader layout is part of the file format");
+static_assert(sizeof(KeymapMatrix) == 40, "KeymapMatrix layout is part of the file format");
+static_assert(sizeof(KeymapEntry) == 8, "KeymapEntry layout is part of the file format");
+static_assert(sizeof(KeymapAction) == 16, "KeymapAction layout is part of the file format");
+
+// Fill in the header for the entries already in keys[]. The actions staged
+// in actionSpace and macroLen bytes of bytecode from macros are moved to
+// their place after the keys.
+void keymap_seal(KeymapImage *image, uint16_t keyCount, uint8_t layerCount, uint8_t const *macros,
+                 uint16_t macroLen);
+
+// Action of key on layer is actions[layer * keyCount + key]
+KeymapAction const *keymap_actions(KeymapImage const *image);
+uint8_t const *keymap_macros(KeymapImage const *image);
+
+// Action of key on layer of a sealed image, which may be changed in place
+// followed by keymap_update_crc()
+KeymapAction *keymap_action(KeymapImage *image, uint8_t key, uint8_t layer);
+void keymap_update_crc(KeymapImage *image);
+
+// A usage action keeps its HidUsagePage in layer and the usage in
+// keyCode[0] and keyCode[1], low byte first
+void keymap_set_usage(KeymapAction *action, uint8_t page, uint16_t usage);
+uint16_t keymap_action_usage(KeymapAction const *action);
+
+// Check a freshly read image, len is the number of bytes read. Besides the
+// CRC the matrix has to be within the limits the parser enforces, an image
+// may come from anywhere the host can write to.
+bool keymap_valid(KeymapImage const *image, size_t len);
+
+// Bytes to write for a sealed image
+size_t keymap_size(KeymapImage const *image);
+
+#endif /* KEYMAP_H_ */
@@ -0,0 +1,98 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "pico/multicore.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+
+#include "keymap_flash.h"
+
+#define KEYMAP_FLASH_MAGIC 0x464B4C50u  // "PLKF"
+
+struct KeymapFlashRecord
+{
+  uint32_t magic;
+  uint32_t sourceHash;
+  KeymapImage image;
+};
+
+// Room for the largest keymap, only the sectors a keymap uses are erased
+#define KEYMAP_FLASH_SECTORS ((sizeof(KeymapFlashRecord) + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE)
+#define KEYMAP_FLASH_OFFSET (PICO_FLASH_SIZE_BYTES - KEYMAP_FLASH_SECTORS * FLASH_SECTOR_SIZE)
+
+// End of the program in flash, from the SDK's linker script
+extern "C" char __flash_binary_end;
+
+// The linker script does not reserve the keymap sectors, a program that
+// grew into them is never overwritten
+static bool region_free(void)
+{
+  return KEYMAP_FLASH_OFFSET >= (uintptr_t)&__flash_binary_end - XIP_BASE;
+}
+
+static KeymapFlashRecord const *flash_record(void)
+{
+  return (KeymapFlashRecord const *)(XIP_BASE + KEYMAP_FLASH_OFFSET);
+}
+
+bool keymap_flash_load(KeymapImage *image, uint32_t *sourceHash)
+{
+  KeymapFlashRecord const *record = flash_record();
+
+  if (!region_free())
+    return false;
+  if (record->magic != KEYMAP_FLASH_MAGIC)
+    return false;
+  if (!keymap_valid(&record->image, sizeof(record->image)))
+    return false;
+
+  memcpy(image, &record->image, keymap_size(&record->image));
+  *sourceHash = record->sourceHash;
+  return true;
+}
+
+// Bytes [offset, offset + n) of the record as it ends up in flash
+static void record_bytes(uint8_t *dst, size_t offset, size_t n, uint32_t const *header, KeymapImage const *image)
+{
+  size_t const headerLen = offsetof(KeymapFlashRecord, image);
+  for (size_t i = 0; i < n; i++, offset++)
+  {
+    dst[i] = offset < headerLen ? ((uint8_t const *)header)[offset]
+                                : ((uint8_t const *)image)[offset - headerLen];
+  }
+}
+
+bool keymap_flash_store(KeymapImage const *image, uint32_t sourceHash)
+{
+  if (!region_free())
+    return false;
+
+  uint32_t const header[2] = { KEYMAP_FLASH_MAGIC, sourceHash };
+  size_t const len = offsetof(KeymapFlashRecord, image) + keymap_size(image);
+
+  // Staged one page at a time so the record never needs a sector of RAM
+  uint8_t page[FLASH_PAGE_SIZE];
+
+  // The other core runs from flash as well and has to be parked while the
+  // flash is busy
+  bool const lockout = multicore_lockout_victim_is_initialized(get_core_num() ^ 1);
+  if (lockout)
+    multicore_lockout_start_blocking();
+
+  uint32_t const ints = save_and_disable_interrupts();
+  flash_range_erase(KEYMAP_FLASH_OFFSET, (len + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE * FLASH_SECTOR_SIZE);
+  for (size_t offset = 0; offset < len; offset += FLASH_PAGE_SIZE)
+  {
+    size_t const n = len - offset < FLASH_PAGE_SIZE ? len - offset : FLASH_PAGE_SIZE;
+    memset(page, 0xFF, sizeof(page));
+    record_bytes(page, offset, n, header, image);
+    flash_range_program(KEYMAP_FLASH_OFFSET + offset, page, FLASH_PAGE_SIZE);
+  }
+  restore_interrupts(ints);
+
+  if (lockout)
+    multicore_lockout_end_blocking();
+
+  return memcmp(&flash_record()->image, image, keymap_size(image)) == 0;
+}
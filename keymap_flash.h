@@ -0,0 +1,20 @@
+#ifndef KEYMAP_FLASH_H_
+#define KEYMAP_FLASH_H_
+
+#include <stdint.h>
+
+#include "keymap.h"
+
+// Copy of the last keymap loaded from the SD card, kept in the last sectors
+// of the on-board flash so the keys work before the card is touched.
+// sourceHash identifies the SD files the copy was built from.
+
+bool keymap_flash_load(KeymapImage *image, uint32_t *sourceHash);
+
+// Erases and programs the sectors the keymap needs with interrupts
+// disabled, takes tens of ms per sector. The other core is locked out
+// meanwhile if it registered as a victim. False when the program reaches
+// into the keymap sectors or the flash does not read back the keymap.
+bool keymap_flash_store(KeymapImage const *image, uint32_t sourceHash);
+
+#endif /* KEYMAP_FLASH_H_ */
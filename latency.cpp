@@ -0,0 +1,159 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "latency.h"
+
+enum
+{
+  SAMPLE_IDLE = 0,
+  SAMPLE_DECIDED,
+  SAMPLE_QUEUED,
+};
+
+static LatencyHistogram histograms[LATENCY_STAGE_COUNT];
+static char const *const stageNames[LATENCY_STAGE_COUNT] = { "debounce", "queue", "usb", "total", "taphold" };
+
+// The report in flight, the endpoint holds one at a time
+static uint8_t sampleState = SAMPLE_IDLE;
+static uint32_t edgeUs;
+static uint32_t decidedUs;
+static uint32_t queuedUs;
+
+// 0 - 3 exactly, then 4 buckets per power of two
+static uint32_t bucket_index(uint32_t us)
+{
+  if (us < 4)
+    return us;
+  uint32_t const octave = 31 - __builtin_clz(us);
+  uint32_t const index = 4 * (octave - 1) + ((us >> (octave - 2)) & 3);
+  return index < LATENCY_BUCKETS ? index : LATENCY_BUCKETS - 1;
+}
+
+static uint32_t bucket_lower(uint32_t index)
+{
+  if (index < 4)
+    return index;
+  return (4 + (index & 3)) << (index / 4 - 1);
+}
+
+static void record(LatencyStage stage, uint32_t us)
+{
+  LatencyHistogram &h = histograms[stage];
+  if (h.count == 0 || us < h.min)
+    h.min = us;
+  if (us > h.max)
+    h.max = us;
+  h.count++;
+  h.sum += us;
+  h.buckets[bucket_index(us)]++;
+}
+
+void latency_key_decided(uint32_t edge, uint32_t nowUs)
+{
+  if (sampleState != SAMPLE_IDLE)
+    return;
+  sampleState = SAMPLE_DECIDED;
+  edgeUs = edge;
+  decidedUs = nowUs;
+}
+
+void latency_report_queued(uint32_t nowUs)
+{
+  if (sampleState != SAMPLE_DECIDED)
+    return;
+  sampleState = SAMPLE_QUEUED;
+  queuedUs = nowUs;
+}
+
+void latency_report_dropped(void)
+{
+  if (sampleState == SAMPLE_DECIDED)
+    sampleState = SAMPLE_IDLE;
+}
+
+void latency_report_complete(uint32_t nowUs)
+{
+  if (sampleState != SAMPLE_QUEUED)
+    return;
+  sampleState = SAMPLE_IDLE;
+
+  record(LATENCY_DEBOUNCE, decidedUs - edgeUs);
+  record(LATENCY_QUEUE, queuedUs - decidedUs);
+  record(LATENCY_USB, nowUs - queuedUs);
+  record(LATENCY_TOTAL, nowUs - edgeUs);
+}
+
+void latency_tap_hold(uint32_t waitUs)
+{
+  record(LATENCY_TAP_HOLD, waitUs);
+}
+
+void latency_reset(void)
+{
+  memset(histograms, 0, sizeof(histograms));
+  sampleState = SAMPLE_IDLE;
+}
+
+LatencyHistogram const *latency_histogram(LatencyStage stage)
+{
+  return &histograms[stage];
+}
+
+uint32_t latency_percentile(LatencyHistogram const *h, uint32_t permille)
+{
+  if (h->count == 0)
+    return 0;
+
+  uint64_t const rank = ((uint64_t)h->count * permille + 999) / 1000;
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < LATENCY_BUCKETS; i++)
+  {
+    seen += h->buckets[i];
+    if (seen >= rank)
+    {
+      // Never report more than was actually measured
+      uint32_t const upper = i + 1 < LATENCY_BUCKETS ? bucket_lower(i + 1) - 1 : h->max;
+      return upper < h->max ? upper : h->max;
+    }
+  }
+  return h->max;
+}
+
+void latency_dump_start(LatencyDump *d)
+{
+  d->stage = 0;
+  d->bucket = -1;
+}
+
+bool latency_dump_line(LatencyDump *d, char *line, size_t size)
+{
+  while (d->stage < LATENCY_STAGE_COUNT)
+  {
+    LatencyHistogram const *h = &histograms[d->stage];
+
+    if (d->bucket < 0)
+    {
+      d->bucket = 0;
+      snprintf(line, size, "%s: n=%lu min=%lu max=%lu mean=%lu p50=%lu p99=%lu us\r\n", stageNames[d->stage],
+               (unsigned long)h->count, (unsigned long)h->min, (unsigned long)h->max,
+               (unsigned long)(h->count ? h->sum / h->count : 0), (unsigned long)latency_percentile(h, 500),
+               (unsigned long)latency_percentile(h, 990));
+      return true;
+    }
+
+    while (d->bucket < LATENCY_BUCKETS && h->buckets[d->bucket] == 0)
+      d->bucket++;
+
+    if (d->bucket < LATENCY_BUCKETS)
+    {
+      snprintf(line, size, "  >=%lu us: %lu\r\n", (unsigned long)bucket_lower(d->bucket),
+               (unsigned long)h->buckets[d->bucket]);
+      d->bucket++;
+      return true;
+    }
+
+    d->stage++;
+    d->bucket = -1;
+  }
+  return false;
+}
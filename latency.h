@@ -0,0 +1,65 @@
+#ifndef LATENCY_H_
+#define LATENCY_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Keypress latency, split into the steps a press takes to reach the host:
+//
+//   GPIO edge -> debounce decision -> report queued -> report completed
+//
+// Every step feeds a histogram with 4 buckets per power of two (about 25%
+// resolution) from 1 us to about a minute, plus exact count, min, max and
+// mean. Recording costs a few additions, it stays on in every build.
+
+enum LatencyStage
+{
+  LATENCY_DEBOUNCE = 0,  // edge to debounce decision
+  LATENCY_QUEUE,         // decision to report handed to the endpoint
+  LATENCY_USB,           // queued to transfer complete
+  LATENCY_TOTAL,         // edge to transfer complete
+  LATENCY_TAP_HOLD,      // tap-hold press to tap or hold decision
+  LATENCY_STAGE_COUNT
+};
+
+#define LATENCY_BUCKETS 100
+
+struct LatencyHistogram
+{
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t sum;
+  uint32_t buckets[LATENCY_BUCKETS];
+};
+
+// A key changed state because of the edge at edgeUs. Only the first change
+// that goes into a report is timed.
+void latency_key_decided(uint32_t edgeUs, uint32_t nowUs);
+
+// The report with the change went to the endpoint, or was not needed
+void latency_report_queued(uint32_t nowUs);
+void latency_report_dropped(void);
+
+void latency_report_complete(uint32_t nowUs);
+
+// A tap-hold key was decided waitUs after its press
+void latency_tap_hold(uint32_t waitUs);
+
+void latency_reset(void);
+LatencyHistogram const *latency_histogram(LatencyStage stage);
+
+// Upper bound of the bucket holding the given fraction of samples
+uint32_t latency_percentile(LatencyHistogram const *h, uint32_t permille);
+
+// Text dump, one line per call. Returns false when there is nothing left.
+struct LatencyDump
+{
+  uint8_t stage;
+  int16_t bucket;  // -1 for the summary line of the stage
+};
+
+void latency_dump_start(LatencyDump *d);
+bool latency_dump_line(LatencyDump *d, char *line, size_t size);
+
+#endif /* LATENCY_H_ */
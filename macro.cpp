@@ -0,0 +1,148 @@
+#include <string.h>
+
+#include "macro.h"
+
+static void begin(MacroPlayer *m, uint16_t offset, uint32_t nowUs)
+{
+  m->running = true;
+  m->pc = offset;
+  m->waiting = false;
+  m->startUs = nowUs;
+  m->reports = 0;
+  m->chars = 0;
+}
+
+static void update_held(MacroPlayer *m)
+{
+  m->held = m->pressed;
+  keyboard_state_merge(&m->held, &m->typed);
+}
+
+void macro_reset(MacroPlayer *m, uint8_t const *code, uint16_t codeLen)
+{
+  *m = MacroPlayer();
+  m->code = code;
+  m->codeLen = codeLen;
+}
+
+void macro_set_code(MacroPlayer *m, uint8_t const *code, uint16_t codeLen)
+{
+  m->code = code;
+  m->codeLen = codeLen;
+}
+
+bool macro_start(MacroPlayer *m, uint16_t offset, uint32_t nowUs)
+{
+  if (offset >= m->codeLen)
+    return false;
+
+  if (!m->running)
+  {
+    begin(m, offset, nowUs);
+    return true;
+  }
+
+  if (m->queueCount == MACRO_QUEUE_LEN)
+    return false;
+  m->queue[(m->queueHead + m->queueCount++) % MACRO_QUEUE_LEN] = offset;
+  return true;
+}
+
+// Next byte of the running macro, running off the end reads as MACRO_END
+static uint8_t fetch(MacroPlayer *m)
+{
+  return m->pc < m->codeLen ? m->code[m->pc++] : (uint8_t)MACRO_END;
+}
+
+MacroResult macro_run(MacroPlayer *m, uint32_t nowUs)
+{
+  while (m->running)
+  {
+    if (m->waiting)
+    {
+      if ((int32_t)(nowUs - m->resumeUs) < 0)
+        return MACRO_WAIT;
+      m->waiting = false;
+    }
+
+    if (m->typing)
+    {
+      if (type_encoder_next(&m->typer, &m->typed))
+      {
+        update_held(m);
+        m->reports++;
+        return MACRO_REPORT;
+      }
+      m->typing = false;
+    }
+
+    uint8_t const op = fetch(m);
+    switch (op)
+    {
+    case MACRO_PRESS:
+    {
+      uint8_t const usage = fetch(m);
+      keyboard_state_add(&m->pressed, usage);
+      update_held(m);
+      break;
+    }
+
+    case MACRO_RELEASE:
+    {
+      uint8_t const usage = fetch(m);
+      keyboard_state_remove(&m->pressed, usage);
+      update_held(m);
+      break;
+    }
+
+    case MACRO_SYNC:
+      m->reports++;
+      return MACRO_REPORT;
+
+    case MACRO_DELAY:
+    {
+      uint16_t ms = fetch(m);
+      ms |= fetch(m) << 8;
+      m->waiting = true;
+      m->resumeUs = nowUs + ms * 1000u;
+      break;
+    }
+
+    case MACRO_TYPE:
+    {
+      uint16_t len = fetch(m);
+      if (len > m->codeLen - m->pc)
+        len = m->codeLen - m->pc;
+      type_encoder_init(&m->typer, (char const *)&m->code[m->pc], len);
+      m->pc += len;
+      m->typing = true;
+      m->chars += len;
+      break;
+    }
+
+    default:
+      // MACRO_END, or a broken macro: let go of everything and move on
+      m->running = false;
+      m->finished = true;
+      m->finishedUs = nowUs - m->startUs;
+      m->finishedReports = m->reports;
+      m->finishedChars = m->chars;
+
+      if (m->queueCount)
+      {
+        begin(m, m->queue[m->queueHead], nowUs);
+        m->queueHead = (m->queueHead + 1) % MACRO_QUEUE_LEN;
+        m->queueCount--;
+      }
+
+      if (!keyboard_state_empty(&m->held))
+      {
+        keyboard_state_clear(&m->pressed);
+        keyboard_state_clear(&m->held);
+        return MACRO_REPORT;
+      }
+      break;
+    }
+  }
+  return MACRO_IDLE;
+}
@@ -0,0 +1,86 @@
+#ifndef MACRO_H_
+#define MACRO_H_
+
+#include <stdint.h>
+
+#include "keyboard_report.h"
+#include "type_encoder.h"
+
+// Macro bytecode, as stored after the keys in the keymap. Every op is one
+// byte followed by its operand:
+//
+//   MACRO_PRESS usage      add a keyboard usage to the held set
+//   MACRO_RELEASE usage    remove it again
+//   MACRO_SYNC             send the held set as one report
+//   MACRO_DELAY ms (u16)   wait before the next op
+//   MACRO_TYPE len text    type len ASCII characters, see type_encoder.h
+//   MACRO_END              release whatever is still held
+//
+// A tapped chord is PRESS.. SYNC RELEASE.. SYNC, so the host sees the keys
+// go down together and come up together.
+
+enum MacroOp : uint8_t
+{
+  MACRO_END = 0x00,
+  MACRO_PRESS = 0x01,
+  MACRO_RELEASE = 0x02,
+  MACRO_SYNC = 0x03,
+  MACRO_DELAY = 0x04,
+  MACRO_TYPE = 0x05,
+};
+
+// Presses of macro keys while a macro plays wait in line
+#define MACRO_QUEUE_LEN 4
+
+enum MacroResult
+{
+  MACRO_IDLE = 0,  // nothing to play
+  MACRO_REPORT,    // held changed, send a report before running again
+  MACRO_WAIT,      // delay until resumeUs
+};
+
+struct MacroPlayer
+{
+  uint8_t const *code = nullptr;
+  uint16_t codeLen = 0;
+
+  bool running = false;
+  uint16_t pc = 0;
+  bool waiting = false;
+  uint32_t resumeUs = 0;
+  KeyboardState pressed;  // by MACRO_PRESS
+  bool typing = false;
+  TypeEncoder typer;
+  KeyboardState typed;    // current report of the text being typed
+  KeyboardState held;     // both together, what goes into the report
+
+  uint16_t queue[MACRO_QUEUE_LEN];
+  uint8_t queueHead = 0;
+  uint8_t queueCount = 0;
+
+  // Throughput of the macro that finished last
+  uint32_t startUs = 0;
+  uint32_t reports = 0;
+  uint32_t chars = 0;
+  bool finished = false;
+  uint32_t finishedReports = 0;
+  uint32_t finishedChars = 0;
+  uint32_t finishedUs = 0;
+};
+
+// Stops everything and plays from code from now on
+void macro_reset(MacroPlayer *m, uint8_t const *code, uint16_t codeLen);
+
+// Plays from code from the next macro on, only while none is playing
+void macro_set_code(MacroPlayer *m, uint8_t const *code, uint16_t codeLen);
+
+// Plays the macro at offset, or queues it behind the one playing.
+// Returns false when the queue is full.
+bool macro_start(MacroPlayer *m, uint16_t offset, uint32_t nowUs);
+
+// Runs ops until a report is due, a delay starts or the queue is empty.
+// Never blocks, the caller comes back after the report went out or at
+// resumeUs.
+MacroResult macro_run(MacroPlayer *m, uint32_t nowUs);
+
+#endif /* MACRO_H_ */
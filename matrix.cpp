@@ -0,0 +1,327 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+
+#include "matrix.h"
+#include "key_event_queue.h"
+#include "pio_scan.h"
+
+static KeymapMatrix config;
+static matrix_change_cb_t changeCallback = NULL;
+static repeating_timer_t timer;
+static bool active = false;
+static bool usingPio = false;
+static uint32_t periodUs;
+static MatrixStats stats;
+
+// Pressed columns of every row
+static uint16_t state[KEYMAP_MATRIX_MAX_LINES];
+
+// Side that is pulled low one line at a time, and the side that is read
+static uint8_t const *drivePins;
+static uint8_t driveCount;
+static uint8_t const *readPins;
+static uint8_t readCount;
+
+// Direct pins sampled by the PIO and their last levels
+static uint32_t directPins;
+static uint32_t directLevels;
+
+// PIO samples: one per driven line and scan, at least one per scan. Only
+// the pins of the keys count when comparing scans.
+static uint8_t scanWords;
+static uint32_t sampleMask;
+static uint32_t tail;  // next sample to drain
+static uint32_t lastScan[PIO_SCAN_MAX_LINES];
+
+static bool matrix_timer_cb(repeating_timer_t *rt)
+{
+  (void)rt;
+  if (usingPio)
+    matrix_drain();
+  else
+    matrix_scan();
+  return true;
+}
+
+static void release_lines(void)
+{
+  for (int i = 0; i < config.rows; i++)
+    gpio_set_dir(config.rowPins[i], GPIO_IN);
+  for (int i = 0; i < config.cols; i++)
+    gpio_set_dir(config.colPins[i], GPIO_IN);
+}
+
+static void init_lines(void)
+{
+  bool const rowsDriven = config.diode != KEYMAP_DIODE_ROW2COL;
+  drivePins = rowsDriven ? config.rowPins : config.colPins;
+  driveCount = rowsDriven ? config.rows : config.cols;
+  readPins = rowsDriven ? config.colPins : config.rowPins;
+  readCount = rowsDriven ? config.cols : config.rows;
+
+  // A driven line is an output low, released it floats high like the read
+  // side, so two lines never drive against each other
+  for (int i = 0; i < driveCount; i++)
+  {
+    gpio_init(drivePins[i]);
+    gpio_put(drivePins[i], 0);
+    gpio_set_dir(drivePins[i], GPIO_IN);
+    gpio_pull_up(drivePins[i]);
+  }
+  for (int i = 0; i < readCount; i++)
+  {
+    gpio_init(readPins[i]);
+    gpio_set_dir(readPins[i], GPIO_IN);
+    gpio_pull_up(readPins[i]);
+  }
+}
+
+static bool start_pio(void)
+{
+  scanWords = driveCount ? driveCount : 1;
+  if (periodUs < PIO_SCAN_MIN_US(scanWords))
+    periodUs = PIO_SCAN_MIN_US(scanWords);
+  if (!pio_scan_start(drivePins, driveCount, periodUs))
+    return false;
+
+  sampleMask = directPins;
+  for (int i = 0; i < readCount; i++)
+    sampleMask |= 1u << readPins[i];
+  directLevels = gpio_get_all() & directPins;
+  // The first scan always counts as a change
+  memset(lastScan, 0xFF, sizeof(lastScan));
+  tail = 0;
+  usingPio = true;
+  return add_repeating_timer_us(-MATRIX_PIO_DRAIN_US, matrix_timer_cb, NULL, &timer);
+}
+
+void matrix_init(KeymapMatrix const *newConfig, uint32_t newDirectPins, matrix_change_cb_t onChange)
+{
+  if (active)
+  {
+    cancel_repeating_timer(&timer);
+    if (usingPio)
+      pio_scan_stop();
+    release_lines();
+    active = false;
+  }
+
+  config = *newConfig;
+  changeCallback = onChange;
+  usingPio = false;
+  memset(state, 0, sizeof(state));
+  memset(&stats, 0, sizeof(stats));
+  stats.sinceUs = time_us_32();
+
+  driveCount = readCount = 0;
+  if (config.rows && config.cols)
+    init_lines();
+  directPins = config.scanner == KEYMAP_SCANNER_PIO ? newDirectPins : 0;
+  if (!driveCount && !directPins)
+    return;
+
+  periodUs = config.scanUs ? config.scanUs : MATRIX_DEFAULT_SCAN_US;
+  if (config.scanner == KEYMAP_SCANNER_PIO)
+  {
+    active = start_pio();
+    if (active)
+      return;
+    printf("ERROR: No PIO for the key scan, scanning on the CPU\r\n");
+    pio_scan_stop();
+    usingPio = false;
+    directPins = 0;
+    if (!driveCount)
+      return;
+    if (periodUs < MATRIX_CPU_MIN_SCAN_US)
+      periodUs = MATRIX_CPU_MIN_SCAN_US;
+  }
+
+  // Negative delay: period from start to start, however long a scan takes
+  active = add_repeating_timer_us(-(int32_t)periodUs, matrix_timer_cb, NULL, &timer);
+}
+
+bool matrix_active(void)
+{
+  return active;
+}
+
+bool matrix_uses_pio(void)
+{
+  return active && usingPio;
+}
+
+uint32_t matrix_sampled_pins(void)
+{
+  return active ? directPins : 0;
+}
+
+// Rows that share two pressed columns could be showing ghosts of each
+// other, keep what they had before
+static void filter_ghosts(uint16_t *rows)
+{
+  bool ghost = false;
+  for (int a = 0; a < config.rows; a++)
+  {
+    for (int b = a + 1; b < config.rows; b++)
+    {
+      uint16_t const shared = rows[a] & rows[b];
+      if (shared & (shared - 1))
+      {
+        rows[a] = state[a];
+        rows[b] = state[b];
+        ghost = true;
+      }
+    }
+  }
+  stats.ghosts += ghost;
+}
+
+// Read side pins pulled low while drive line d was driven
+static void decode_line(int d, uint32_t low, uint16_t *rows)
+{
+  for (int r = 0; r < readCount; r++)
+  {
+    if (!(low & (1u << readPins[r])))
+      continue;
+    if (drivePins == config.rowPins)
+      rows[d] |= 1u << r;
+    else
+      rows[r] |= 1u << d;
+  }
+}
+
+// Reports the keys that differ from the last scan, returns whether any did
+static bool apply_rows(uint16_t *rows, uint32_t timeUs)
+{
+  if (config.diode == KEYMAP_DIODE_NONE)
+    filter_ghosts(rows);
+
+  bool any = false;
+  for (int r = 0; r < config.rows; r++)
+  {
+    uint16_t changed = rows[r] ^ state[r];
+    state[r] = rows[r];
+    any |= changed != 0;
+    while (changed)
+    {
+      int const c = __builtin_ctz(changed);
+      changed &= changed - 1;
+      if (changeCallback)
+        changeCallback(KEY_EVENT_MATRIX + r * config.cols + c, rows[r] & (1u << c), timeUs);
+    }
+  }
+  return any;
+}
+
+static void account(uint32_t start)
+{
+  uint32_t const us = time_us_32() - start;
+  stats.lastUs = us;
+  stats.totalUs += us;
+  if (us > stats.maxUs)
+    stats.maxUs = us;
+}
+
+void matrix_scan(void)
+{
+  uint32_t const start = time_us_32();
+  uint16_t rows[KEYMAP_MATRIX_MAX_LINES] = { 0 };
+
+  for (int d = 0; d < driveCount; d++)
+  {
+    gpio_set_dir(drivePins[d], GPIO_OUT);
+    busy_wait_us_32(MATRIX_SETTLE_US);
+    uint32_t const low = ~gpio_get_all();
+    gpio_set_dir(drivePins[d], GPIO_IN);
+    decode_line(d, low, rows);
+  }
+
+  stats.scans++;
+  stats.changed += apply_rows(rows, start);
+  account(start);
+}
+
+static void decode_scan(uint32_t const *samples, uint32_t timeUs)
+{
+  if (driveCount)
+  {
+    uint16_t rows[KEYMAP_MATRIX_MAX_LINES] = { 0 };
+    for (int d = 0; d < driveCount; d++)
+      decode_line(d, ~samples[d], rows);
+    apply_rows(rows, timeUs);
+  }
+
+  // No line is driven to the direct pins, any sample of the scan will do
+  uint32_t changed = (samples[0] ^ directLevels) & directPins;
+  directLevels = samples[0] & directPins;
+  while (changed)
+  {
+    int const pin = __builtin_ctz(changed);
+    changed &= changed - 1;
+    if (changeCallback)
+      changeCallback(pin, directLevels & (1u << pin), timeUs);
+  }
+}
+
+void matrix_drain(void)
+{
+  uint32_t const start = time_us_32();
+  uint32_t const head = pio_scan_head();
+  uint32_t const volatile *ring = pio_scan_ring();
+
+  // Half the ring is the margin for the DMA going on while this runs. A
+  // drain that came later than that drops the oldest scans, the next scan
+  // still takes every key to its current state.
+  uint32_t const behind = head - tail;
+  if (behind > PIO_SCAN_RING_WORDS / 2)
+  {
+    uint32_t const drop = (behind - PIO_SCAN_RING_WORDS / 2 + scanWords - 1) / scanWords;
+    tail += drop * scanWords;
+    stats.lost += drop;
+  }
+
+  while (head - tail >= scanWords)
+  {
+    uint32_t scan[PIO_SCAN_MAX_LINES];
+    bool changed = false;
+    for (int i = 0; i < scanWords; i++)
+    {
+      scan[i] = ring[(tail + i) % PIO_SCAN_RING_WORDS] & sampleMask;
+      changed |= scan[i] != lastScan[i];
+    }
+
+    // Scans still waiting after this one, a period each
+    uint32_t const newer = (head - tail) / scanWords - 1;
+    tail += scanWords;
+    stats.scans++;
+    if (!changed)
+      continue;
+
+    memcpy(lastScan, scan, scanWords * sizeof(scan[0]));
+    stats.changed++;
+    decode_scan(scan, start - newer * periodUs);
+  }
+
+  account(start);
+}
+
+bool matrix_pressed(uint8_t position)
+{
+  if (!config.cols || position >= config.rows * config.cols)
+    return false;
+  return state[position / config.cols] & (1u << (position % config.cols));
+}
+
+MatrixStats const *matrix_stats(void)
+{
+  return &stats;
+}
+
+void matrix_reset_stats(void)
+{
+  memset(&stats, 0, sizeof(stats));
+  stats.sinceUs = time_us_32();
+}
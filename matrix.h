@@ -0,0 +1,72 @@
+#ifndef MATRIX_H_
+#define MATRIX_H_
+
+#include <stdint.h>
+
+#include "keymap.h"
+
+// Row/column key matrix, scanned at a fixed rate that does not depend on
+// the main loop.
+//
+// One line of the driven side is pulled low at a time while the others
+// float with their pull-ups, the read side is sampled in one register read.
+// With col2row diodes rows are driven and columns read, with row2col the
+// other way around. Without diodes (diode=none) rows are driven, and a scan
+// where two rows share two or more pressed columns is ambiguous: either
+// could be a ghost of the other three keys. Those rows keep their previous
+// state until the scan is unambiguous again, and the scan counts as a ghost.
+//
+// scanner=cpu scans from a repeating timer. scanner=pio leaves the scans
+// to a PIO state machine and DMA (see pio_scan.h) and samples the direct
+// pins along with the matrix. A timer then drains the samples every
+// MATRIX_PIO_DRAIN_US, and only scans that differ from the one before are
+// decoded. Their time is known to one scan period.
+//
+// Changes are reported as key event sources: KEY_EVENT_MATRIX + row * cols
+// + col with the pressed state, or a sampled direct pin with its level.
+
+#define MATRIX_DEFAULT_SCAN_US 1000
+#define MATRIX_CPU_MIN_SCAN_US 100
+#define MATRIX_PIO_DRAIN_US 250
+
+// Driven line to sampling, for the pull-ups to charge the line released
+// before
+#define MATRIX_SETTLE_US 1
+
+typedef void (*matrix_change_cb_t)(uint8_t source, bool level, uint32_t timeUs);
+
+struct MatrixStats
+{
+  uint32_t scans;
+  uint32_t changed;   // scans that differed from the one before
+  uint32_t ghosts;    // scans with ambiguous rows
+  uint32_t lost;      // PIO scans overwritten before they were drained
+  uint32_t lastUs;    // cost of the last scan, or drain with the PIO
+  uint32_t maxUs;
+  uint64_t totalUs;
+  uint32_t sinceUs;   // start of the counts
+};
+
+// Stops the running scan and starts one for config, if it has a matrix or
+// the PIO scanner is to sample directPins (a mask of GPIOs). Falls back to
+// the CPU scanner without direct pins when the PIO is not available.
+// onChange runs in the timer interrupt.
+void matrix_init(KeymapMatrix const *config, uint32_t directPins, matrix_change_cb_t onChange);
+
+bool matrix_active(void);
+bool matrix_uses_pio(void);
+
+// Direct pins the scanner samples, they need no edge interrupt
+uint32_t matrix_sampled_pins(void);
+
+// One CPU scan, or one drain of the PIO samples, as run by the timer
+void matrix_scan(void);
+void matrix_drain(void);
+
+// State of the last scan after ghost filtering, not debounced
+bool matrix_pressed(uint8_t position);
+
+MatrixStats const *matrix_stats(void);
+void matrix_reset_stats(void);
+
+#endif /* MATRIX_H_ */
@@ -0,0 +1,230 @@
+#include <atomic>
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "tusb.h"
+#include "ff.h"
+#include "diskio.h"
+
+#include "msc_disk.h"
+
+#define MSC_DRIVE 0
+
+enum
+{
+  TRANSFER_IDLE = 0,  // core 0 may queue one
+  TRANSFER_QUEUED,    // core 1 works on it
+  TRANSFER_DONE,      // back to core 0
+  TRANSFER_FAILED,
+};
+
+struct MscTransfer
+{
+  bool write;
+  uint32_t lba;
+  uint16_t count;
+};
+
+static std::atomic<uint8_t> owner{MSC_OWNER_FIRMWARE};
+static uint32_t blockCount = 0;  // written by core 1 before handing over
+static MscStats stats;
+
+// One transfer at a time, the data goes both ways through transferData
+static MscTransfer transfer;
+alignas(4) static uint8_t transferData[MSC_TRANSFER_BYTES];
+static std::atomic<uint8_t> transferState{TRANSFER_IDLE};
+
+//--------------------------------------------------------------------+
+// Core 0 side
+//--------------------------------------------------------------------+
+bool msc_expose(void)
+{
+#if CFG_TUD_MSC
+  uint8_t expected = MSC_OWNER_FIRMWARE;
+  return owner.compare_exchange_strong(expected, MSC_OWNER_HANDING, std::memory_order_acq_rel);
+#else
+  return false;
+#endif
+}
+
+bool msc_return(void)
+{
+  uint8_t expected = MSC_OWNER_HOST;
+  return owner.compare_exchange_strong(expected, MSC_OWNER_RETURNING, std::memory_order_acq_rel);
+}
+
+MscOwner msc_owner(void)
+{
+  return (MscOwner)owner.load(std::memory_order_acquire);
+}
+
+MscStats const *msc_stats(void)
+{
+  return &stats;
+}
+
+#if CFG_TUD_MSC
+// 0 while core 1 works on the chunk, TinyUSB calls again on its next run
+static int32_t transfer_chunk(uint8_t lun, bool write, uint32_t lba, void *buffer, uint32_t bufsize)
+{
+  if (msc_owner() != MSC_OWNER_HOST || bufsize % MSC_BLOCK_SIZE || bufsize > MSC_TRANSFER_BYTES)
+  {
+    tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, 0x3A, 0x00);
+    return -1;
+  }
+  uint16_t const count = bufsize / MSC_BLOCK_SIZE;
+
+  switch (transferState.load(std::memory_order_acquire))
+  {
+  case TRANSFER_IDLE:
+    transfer.write = write;
+    transfer.lba = lba;
+    transfer.count = count;
+    if (write)
+      memcpy(transferData, buffer, bufsize);
+    transferState.store(TRANSFER_QUEUED, std::memory_order_release);
+    return 0;
+
+  case TRANSFER_QUEUED:
+    return 0;
+
+  default:
+    break;
+  }
+
+  // Left over from a command the host gave up on, start this one over
+  bool const failed = transferState.load(std::memory_order_relaxed) == TRANSFER_FAILED;
+  bool const same = transfer.write == write && transfer.lba == lba && transfer.count == count;
+  transferState.store(TRANSFER_IDLE, std::memory_order_release);
+  if (!same)
+    return 0;
+
+  if (failed)
+  {
+    tud_msc_set_sense(lun, SCSI_SENSE_MEDIUM_ERROR, write ? 0x0C : 0x11, 0x00);
+    return -1;
+  }
+  if (!write)
+    memcpy(buffer, transferData, bufsize);
+  return (int32_t)bufsize;
+}
+
+void tud_msc_inquiry_cb(uint8_t lun, uint8_t vendor_id[8], uint8_t product_id[16], uint8_t product_rev[4])
+{
+  (void)lun;
+  memcpy(vendor_id, "Plick   ", 8);
+  memcpy(product_id, "SD Card         ", 16);
+  memcpy(product_rev, "1.0 ", 4);
+}
+
+bool tud_msc_test_unit_ready_cb(uint8_t lun)
+{
+  if (msc_owner() == MSC_OWNER_HOST)
+    return true;
+  tud_msc_set_sense(lun, SCSI_SENSE_NOT_READY, 0x3A, 0x00);  // medium not present
+  return false;
+}
+
+void tud_msc_capacity_cb(uint8_t lun, uint32_t *block_count, uint16_t *block_size)
+{
+  (void)lun;
+  *block_count = msc_owner() == MSC_OWNER_HOST ? blockCount : 0;
+  *block_size = MSC_BLOCK_SIZE;
+}
+
+bool tud_msc_start_stop_cb(uint8_t lun, uint8_t power_condition, bool start, bool load_eject)
+{
+  (void)lun;
+  (void)power_condition;
+
+  // Ejected, the card goes back to the firmware
+  if (load_eject && !start)
+    msc_return();
+  return true;
+}
+
+int32_t tud_msc_read10_cb(uint8_t lun, uint32_t lba, uint32_t offset, void *buffer, uint32_t bufsize)
+{
+  (void)offset;  // chunks are whole blocks
+  return transfer_chunk(lun, false, lba, buffer, bufsize);
+}
+
+int32_t tud_msc_write10_cb(uint8_t lun, uint32_t lba, uint32_t offset, uint8_t *buffer, uint32_t bufsize)
+{
+  (void)offset;
+  return transfer_chunk(lun, true, lba, buffer, bufsize);
+}
+
+int32_t tud_msc_scsi_cb(uint8_t lun, uint8_t const scsi_cmd[16], void *buffer, uint16_t bufsize)
+{
+  (void)buffer;
+  (void)bufsize;
+
+  // Nothing keeps the host from ejecting, everything else is unsupported
+  if (scsi_cmd[0] == SCSI_CMD_PREVENT_ALLOW_MEDIUM_REMOVAL)
+    return 0;
+  tud_msc_set_sense(lun, SCSI_SENSE_ILLEGAL_REQUEST, 0x20, 0x00);
+  return -1;
+}
+#endif
+
+//--------------------------------------------------------------------+
+// Core 1 side
+//--------------------------------------------------------------------+
+bool msc_handover_requested(void)
+{
+  return msc_owner() == MSC_OWNER_HANDING;
+}
+
+bool msc_hand_over(void)
+{
+  LBA_t sectors = 0;
+  if ((disk_initialize(MSC_DRIVE) & STA_NOINIT) || disk_ioctl(MSC_DRIVE, GET_SECTOR_COUNT, &sectors) != RES_OK)
+  {
+    owner.store(MSC_OWNER_FIRMWARE, std::memory_order_release);
+    return false;
+  }
+
+  blockCount = (uint32_t)sectors;
+  memset(&stats, 0, sizeof(stats));
+  transferState.store(TRANSFER_IDLE, std::memory_order_relaxed);
+  owner.store(MSC_OWNER_HOST, std::memory_order_release);
+  return true;
+}
+
+bool msc_task(void)
+{
+  // Finished even when the host is gone meanwhile, core 0 never takes a
+  // queued transfer back
+  if (transferState.load(std::memory_order_acquire) == TRANSFER_QUEUED)
+  {
+    uint32_t const start = time_us_32();
+    DRESULT const res = transfer.write ? disk_write(MSC_DRIVE, transferData, transfer.lba, transfer.count)
+                                       : disk_read(MSC_DRIVE, transferData, transfer.lba, transfer.count);
+    uint32_t const us = time_us_32() - start;
+
+    uint32_t const bytes = transfer.count * MSC_BLOCK_SIZE;
+    if (transfer.write)
+    {
+      stats.writeBytes += bytes;
+      stats.writeUs += us;
+    }
+    else
+    {
+      stats.readBytes += bytes;
+      stats.readUs += us;
+    }
+    stats.transfers++;
+    if (res != RES_OK)
+      stats.errors++;
+    transferState.store(res == RES_OK ? TRANSFER_DONE : TRANSFER_FAILED, std::memory_order_release);
+  }
+
+  // A transfer queued just before the eject goes first
+  if (msc_owner() != MSC_OWNER_RETURNING || transferState.load(std::memory_order_acquire) == TRANSFER_QUEUED)
+    return false;
+
+  disk_ioctl(MSC_DRIVE, CTRL_SYNC, NULL);
+  owner.store(MSC_OWNER_FIRMWARE, std::memory_order_release);
+  return true;
+}
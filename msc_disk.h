@@ -0,0 +1,73 @@
+#ifndef MSC_DISK_H_
+#define MSC_DISK_H_
+
+#include <stdint.h>
+
+// The SD card as a USB drive, for copying data.txt, profiles and the rest
+// in bulk instead of through the CDC upload.
+//
+// The card has one owner at a time. After boot it is the firmware's and the
+// drive reports no medium. "msc on" on the console hands it to the host:
+// core 1 lets go of FatFs and serves blocks from then on. Once the host
+// ejects the drive, or on "msc off", core 1 takes it back, mounts it and
+// reloads the keymap and the profiles, parsing data.txt again if the host
+// changed it.
+//
+// The TinyUSB callbacks run on core 0 and never touch the card. Each chunk
+// of a READ10 or WRITE10 goes to core 1 as one disk_read() or disk_write()
+// of up to MSC_TRANSFER_BYTES, which the SD driver does as one multi-block
+// SPI transfer. Until core 1 is done the callback reports busy and TinyUSB
+// asks again on its next run, so the key path never waits for the card.
+
+#define MSC_BLOCK_SIZE 512
+#define MSC_TRANSFER_BYTES 4096  // CFG_TUD_MSC_EP_BUFSIZE
+
+enum MscOwner : uint8_t
+{
+  MSC_OWNER_FIRMWARE = 0,
+  MSC_OWNER_HANDING,    // asked for, core 1 has not let go yet
+  MSC_OWNER_HOST,
+  MSC_OWNER_RETURNING,  // ejected, core 1 has not taken it back yet
+};
+
+struct MscStats
+{
+  uint32_t readBytes;
+  uint32_t readUs;      // time core 1 spent in disk_read
+  uint32_t writeBytes;
+  uint32_t writeUs;
+  uint32_t transfers;
+  uint32_t errors;
+};
+
+//--------------------------------------------------------------------+
+// Core 0 side
+//--------------------------------------------------------------------+
+// Hands the card to the host, false when it is not the firmware's or the
+// build has no drive (PLICK_MSC)
+bool msc_expose(void);
+
+// Takes it back without the host ejecting it, false when the host does
+// not have it. Writes the host has not flushed yet are lost.
+bool msc_return(void);
+
+//--------------------------------------------------------------------+
+// Either side
+//--------------------------------------------------------------------+
+MscOwner msc_owner(void);
+MscStats const *msc_stats(void);
+
+//--------------------------------------------------------------------+
+// Core 1 side
+//--------------------------------------------------------------------+
+// The host asked for the card, FatFs has to let go of it first
+bool msc_handover_requested(void);
+
+// Takes the card for the host, false when it cannot be read
+bool msc_hand_over(void);
+
+// Serves a waiting transfer. Returns true once when the host gave the card
+// back, FatFs may mount it again.
+bool msc_task(void);
+
+#endif /* MSC_DISK_H_ */
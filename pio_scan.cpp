@@ -0,0 +1,225 @@
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/dma.h"
+#include "hardware/gpio.h"
+#include "hardware/pio.h"
+
+#include "pio_scan.h"
+#include "pio_scan.pio.h"
+
+// Samples per run of the ring channel, the control channel starts the next
+// run right away. A power of two so pio_scan_head() can count across runs.
+#define PIO_SCAN_RUN (1u << 31)
+
+#define PIO_SCAN_CYCLES_PER_US (PIO_SCAN_HZ / 1000000)
+
+// The DMA ring wraps at an address boundary of its own size
+static uint32_t ring[PIO_SCAN_RING_WORDS] __attribute__((aligned(PIO_SCAN_RING_WORDS * 4)));
+
+// Line masks, the release mask and the idle cycles, see pio_scan.pio
+static uint32_t program[PIO_SCAN_MAX_LINES + 2];
+static uint32_t const *programStart = program;
+static uint32_t const runLength = PIO_SCAN_RUN;
+
+static PIO pio;
+static int sm = -1;
+static uint offset;
+static int maskChannel = -1;
+static int maskRestartChannel = -1;
+static int ringChannel = -1;
+static int ringRestartChannel = -1;
+static uint8_t pins[PIO_SCAN_MAX_LINES];
+static uint8_t pinCount;
+
+static uint32_t head;
+static uint32_t lastRemaining;
+
+// Another state machine of the PIO owns the pins between the drive pins,
+// writing pin directions across them would fight it
+static bool span_free(PIO p, uint8_t base, uint8_t span, uint32_t driveMask)
+{
+  gpio_function const function = p == pio0 ? GPIO_FUNC_PIO0 : GPIO_FUNC_PIO1;
+  for (int i = 0; i < span; i++)
+  {
+    if (!(driveMask & (1u << i)) && gpio_get_function(base + i) == function)
+      return false;
+  }
+  return true;
+}
+
+static bool claim_state_machine(uint8_t base, uint8_t span, uint32_t driveMask)
+{
+  PIO const candidates[] = { pio0, pio1 };
+  for (PIO p : candidates)
+  {
+    if (!pio_can_add_program(p, &pio_scan_program) || !span_free(p, base, span, driveMask))
+      continue;
+    sm = pio_claim_unused_sm(p, false);
+    if (sm < 0)
+      continue;
+    pio = p;
+    offset = pio_add_program(p, &pio_scan_program);
+    return true;
+  }
+  return false;
+}
+
+bool pio_scan_start(uint8_t const *drivePins, uint8_t lines, uint32_t periodUs)
+{
+  pio_scan_stop();
+
+  uint8_t const driven = lines ? lines : 1;
+  if (lines > PIO_SCAN_MAX_LINES || periodUs < PIO_SCAN_MIN_US(driven))
+    return false;
+
+  uint8_t base = 0;
+  uint8_t top = 0;
+  for (int i = 0; i < lines; i++)
+  {
+    if (i == 0 || drivePins[i] < base)
+      base = drivePins[i];
+    if (drivePins[i] > top)
+      top = drivePins[i];
+  }
+  uint8_t const span = lines ? top - base + 1 : 1;
+  if (span > 32)
+    return false;
+
+  uint32_t driveMask = 0;
+  for (int i = 0; i < lines; i++)
+  {
+    program[i] = 1u << (drivePins[i] - base);
+    driveMask |= program[i];
+  }
+  if (!lines)
+    program[0] = 0;
+  program[driven] = 0;
+  program[driven + 1] = periodUs * PIO_SCAN_CYCLES_PER_US - driven * 12 - 4;
+
+  if (!claim_state_machine(base, span, driveMask))
+  {
+    sm = -1;
+    return false;
+  }
+
+  // Low when driven, input with the pull-up otherwise
+  for (int i = 0; i < lines; i++)
+  {
+    pins[i] = drivePins[i];
+    pio_gpio_init(pio, drivePins[i]);
+  }
+  pinCount = lines;
+  pio_sm_set_pins_with_mask(pio, sm, 0, driveMask << base);
+  pio_sm_set_pindirs_with_mask(pio, sm, 0, driveMask << base);
+
+  pio_sm_config c = pio_scan_program_get_default_config(offset);
+  sm_config_set_out_pins(&c, base, span);
+  sm_config_set_in_pins(&c, 0);
+  sm_config_set_out_shift(&c, true, true, 32);
+  sm_config_set_in_shift(&c, false, true, 32);
+  sm_config_set_clkdiv(&c, (float)clock_get_hz(clk_sys) / PIO_SCAN_HZ);
+  pio_sm_init(pio, sm, offset, &c);
+  pio_sm_exec(pio, sm, pio_encode_set(pio_y, driven - 1));
+
+  maskChannel = dma_claim_unused_channel(false);
+  maskRestartChannel = dma_claim_unused_channel(false);
+  ringChannel = dma_claim_unused_channel(false);
+  ringRestartChannel = dma_claim_unused_channel(false);
+  if (maskChannel < 0 || maskRestartChannel < 0 || ringChannel < 0 || ringRestartChannel < 0)
+  {
+    pio_scan_stop();
+    return false;
+  }
+
+  // Feeds the program once, then the restart channel points it back at the
+  // start and triggers it again
+  dma_channel_config cfg = dma_channel_get_default_config(maskChannel);
+  channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+  channel_config_set_read_increment(&cfg, true);
+  channel_config_set_write_increment(&cfg, false);
+  channel_config_set_dreq(&cfg, pio_get_dreq(pio, sm, true));
+  channel_config_set_chain_to(&cfg, maskRestartChannel);
+  dma_channel_configure(maskChannel, &cfg, &pio->txf[sm], program, driven + 2, false);
+
+  cfg = dma_channel_get_default_config(maskRestartChannel);
+  channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+  channel_config_set_read_increment(&cfg, false);
+  channel_config_set_write_increment(&cfg, false);
+  dma_channel_configure(maskRestartChannel, &cfg, &dma_hw->ch[maskChannel].al3_read_addr_trig, &programStart, 1,
+                        false);
+
+  // Samples go round the ring, the write address wraps by itself and only
+  // the count has to be restarted
+  cfg = dma_channel_get_default_config(ringChannel);
+  channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+  channel_config_set_read_increment(&cfg, false);
+  channel_config_set_write_increment(&cfg, true);
+  channel_config_set_ring(&cfg, true, __builtin_ctz(sizeof(ring)));
+  channel_config_set_dreq(&cfg, pio_get_dreq(pio, sm, false));
+  channel_config_set_chain_to(&cfg, ringRestartChannel);
+  dma_channel_configure(ringChannel, &cfg, ring, &pio->rxf[sm], PIO_SCAN_RUN, true);
+
+  cfg = dma_channel_get_default_config(ringRestartChannel);
+  channel_config_set_transfer_data_size(&cfg, DMA_SIZE_32);
+  channel_config_set_read_increment(&cfg, false);
+  channel_config_set_write_increment(&cfg, false);
+  dma_channel_configure(ringRestartChannel, &cfg, &dma_hw->ch[ringChannel].al1_transfer_count_trig, &runLength, 1,
+                        false);
+
+  head = 0;
+  lastRemaining = PIO_SCAN_RUN;
+  dma_channel_start(maskChannel);
+  pio_sm_set_enabled(pio, sm, true);
+  return true;
+}
+
+static void unchain(int channel)
+{
+  dma_channel_config cfg = dma_get_channel_config(channel);
+  channel_config_set_chain_to(&cfg, channel);
+  dma_channel_set_config(channel, &cfg, false);
+}
+
+void pio_scan_stop(void)
+{
+  if (sm < 0)
+    return;
+
+  pio_sm_set_enabled(pio, sm, false);
+
+  // A restart channel must not trigger the channel being aborted
+  if (maskChannel >= 0)
+    unchain(maskChannel);
+  if (ringChannel >= 0)
+    unchain(ringChannel);
+  int const channels[] = { maskRestartChannel, ringRestartChannel, maskChannel, ringChannel };
+  for (int channel : channels)
+  {
+    if (channel < 0)
+      continue;
+    dma_channel_abort(channel);
+    dma_channel_unclaim(channel);
+  }
+
+  pio_sm_unclaim(pio, sm);
+  pio_remove_program(pio, &pio_scan_program, offset);
+  sm = -1;
+  maskChannel = maskRestartChannel = ringChannel = ringRestartChannel = -1;
+
+  for (int i = 0; i < pinCount; i++)
+    gpio_init(pins[i]);
+  pinCount = 0;
+}
+
+uint32_t pio_scan_head(void)
+{
+  uint32_t const remaining = dma_hw->ch[ringChannel].transfer_count;
+  head += (lastRemaining - remaining) & (PIO_SCAN_RUN - 1);
+  lastRemaining = remaining;
+  return head;
+}
+
+uint32_t const volatile *pio_scan_ring(void)
+{
+  return ring;
+}
@@ -0,0 +1,38 @@
+#ifndef PIO_SCAN_H_
+#define PIO_SCAN_H_
+
+#include <stdint.h>
+
+// Scans keys on a PIO state machine, see pio_scan.pio. Each scan pulls the
+// drive lines low one after another and samples all GPIOs with each, a
+// scan without drive lines samples once. One DMA channel feeds the line
+// masks in a loop, another one writes the samples into a ring, so the CPU
+// does nothing per scan and reads the samples whenever it likes.
+
+#define PIO_SCAN_MAX_LINES 16
+
+// Samples the ring holds, a power of two
+#define PIO_SCAN_RING_WORDS 1024
+
+// State machine clock, one cycle is 100 ns
+#define PIO_SCAN_HZ 10000000
+
+// Shortest scan period for a number of drive lines, at least one
+#define PIO_SCAN_MIN_US(lines) (((lines) * 12u + 4u + 9u) / 10u)
+
+// Starts scanning every periodUs. drivePins are the GPIOs pulled low, one
+// per sample, none for sampling the pins as they are. They must be within
+// 32 pins of each other and not between pins another state machine of the
+// same PIO drives. Returns false if that fails or no state machine or DMA
+// channel is free.
+bool pio_scan_start(uint8_t const *drivePins, uint8_t lines, uint32_t periodUs);
+void pio_scan_stop(void);
+
+// Samples written since the start. Wraps at 2^32, a multiple of the ring
+// size, so sample n is at ring[n % PIO_SCAN_RING_WORDS]. Has to be called
+// at least once every 2^31 samples to keep count.
+uint32_t pio_scan_head(void);
+
+uint32_t const volatile *pio_scan_ring(void);
+
+#endif /* PIO_SCAN_H_ */
@@ -0,0 +1,134 @@
+#include <atomic>
+#include <string.h>
+
+#include "profile.h"
+#include "spsc_queue.h"
+
+struct Profile
+{
+  char name[PROFILE_NAME_LEN];
+  uint32_t offset;  // of the sealed keymap in the pool
+};
+
+// Written by core 1 before publishing, read only afterwards
+alignas(4) static uint8_t pool[PROFILE_POOL_BYTES];
+static uint32_t poolUsed = 0;
+static Profile profiles[PROFILE_MAX];
+static uint8_t profileCount = 0;
+static std::atomic<uint8_t> publishedCount{0};
+
+// Core 0 runs from tables[activeTable], core 1 fills the other one while
+// standbyReady is false. Flipping activeTable and clearing standbyReady
+// hands the old one over.
+static ActionTable tables[2];
+static uint8_t activeTable = 0;
+static uint8_t activeProfile = 0;   // core 0
+static uint8_t standbyProfile = 0;  // core 1, before standbyReady
+static std::atomic<bool> standbyReady{false};
+static SpscQueue<uint8_t, 4> requests;  // core 0 -> core 1
+
+//--------------------------------------------------------------------+
+// Core 1 side
+//--------------------------------------------------------------------+
+void profile_clear(void)
+{
+  publishedCount.store(0, std::memory_order_release);
+  poolUsed = 0;
+  profileCount = 0;
+}
+
+bool profile_add(char const *name, KeymapImage const *image)
+{
+  size_t const size = keymap_size(image);
+  if (profileCount == PROFILE_MAX || poolUsed + size > sizeof(pool))
+    return false;
+
+  Profile &p = profiles[profileCount++];
+  strncpy(p.name, name, sizeof(p.name) - 1);
+  p.name[sizeof(p.name) - 1] = 0;
+  p.offset = poolUsed;
+  memcpy(&pool[poolUsed], image, size);
+  poolUsed = (poolUsed + size + 3) & ~3u;
+  return true;
+}
+
+KeymapImage *profile_image(uint8_t index)
+{
+  return (KeymapImage *)&pool[profiles[index].offset];
+}
+
+void profile_publish(void)
+{
+  publishedCount.store(profileCount, std::memory_order_release);
+}
+
+void profile_task(void)
+{
+  if (standbyReady.load(std::memory_order_acquire))
+    return;
+
+  uint8_t index;
+  if (!requests.pop(&index) || index >= profileCount)
+    return;
+
+  action_table_load(&tables[activeTable ^ 1], profile_image(index));
+  standbyProfile = index;
+  standbyReady.store(true, std::memory_order_release);
+}
+
+//--------------------------------------------------------------------+
+// Core 0 side
+//--------------------------------------------------------------------+
+ActionTable *profile_reset_table(void)
+{
+  activeProfile = 0;
+  standbyReady.store(false, std::memory_order_release);
+  return &tables[activeTable];
+}
+
+uint8_t profile_count(void)
+{
+  return publishedCount.load(std::memory_order_acquire);
+}
+
+char const *profile_name(uint8_t index)
+{
+  return index < profile_count() ? profiles[index].name : "";
+}
+
+int profile_find(char const *name)
+{
+  for (int i = 0; i < profile_count(); i++)
+  {
+    if (strcmp(profiles[i].name, name) == 0)
+      return i;
+  }
+  return -1;
+}
+
+uint8_t profile_active(void)
+{
+  return activeProfile;
+}
+
+bool profile_request(uint8_t index)
+{
+  return index < profile_count() && requests.push(index);
+}
+
+ActionTable *profile_active_table(void)
+{
+  return &tables[activeTable];
+}
+
+ActionTable const *profile_ready(void)
+{
+  return standbyReady.load(std::memory_order_acquire) ? &tables[activeTable ^ 1] : NULL;
+}
+
+void profile_switched(void)
+{
+  activeTable ^= 1;
+  activeProfile = standbyProfile;
+  standbyReady.store(false, std::memory_order_release);
+}
@@ -0,0 +1,73 @@
+#ifndef PROFILE_H_
+#define PROFILE_H_
+
+#include <stdint.h>
+
+#include "keymap.h"
+#include "action_engine.h"
+
+// Keymap profiles: data.txt is profile 0 "default", every profiles/NAME.txt
+// on the card is one more, in name order. Core 1 parses and validates them
+// all in the background once data.txt is loaded and keeps them in RAM, so a
+// switch needs no card. A profile has to define the same keys as data.txt
+// (pins, matrix, debounce), only what they do may differ.
+//
+// The keys run from one of two ActionTables. A switch is requested by a
+// PF(n) key or the console "profile" command. Core 1 copies the profile
+// into the standby table, core 0 flips to it between key changes once no
+// steps or macro are pending, which takes a few us. Keys held across the
+// flip keep what they do until they are released.
+
+#define PROFILE_MAX 8
+#define PROFILE_NAME_LEN 16
+// The default profile always fits, even at the largest keymap, the others
+// share what is left
+#define PROFILE_POOL_BYTES (sizeof(KeymapImage) + 16 * 1024)
+
+static_assert(PROFILE_MAX <= KEYMAP_MAX_LAYERS, "PF(n) takes a single digit like the layer actions");
+
+//--------------------------------------------------------------------+
+// Core 1 side
+//--------------------------------------------------------------------+
+// Core 0 sees no profiles until the next profile_publish()
+void profile_clear(void);
+
+// Keeps a copy of a sealed keymap, false when the pool or the list is full
+bool profile_add(char const *name, KeymapImage const *image);
+
+// Sealed keymap of a profile added before, only core 1 may change it
+KeymapImage *profile_image(uint8_t index);
+
+// Hands the list to core 0, requests are taken from now on
+void profile_publish(void);
+
+// Fills the standby table when a switch was requested and the previous
+// one was taken
+void profile_task(void);
+
+//--------------------------------------------------------------------+
+// Core 0 side
+//--------------------------------------------------------------------+
+// Table the keys start from after a keymap (re)load, profile 0. Drops a
+// switch that was not taken yet.
+ActionTable *profile_reset_table(void);
+
+// Number of profiles, 0 until core 1 published them
+uint8_t profile_count(void);
+char const *profile_name(uint8_t index);
+int profile_find(char const *name);  // -1 when there is none
+uint8_t profile_active(void);
+
+// Asks core 1 for profile index, false when there is no such profile or
+// too many requests are waiting
+bool profile_request(uint8_t index);
+
+// Table the keys run from, only core 0 may change it
+ActionTable *profile_active_table(void);
+
+// The standby table once core 1 filled it, NULL before. After switching
+// the keys to it, profile_switched() makes it the active one.
+ActionTable const *profile_ready(void);
+void profile_switched(void);
+
+#endif /* PROFILE_H_ */
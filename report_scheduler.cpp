@@ -0,0 +1,76 @@
+#include <string.h>
+
+#include "tusb.h"
+#include "usb_descriptors.h"
+#include "keyboard_report.h"
+#include "report_scheduler.h"
+
+struct ReportSlot
+{
+  uint8_t report[KEYBOARD_REPORT_MAX_LEN];
+  uint16_t len;
+  bool dirty;
+  KeyboardReportCache sent;
+};
+
+static_assert(CONSUMER_REPORT_LEN <= KEYBOARD_REPORT_MAX_LEN && MOUSE_REPORT_LEN <= KEYBOARD_REPORT_MAX_LEN &&
+                  GAMEPAD_REPORT_LEN <= KEYBOARD_REPORT_MAX_LEN,
+              "ReportSlot too small");
+
+// Indexed by report ID - 1
+static ReportSlot slots[REPORT_ID_COUNT - 1];
+
+// Most important first
+static uint8_t const priority[] = {
+  REPORT_ID_KEYBOARD,
+  REPORT_ID_CONSUMER_CONTROL,
+  REPORT_ID_MOUSE,
+  REPORT_ID_GAMEPAD,
+};
+
+static_assert(sizeof(priority) == REPORT_ID_COUNT - 1, "Report ID missing from the priority list");
+
+bool report_scheduler_set(uint8_t reportId, uint8_t const *report, uint16_t len)
+{
+  if (reportId == 0 || reportId >= REPORT_ID_COUNT || len > KEYBOARD_REPORT_MAX_LEN)
+    return false;
+
+  ReportSlot &s = slots[reportId - 1];
+  s.dirty = keyboard_report_differs(&s.sent, report, len);
+  if (!s.dirty)
+    return false;
+
+  memcpy(s.report, report, len);
+  s.len = len;
+  return true;
+}
+
+uint8_t report_scheduler_send(void)
+{
+  if (!tud_hid_ready())
+    return 0;
+
+  bool const boot = tud_hid_get_protocol() == HID_PROTOCOL_BOOT;
+  for (uint8_t id : priority)
+  {
+    if (boot && id != REPORT_ID_KEYBOARD)
+      break;
+
+    ReportSlot &s = slots[id - 1];
+    if (!s.dirty)
+      continue;
+    if (!tud_hid_report(boot ? 0 : id, s.report, s.len))
+      return 0;
+
+    s.dirty = false;
+    keyboard_report_store(&s.sent, s.report, s.len);
+    return id;
+  }
+  return 0;
+}
+
+void report_scheduler_invalidate(void)
+{
+  for (ReportSlot &s : slots)
+    keyboard_report_invalidate(&s.sent);
+}
@@ -0,0 +1,30 @@
+#ifndef REPORT_SCHEDULER_H_
+#define REPORT_SCHEDULER_H_
+
+#include <stdint.h>
+
+// One HID endpoint carries the keyboard, consumer control, mouse and
+// gamepad reports, told apart by their report ID (see desc_hid_report).
+//
+// Each report ID has one pending slot holding the newest report for it. A
+// slot is dirty while it differs from what the host last got, and a report
+// replaced before it went out is never sent. The endpoint takes one report
+// per completion, the most important dirty one first: keyboard, consumer
+// control, mouse, gamepad. A media key or mouse button held meanwhile so
+// never makes a key change wait a polling interval.
+//
+// With the boot protocol only the keyboard report goes out, without its ID.
+// The other slots wait for the report protocol.
+
+// Newest report for reportId. False when it equals the last one sent, the
+// slot is clean then.
+bool report_scheduler_set(uint8_t reportId, uint8_t const *report, uint16_t len);
+
+// Hands the most important dirty report to the endpoint if it is free.
+// Returns its report ID, 0 when none went out.
+uint8_t report_scheduler_send(void);
+
+// Every report goes out again, e.g. after a protocol switch
+void report_scheduler_invalidate(void);
+
+#endif /* REPORT_SCHEDULER_H_ */
@@ -0,0 +1,267 @@
+#include <string.h>
+
+#include "pico/stdlib.h"
+#include "sd_card.h"
+
+#include "sd_storage.h"
+
+#define TEMP_SUFFIX ".tmp"
+#define BACKUP_SUFFIX ".bak"
+#define PATH_MAX_LEN 32
+
+static FATFS fs;
+static bool mounted = false;
+
+static FIL uploadFile;
+static bool uploadActive = false;
+static FRESULT uploadError = FR_OK;
+static char uploadPath[PATH_MAX_LEN];
+static StorageStats stats;
+
+// Sector buffers: current one fills, pending one waits for the card
+static uint8_t sectorBuffers[2][STORAGE_SECTOR_SIZE] __attribute__((aligned(4)));
+static uint8_t current = 0;
+static uint16_t fillLen = 0;
+static int8_t pending = -1;
+
+static bool make_path(char *out, char const *path, char const *suffix)
+{
+  size_t const len = strlen(path);
+  if (len + strlen(suffix) >= PATH_MAX_LEN)
+    return false;
+  memcpy(out, path, len);
+  strcpy(out + len, suffix);
+  return true;
+}
+
+// Drop the mount when the card went away, the next call mounts again
+static FRESULT check(FRESULT fr)
+{
+  if (fr == FR_DISK_ERR || fr == FR_NOT_READY)
+    mounted = false;
+  return fr;
+}
+
+FRESULT storage_mount(void)
+{
+  if (mounted)
+    return FR_OK;
+
+  if (!sd_init_driver())
+    return FR_NOT_READY;
+
+  FRESULT const fr = f_mount(&fs, "0:", 1);
+  mounted = fr == FR_OK;
+  return fr;
+}
+
+void storage_unmount(void)
+{
+  if (uploadActive)
+    storage_upload_abort();
+  if (mounted)
+    f_unmount("0:");
+  mounted = false;
+}
+
+// Commit order is: close temp, path -> backup, temp -> path, drop backup.
+// A backup on the card means a commit was cut off after the temp file was
+// complete.
+void storage_recover(char const *path)
+{
+  char temp[PATH_MAX_LEN];
+  char backup[PATH_MAX_LEN];
+  if (!make_path(temp, path, TEMP_SUFFIX) || !make_path(backup, path, BACKUP_SUFFIX))
+    return;
+
+  FILINFO info;
+  if (f_stat(backup, &info) != FR_OK)
+    return;
+
+  if (f_stat(path, &info) != FR_OK)
+  {
+    if (f_rename(temp, path) != FR_OK)
+      f_rename(backup, path);
+  }
+  f_unlink(backup);
+}
+
+static FRESULT write_buffer(uint8_t const *data, UINT len)
+{
+  UINT bw = 0;
+  uint32_t const start = time_us_32();
+  FRESULT fr = check(f_write(&uploadFile, data, len, &bw));
+  stats.writeUs += time_us_32() - start;
+  stats.writes++;
+  stats.bytes += bw;
+
+  if (fr == FR_OK && bw != len)
+    fr = FR_DENIED;  // card full
+  return fr;
+}
+
+static FRESULT flush_pending(void)
+{
+  if (pending < 0)
+    return FR_OK;
+
+  // Whole sectors at sector aligned offsets go straight to the card
+  // without FatFs copying them through its own window
+  FRESULT const fr = write_buffer(sectorBuffers[pending], STORAGE_SECTOR_SIZE);
+  pending = -1;
+  return fr;
+}
+
+FRESULT storage_upload_begin(char const *path, uint32_t sizeHint)
+{
+  if (uploadActive)
+    storage_upload_abort();
+
+  char temp[PATH_MAX_LEN];
+  if (!make_path(temp, path, TEMP_SUFFIX))
+    return FR_INVALID_NAME;
+
+  FRESULT fr = storage_mount();
+  if (fr != FR_OK)
+    return fr;
+
+  fr = check(f_open(&uploadFile, temp, FA_WRITE | FA_CREATE_ALWAYS));
+  if (fr != FR_OK)
+    return fr;
+
+  // Seeking past the end allocates the cluster chain now instead of one
+  // cluster at a time during the upload
+  if (sizeHint)
+  {
+    fr = check(f_lseek(&uploadFile, sizeHint));
+    if (fr == FR_OK)
+      fr = check(f_lseek(&uploadFile, 0));
+    if (fr != FR_OK)
+    {
+      f_close(&uploadFile);
+      return fr;
+    }
+  }
+
+  strcpy(uploadPath, path);
+  uploadActive = true;
+  uploadError = FR_OK;
+  memset(&stats, 0, sizeof(stats));
+  current = 0;
+  fillLen = 0;
+  pending = -1;
+  return FR_OK;
+}
+
+FRESULT storage_upload_write(void const *data, uint32_t len)
+{
+  if (!uploadActive)
+    return FR_INT_ERR;
+  if (uploadError != FR_OK)
+    return uploadError;
+
+  uint8_t const *bytes = (uint8_t const *)data;
+  while (len)
+  {
+    uint32_t n = STORAGE_SECTOR_SIZE - fillLen;
+    if (n > len)
+      n = len;
+    memcpy(&sectorBuffers[current][fillLen], bytes, n);
+    fillLen += n;
+    bytes += n;
+    len -= n;
+
+    if (fillLen < STORAGE_SECTOR_SIZE)
+      break;
+
+    // Both buffers full, the card has to catch up now
+    uploadError = flush_pending();
+    if (uploadError != FR_OK)
+      return uploadError;
+
+    pending = current;
+    current ^= 1;
+    fillLen = 0;
+  }
+  return FR_OK;
+}
+
+FRESULT storage_task(void)
+{
+  if (!uploadActive)
+    return FR_OK;
+  if (uploadError == FR_OK)
+    uploadError = flush_pending();
+  return uploadError;
+}
+
+FRESULT storage_upload_commit(void)
+{
+  if (!uploadActive)
+    return FR_INT_ERR;
+
+  FRESULT fr = uploadError;
+  if (fr == FR_OK)
+    fr = flush_pending();
+  if (fr == FR_OK && fillLen)
+    fr = write_buffer(sectorBuffers[current], fillLen);
+  // Cut off what the size hint allocated but was never written
+  if (fr == FR_OK)
+    fr = check(f_truncate(&uploadFile));
+  if (fr != FR_OK)
+  {
+    storage_upload_abort();
+    return fr;
+  }
+
+  uploadActive = false;
+  fr = check(f_close(&uploadFile));
+  if (fr != FR_OK)
+    return fr;
+
+  char temp[PATH_MAX_LEN];
+  char backup[PATH_MAX_LEN];
+  make_path(temp, uploadPath, TEMP_SUFFIX);
+  make_path(backup, uploadPath, BACKUP_SUFFIX);
+
+  // f_rename does not replace, keep the old file as backup until the new
+  // one is in place
+  f_unlink(backup);
+  fr = check(f_rename(uploadPath, backup));
+  if (fr != FR_OK && fr != FR_NO_FILE)
+    return fr;
+
+  fr = check(f_rename(temp, uploadPath));
+  if (fr != FR_OK)
+  {
+    f_rename(backup, uploadPath);
+    return fr;
+  }
+
+  f_unlink(backup);
+  return FR_OK;
+}
+
+void storage_upload_abort(void)
+{
+  if (!uploadActive)
+    return;
+  uploadActive = false;
+  pending = -1;
+  fillLen = 0;
+  f_close(&uploadFile);
+
+  char temp[PATH_MAX_LEN];
+  make_path(temp, uploadPath, TEMP_SUFFIX);
+  f_unlink(temp);
+}
+
+bool storage_upload_active(void)
+{
+  return uploadActive;
+}
+
+StorageStats const *storage_upload_stats(void)
+{
+  return &stats;
+}
@@ -0,0 +1,53 @@
+#ifndef SD_STORAGE_H_
+#define SD_STORAGE_H_
+
+#include <stdint.h>
+
+#include "ff.h"
+
+// SD card access for core 1. The card is mounted once and stays mounted
+// until an operation reports it gone.
+//
+// Uploads are written to a temp file through two sector sized buffers:
+// one fills from the CDC stream while the other waits for storage_task()
+// to write it, so frames can be acknowledged before the card is busy.
+// Commit swaps the temp file in with renames, an upload that fails or is
+// cut off leaves the previous file untouched.
+
+#define STORAGE_SECTOR_SIZE 512
+
+struct StorageStats
+{
+  uint32_t bytes;     // written to the card
+  uint32_t writes;    // f_write calls
+  uint32_t writeUs;   // time spent in f_write
+};
+
+// Mounts the card if it is not mounted yet
+FRESULT storage_mount(void);
+
+// Lets go of the card, so something else may write it, see msc_disk.h
+void storage_unmount(void);
+
+// Finishes a commit of path that was cut off by a reset. Call after mounting.
+void storage_recover(char const *path);
+
+// Starts writing a new version of path. sizeHint preallocates the file
+// when non-zero.
+FRESULT storage_upload_begin(char const *path, uint32_t sizeHint);
+
+// Copies data into the sector buffers. Only writes to the card when both
+// buffers are full.
+FRESULT storage_upload_write(void const *data, uint32_t len);
+
+// Writes a full buffer if one is waiting. Errors stick until the upload ends.
+FRESULT storage_task(void);
+
+// Writes what is left and replaces path with the upload
+FRESULT storage_upload_commit(void);
+void storage_upload_abort(void);
+
+bool storage_upload_active(void);
+StorageStats const *storage_upload_stats(void);
+
+#endif /* SD_STORAGE_H_ */
@@ -0,0 +1,98 @@
+#ifndef SPSC_QUEUE_H_
+#define SPSC_QUEUE_H_
+
+#include <atomic>
+#include <stdint.h>
+
+// Lock-free single producer / single consumer ring buffer. Safe between an
+// interrupt and the main loop, or between the two cores, as long as each
+// side only ever has one caller.
+//
+// head is only written by the producer, tail only by the consumer. Both run
+// freely and are masked on access, so the queue is full at head - tail == N.
+template <typename T, uint32_t N>
+class SpscQueue
+{
+  static_assert((N & (N - 1)) == 0, "SpscQueue size must be a power of two");
+
+public:
+  // Producer side
+  bool push(T const &item)
+  {
+    uint32_t const h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) >= N)
+      return false;
+
+    items[h & (N - 1)] = item;
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  // Pushes as many as fit, returns how many did
+  uint32_t write(T const *src, uint32_t count)
+  {
+    uint32_t const h = head.load(std::memory_order_relaxed);
+    uint32_t const room = N - (h - tail.load(std::memory_order_acquire));
+    if (count > room)
+      count = room;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+      items[(h + i) & (N - 1)] = src[i];
+    }
+    head.store(h + count, std::memory_order_release);
+    return count;
+  }
+
+  uint32_t space(void) const
+  {
+    return N - (head.load(std::memory_order_relaxed) - tail.load(std::memory_order_acquire));
+  }
+
+  // Consumer side
+  bool pop(T *item)
+  {
+    if (!peek(item))
+      return false;
+    tail.store(tail.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool peek(T *item) const
+  {
+    uint32_t const t = tail.load(std::memory_order_relaxed);
+    if (head.load(std::memory_order_acquire) == t)
+      return false;
+
+    *item = items[t & (N - 1)];
+    return true;
+  }
+
+  // Pops up to max, returns how many
+  uint32_t read(T *dst, uint32_t max)
+  {
+    uint32_t const t = tail.load(std::memory_order_relaxed);
+    uint32_t count = head.load(std::memory_order_acquire) - t;
+    if (count > max)
+      count = max;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+      dst[i] = items[(t + i) & (N - 1)];
+    }
+    tail.store(t + count, std::memory_order_release);
+    return count;
+  }
+
+  bool empty(void) const
+  {
+    return head.load(std::memory_order_acquire) == tail.load(std::memory_order_relaxed);
+  }
+
+private:
+  T items[N];
+  std::atomic<uint32_t> head{0};
+  std::atomic<uint32_t> tail{0};
+};
+
+#endif /* SPSC_QUEUE_H_ */
@@ -0,0 +1,25 @@
+#include "static_arena.h"
+
+void arena_init(StaticArena *a, void *buffer, size_t size)
+{
+  a->base = (uint8_t *)buffer;
+  a->size = size;
+  a->used = 0;
+}
+
+void *arena_alloc(StaticArena *a, size_t size, size_t align)
+{
+  uintptr_t const start = ((uintptr_t)a->base + a->used + align - 1) & ~(uintptr_t)(align - 1);
+  size_t const end = (start - (uintptr_t)a->base) + size;
+
+  if (end > a->size)
+    return NULL;
+
+  a->used = end;
+  return (void *)start;
+}
+
+void arena_reset(StaticArena *a)
+{
+  a->used = 0;
+}
@@ -0,0 +1,25 @@
+#ifndef STATIC_ARENA_H_
+#define STATIC_ARENA_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bump allocator over a caller provided buffer. Everything is released at
+// once by arena_reset(), there is no per object free.
+
+struct StaticArena
+{
+  uint8_t *base;
+  size_t size;
+  size_t used;
+};
+
+void arena_init(StaticArena *a, void *buffer, size_t size);
+
+// Returns NULL when the arena is exhausted
+void *arena_alloc(StaticArena *a, size_t size, size_t align);
+void arena_reset(StaticArena *a);
+
+#define ARENA_NEW(a, T) ((T *)arena_alloc((a), sizeof(T), alignof(T)))
+
+#endif /* STATIC_ARENA_H_ */
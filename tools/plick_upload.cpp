@@ -0,0 +1,226 @@
+// Uploads data.txt to a Plick started in boot mode (first key held while
+// plugging in), using the framed protocol from cdc_protocol.h.
+//
+//   plick_upload /dev/ttyACM0 data.txt
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "cdc_protocol.h"
+#include "crc32.h"
+
+#define ACK_TIMEOUT_MS 500
+#define MAX_RETRIES 10
+
+static int port = -1;
+static FrameDecoder decoder;
+
+static double now_s(void)
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static bool open_port(char const *path)
+{
+  port = open(path, O_RDWR | O_NOCTTY);
+  if (port < 0)
+  {
+    printf("ERROR: Could not open %s (%s)\n", path, strerror(errno));
+    return false;
+  }
+
+  termios tio;
+  if (tcgetattr(port, &tio) == 0)
+  {
+    cfmakeraw(&tio);
+    tcsetattr(port, TCSANOW, &tio);
+  }
+  tcflush(port, TCIOFLUSH);
+  return true;
+}
+
+static bool send_frame(uint8_t type, uint8_t seq, void const *payload, uint16_t len)
+{
+  uint8_t out[FRAME_MAX_LEN];
+  size_t const n = frame_encode(out, type, seq, payload, len);
+  size_t sent = 0;
+  while (sent < n)
+  {
+    ssize_t const w = write(port, out + sent, n - sent);
+    if (w < 0)
+    {
+      printf("ERROR: Write failed (%s)\n", strerror(errno));
+      return false;
+    }
+    sent += w;
+  }
+  return true;
+}
+
+// Bytes of the last read not decoded yet, several frames often arrive in
+// one read
+static uint8_t received[256];
+static size_t receivedPos = 0;
+static size_t receivedLen = 0;
+
+// Waits up to timeoutMs for the next frame from the device, log text in
+// between is skipped.
+static bool receive_frame(Frame *frame, int timeoutMs)
+{
+  double const deadline = now_s() + timeoutMs / 1000.0;
+
+  while (true)
+  {
+    while (receivedPos < receivedLen)
+    {
+      if (frame_decoder_push(&decoder, received[receivedPos++]) == FRAME_READY)
+      {
+        *frame = decoder.frame;
+        return true;
+      }
+    }
+
+    int const left = (int)((deadline - now_s()) * 1000);
+    if (left <= 0)
+      return false;
+
+    pollfd pfd = { port, POLLIN, 0 };
+    if (poll(&pfd, 1, left) <= 0)
+      return false;
+
+    ssize_t const n = read(port, received, sizeof(received));
+    if (n <= 0)
+      return false;
+    receivedPos = 0;
+    receivedLen = n;
+  }
+}
+
+static int upload(std::vector<uint8_t> const &file)
+{
+  size_t const frameCount = (file.size() + FRAME_MAX_PAYLOAD - 1) / FRAME_MAX_PAYLOAD;
+
+  // Sequence numbers are 8 bit, position is tracked with the full count.
+  // Frame 0 is BEGIN, 1..frameCount are DATA, frameCount + 1 is END.
+  size_t const total = frameCount + 2;
+  size_t base = 0;
+  size_t next = 0;
+  int retries = 0;
+
+  uint8_t sizePayload[4];
+  put_u32le(sizePayload, file.size());
+  uint8_t crcPayload[4];
+  put_u32le(crcPayload, crc32(file.data(), file.size()));
+
+  while (true)
+  {
+    // Fill the window, END only goes out once all data is acknowledged so
+    // the RESULT cannot overtake an ACK.
+    while (next < total && next - base < FRAME_WINDOW && (next < total - 1 || base == next))
+    {
+      bool ok;
+      if (next == 0)
+        ok = send_frame(FRAME_BEGIN, 0, sizePayload, 4);
+      else if (next == total - 1)
+        ok = send_frame(FRAME_END, (uint8_t)next, crcPayload, 4);
+      else
+      {
+        size_t const offset = (next - 1) * FRAME_MAX_PAYLOAD;
+        size_t const len = file.size() - offset < FRAME_MAX_PAYLOAD ? file.size() - offset : FRAME_MAX_PAYLOAD;
+        ok = send_frame(FRAME_DATA, (uint8_t)next, &file[offset], len);
+      }
+      if (!ok)
+        return 1;
+      next++;
+    }
+
+    Frame reply;
+    if (!receive_frame(&reply, ACK_TIMEOUT_MS))
+    {
+      if (++retries > MAX_RETRIES)
+      {
+        printf("ERROR: No answer from device\n");
+        return 1;
+      }
+      next = base;
+      continue;
+    }
+
+    // Map the 8 bit sequence back onto the window
+    size_t const seq = base + (uint8_t)(reply.seq - (uint8_t)base);
+
+    switch (reply.type)
+    {
+    case FRAME_ACK:
+      if (seq > base && seq <= next)
+      {
+        base = seq;
+        retries = 0;
+      }
+      break;
+
+    case FRAME_NAK:
+      if (seq >= base && seq <= next)
+      {
+        base = seq;
+        next = seq;
+      }
+      break;
+
+    case FRAME_RESULT:
+      if (next != total)
+        break;
+      if (reply.len < 1 || reply.payload[0] != UPLOAD_OK)
+      {
+        printf("ERROR: Upload failed (%d)\n", reply.len ? reply.payload[0] : -1);
+        return 1;
+      }
+      return 0;
+    }
+  }
+}
+
+int main(int argc, char **argv)
+{
+  if (argc != 3)
+  {
+    printf("usage: %s <serial port> <data.txt>\n", argv[0]);
+    return 2;
+  }
+
+  FILE *f = fopen(argv[2], "rb");
+  if (!f)
+  {
+    printf("ERROR: Could not open %s (%s)\n", argv[2], strerror(errno));
+    return 1;
+  }
+  std::vector<uint8_t> file;
+  uint8_t chunk[4096];
+  size_t n;
+  while ((n = fread(chunk, 1, sizeof(chunk), f)) > 0)
+    file.insert(file.end(), chunk, chunk + n);
+  fclose(f);
+
+  if (!open_port(argv[1]))
+    return 1;
+  frame_decoder_init(&decoder);
+
+  double const start = now_s();
+  int const result = upload(file);
+  double const seconds = now_s() - start;
+  close(port);
+
+  if (result == 0)
+    printf("%zu bytes in %.2f s (%.1f KB/s)\n", file.size(), seconds, file.size() / 1024.0 / seconds);
+  return result;
+}
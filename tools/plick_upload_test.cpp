@@ -0,0 +1,153 @@
+// Runs plick_upload against a pseudo terminal standing in for the device.
+// The device answers every burst of frames with one write, so several
+// ACKs and the RESULT arrive in one read on the host side. The upload has
+// to get through without a single ACK timeout.
+//
+//   plick_upload_test <path to plick_upload>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "cdc_protocol.h"
+#include "crc32.h"
+
+#define TEST_FILE_BYTES 10000
+#define TEST_MAX_SECONDS 0.4  // below plick_upload's ACK timeout
+
+static double now_s(void)
+{
+  timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+static void add_frame(std::vector<uint8_t> *out, uint8_t type, uint8_t seq, void const *payload, uint16_t len)
+{
+  uint8_t frame[FRAME_MAX_LEN];
+  size_t const n = frame_encode(frame, type, seq, payload, len);
+  out->insert(out->end(), frame, frame + n);
+}
+
+int main(int argc, char **argv)
+{
+  if (argc != 2)
+  {
+    printf("usage: %s <path to plick_upload>\n", argv[0]);
+    return 2;
+  }
+
+  std::vector<uint8_t> file(TEST_FILE_BYTES);
+  for (size_t i = 0; i < file.size(); i++)
+    file[i] = (uint8_t)(i * 7 + i / 251);
+
+  char path[] = "/tmp/plick_upload_test_XXXXXX";
+  int const fd = mkstemp(path);
+  if (fd < 0 || write(fd, file.data(), file.size()) != (ssize_t)file.size())
+  {
+    printf("ERROR: Could not write %s\n", path);
+    return 1;
+  }
+  close(fd);
+
+  int const master = posix_openpt(O_RDWR | O_NOCTTY);
+  if (master < 0 || grantpt(master) != 0 || unlockpt(master) != 0)
+  {
+    printf("ERROR: No pseudo terminal\n");
+    return 1;
+  }
+
+  double const start = now_s();
+  pid_t const child = fork();
+  if (child == 0)
+  {
+    execl(argv[1], argv[1], ptsname(master), path, (char *)NULL);
+    _exit(127);
+  }
+
+  // The device side
+  FrameDecoder decoder;
+  frame_decoder_init(&decoder);
+  std::vector<uint8_t> received;
+  uint32_t size = 0;
+  size_t expected = 0;
+  bool done = false;
+  bool ok = false;
+
+  while (!done && now_s() - start < 5)
+  {
+    pollfd pfd = { master, POLLIN, 0 };
+    if (poll(&pfd, 1, 100) <= 0)
+      continue;
+    usleep(2000);  // let the whole window arrive
+
+    uint8_t bytes[4096];
+    ssize_t const n = read(master, bytes, sizeof(bytes));
+    if (n <= 0)
+      break;
+
+    std::vector<uint8_t> replies;
+    for (ssize_t i = 0; i < n; i++)
+    {
+      if (frame_decoder_push(&decoder, bytes[i]) != FRAME_READY)
+        continue;
+      Frame const &f = decoder.frame;
+      if (f.seq != (uint8_t)expected)
+      {
+        add_frame(&replies, FRAME_NAK, (uint8_t)expected, NULL, 0);
+        continue;
+      }
+
+      expected++;
+      if (f.type == FRAME_BEGIN && f.len == 4)
+        size = get_u32le(f.payload);
+      else if (f.type == FRAME_DATA)
+        received.insert(received.end(), f.payload, f.payload + f.len);
+      add_frame(&replies, FRAME_ACK, (uint8_t)expected, NULL, 0);
+
+      if (f.type == FRAME_END && f.len == 4)
+      {
+        ok = received.size() == size && get_u32le(f.payload) == crc32(received.data(), received.size());
+        uint8_t const status = ok ? UPLOAD_OK : UPLOAD_ERR_CRC;
+        add_frame(&replies, FRAME_RESULT, (uint8_t)expected, &status, 1);
+        done = true;
+      }
+    }
+    if (!replies.empty() && write(master, replies.data(), replies.size()) != (ssize_t)replies.size())
+      break;
+  }
+
+  int status = 0;
+  if (!done)
+    kill(child, SIGKILL);
+  waitpid(child, &status, 0);
+  double const seconds = now_s() - start;
+  close(master);
+  unlink(path);
+
+  if (!done || !ok || received != file)
+  {
+    printf("FAIL: upload incomplete or damaged\n");
+    return 1;
+  }
+  if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+  {
+    printf("FAIL: plick_upload exited with %d\n", WIFEXITED(status) ? WEXITSTATUS(status) : -1);
+    return 1;
+  }
+  if (seconds > TEST_MAX_SECONDS)
+  {
+    printf("FAIL: upload took %.3f s, an ACK or the RESULT was lost\n", seconds);
+    return 1;
+  }
+  printf("%zu bytes in %.3f s\n", file.size(), seconds);
+  return 0;
+}
@@ -94,12 +94,19 @@ extern "C"
 //------------- CLASS -------------//
 #define CFG_TUD_HID 1
 #define CFG_TUD_CDC 1
-#define CFG_TUD_MSC 0
+// SD card as a USB drive, see msc_disk.h
+#ifndef PLICK_MSC
+#define PLICK_MSC 1
+#endif
+#define CFG_TUD_MSC PLICK_MSC
 #define CFG_TUD_MIDI 0
 #define CFG_TUD_VENDOR 0
 
 // HID buffer size Should be sufficient to hold ID (if any) + Data
-#define CFG_TUD_HID_EP_BUFSIZE 16
+#define CFG_TUD_HID_EP_BUFSIZE 32
+
+// MSC chunk handed to core 1 at once, see MSC_TRANSFER_BYTES
+#define CFG_TUD_MSC_EP_BUFSIZE 4096
 
 // CDC FIFO size of TX and RX
 #define CFG_TUD_CDC_RX_BUFSIZE   (TUD_OPT_HIGH_SPEED ? 512 : 64)
@@ -0,0 +1,89 @@
+#include "type_encoder.h"
+#include "hid_keycodes.h"
+
+#define MAX_GROUP 6
+#define SHIFT_USAGE 0xE1
+
+// Keys of the group of characters starting at pos, returns how many
+// characters it covers
+static uint16_t next_group(TypeEncoder const *e, uint16_t pos, uint8_t *keycodes, uint8_t *count, bool *shift)
+{
+  uint16_t const start = pos;
+  *count = 0;
+
+  for (; pos < e->len && *count < MAX_GROUP; pos++)
+  {
+    uint8_t keycode;
+    bool needsShift;
+    if (!hid_ascii_lookup(e->text[pos], &keycode, &needsShift))
+    {
+      // Unknown characters are dropped, unless the group is empty
+      if (*count == 0)
+        continue;
+      break;
+    }
+
+    if (*count)
+    {
+      if (needsShift != *shift || keycode <= keycodes[*count - 1])
+        break;
+    }
+    *shift = needsShift;
+    keycodes[(*count)++] = keycode;
+  }
+  return pos - start;
+}
+
+void type_encoder_init(TypeEncoder *e, char const *text, uint16_t len)
+{
+  e->text = text;
+  e->len = len;
+  e->pos = 0;
+  keyboard_state_clear(&e->keys);
+}
+
+bool type_encoder_next(TypeEncoder *e, KeyboardState *report)
+{
+  uint8_t keycodes[MAX_GROUP];
+  uint8_t count = 0;
+  bool shift = false;
+  uint16_t const used = next_group(e, e->pos, keycodes, &count, &shift);
+
+  if (count == 0)
+  {
+    // Text done, let go of the last group
+    e->pos = e->len;
+    if (keyboard_state_empty(&e->keys))
+      return false;
+    keyboard_state_clear(&e->keys);
+    *report = e->keys;
+    return true;
+  }
+
+  bool const shiftDown = keyboard_state_has(&e->keys, SHIFT_USAGE);
+  bool release = shiftDown != shift;
+  for (uint8_t i = 0; i < count && !release; i++)
+    release = keyboard_state_has(&e->keys, keycodes[i]);
+
+  // Keys still down from the last report
+  bool keysDown = false;
+  for (int i = 0; i < (SHIFT_USAGE >> 3) && !keysDown; i++)
+    keysDown = e->keys.usage[i] != 0;
+
+  keyboard_state_clear(&e->keys);
+  if (shift)
+    keyboard_state_add(&e->keys, SHIFT_USAGE);
+
+  if (release && keysDown)
+  {
+    // Release report with the new shift state, the group follows next time
+    *report = e->keys;
+    return true;
+  }
+
+  for (uint8_t i = 0; i < count; i++)
+    keyboard_state_add(&e->keys, keycodes[i]);
+  e->pos += used;
+  *report = e->keys;
+  return true;
+}
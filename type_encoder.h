@@ -0,0 +1,36 @@
+#ifndef TYPE_ENCODER_H_
+#define TYPE_ENCODER_H_
+
+#include <stdint.h>
+
+#include "keyboard_report.h"
+
+// Turns text into the shortest keyboard report stream that types it.
+//
+// Consecutive characters that need the same shift state share one report,
+// up to 6 of them, as long as each key is new. The host presses the keys of
+// a report in usage order (bitmap bit order in NKRO, array order in boot
+// reports, which are built sorted), so the usages of one report must also
+// be ascending to keep the characters in order.
+//
+// The next group replaces the previous one directly, the released keys and
+// the new ones arrive in the same report. A release-only report is inserted
+// only where the next group needs a key that is still down, or where the
+// shift state changes; that report already carries the new shift.
+
+struct TypeEncoder
+{
+  char const *text;
+  uint16_t len;
+  uint16_t pos;
+  KeyboardState keys;  // last report handed out
+};
+
+void type_encoder_init(TypeEncoder *e, char const *text, uint16_t len);
+
+// Fills report with the next report to send. Returns false once the text is
+// typed and every key is released again. Characters hid_ascii_lookup() does
+// not know are skipped.
+bool type_encoder_next(TypeEncoder *e, KeyboardState *report);
+
+#endif /* TYPE_ENCODER_H_ */
@@ -74,9 +74,57 @@ uint8_t const * tud_descriptor_device_cb(void)
 // HID Report Descriptor
 //--------------------------------------------------------------------+
 
+// NKRO keyboard: modifier byte followed by one bit per usage 0x00 - 0xDF,
+// see keyboard_report.h. Boot protocol hosts ignore this descriptor and get
+// the fixed 8 byte boot report instead.
+#define TUD_HID_REPORT_DESC_NKRO_KEYBOARD(...) \
+  HID_USAGE_PAGE ( HID_USAGE_PAGE_DESKTOP                 )                    ,\
+  HID_USAGE      ( HID_USAGE_DESKTOP_KEYBOARD             )                    ,\
+  HID_COLLECTION ( HID_COLLECTION_APPLICATION             )                    ,\
+    /* Report ID if any */\
+    __VA_ARGS__ \
+    /* 8 bits Modifier Keys (Shift, Control, Alt) */ \
+    HID_USAGE_PAGE ( HID_USAGE_PAGE_KEYBOARD )                                 ,\
+      HID_USAGE_MIN    ( 224                                    )              ,\
+      HID_USAGE_MAX    ( 231                                    )              ,\
+      HID_LOGICAL_MIN  ( 0                                      )              ,\
+      HID_LOGICAL_MAX  ( 1                                      )              ,\
+      HID_REPORT_COUNT ( 8                                      )              ,\
+      HID_REPORT_SIZE  ( 1                                      )              ,\
+      HID_INPUT        ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE )              ,\
+    /* One bit per keycode */ \
+    HID_USAGE_PAGE ( HID_USAGE_PAGE_KEYBOARD )                                 ,\
+      HID_USAGE_MIN    ( 0                                      )              ,\
+      HID_USAGE_MAX    ( 0xDF                                   )              ,\
+      HID_LOGICAL_MIN  ( 0                                      )              ,\
+      HID_LOGICAL_MAX  ( 1                                      )              ,\
+      HID_REPORT_COUNT ( 224                                    )              ,\
+      HID_REPORT_SIZE  ( 1                                      )              ,\
+      HID_INPUT        ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE )              ,\
+    /* 5-bit LED Indicator Kana | Compose | ScrollLock | CapsLock | NumLock */ \
+    HID_USAGE_PAGE  ( HID_USAGE_PAGE_LED                   )                   ,\
+      HID_USAGE_MIN    ( 1                                       )             ,\
+      HID_USAGE_MAX    ( 5                                       )             ,\
+      HID_REPORT_COUNT ( 5                                       )             ,\
+      HID_REPORT_SIZE  ( 1                                       )             ,\
+      HID_OUTPUT       ( HID_DATA | HID_VARIABLE | HID_ABSOLUTE  )             ,\
+      /* led padding */ \
+      HID_REPORT_COUNT ( 1                                       )             ,\
+      HID_REPORT_SIZE  ( 3                                       )             ,\
+      HID_OUTPUT       ( HID_CONSTANT                            )             ,\
+  HID_COLLECTION_END \
+
+// One report per report ID, see report_scheduler.h
 uint8_t const desc_hid_report[] =
 {
-  TUD_HID_REPORT_DESC_KEYBOARD(),
+#if PLICK_NKRO
+  TUD_HID_REPORT_DESC_NKRO_KEYBOARD(HID_REPORT_ID(REPORT_ID_KEYBOARD)),
+#else
+  TUD_HID_REPORT_DESC_KEYBOARD(HID_REPORT_ID(REPORT_ID_KEYBOARD)),
+#endif
+  TUD_HID_REPORT_DESC_MOUSE(HID_REPORT_ID(REPORT_ID_MOUSE)),
+  TUD_HID_REPORT_DESC_CONSUMER(HID_REPORT_ID(REPORT_ID_CONSUMER_CONTROL)),
+  TUD_HID_REPORT_DESC_GAMEPAD(HID_REPORT_ID(REPORT_ID_GAMEPAD)),
 };
 
 // Invoked when received GET HID REPORT DESCRIPTOR
@@ -98,7 +146,12 @@ uint8_t const * tud_hid_descriptor_report_cb(uint8_t instance)
 //   ITF_NUM_TOTAL
 // };
 
-#define  CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_HID_DESC_LEN)
+#define  ITF_NUM_TOTAL     (ITF_NUM_MSC + CFG_TUD_MSC)
+#define  CONFIG_TOTAL_LEN  (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_HID_DESC_LEN + CFG_TUD_MSC * TUD_MSC_DESC_LEN)
+
+// bInterval is the last byte of the keyboard endpoint descriptor, the SD
+// card drive comes after it
+#define  KEYBOARD_INTERVAL_OFFSET  (TUD_CONFIG_DESC_LEN + TUD_CDC_DESC_LEN + TUD_HID_DESC_LEN - 1)
 
 // #define EPNUM_HID   0x81
 
@@ -109,6 +162,8 @@ uint8_t const * tud_hid_descriptor_report_cb(uint8_t instance)
   #define EPNUM_CDC_IN     2
   #define EPNUM_CDC_OUT    2
   #define EPNUM_KEYBOARD   4
+  #define EPNUM_MSC_OUT    5
+  #define EPNUM_MSC_IN     5
 #elif CFG_TUSB_MCU == OPT_MCU_SAMG || CFG_TUSB_MCU ==  OPT_MCU_SAMX7X
   // SAMG & SAME70 don't support a same endpoint number with different direction IN and OUT
   //    e.g EP1 OUT & EP1 IN cannot exist together
@@ -116,11 +171,15 @@ uint8_t const * tud_hid_descriptor_report_cb(uint8_t instance)
   #define EPNUM_CDC_IN     2
   #define EPNUM_CDC_OUT    3
   #define EPNUM_KEYBOARD   6
+  #define EPNUM_MSC_OUT    4
+  #define EPNUM_MSC_IN     5
 #else
   #define EPNUM_CDC_NOTIF  1
   #define EPNUM_CDC_IN     2
   #define EPNUM_CDC_OUT    2
   #define EPNUM_KEYBOARD   4
+  #define EPNUM_MSC_OUT    3
+  #define EPNUM_MSC_IN     3
 #endif
 
 uint8_t const desc_configuration[] =
@@ -136,9 +195,37 @@ uint8_t const desc_configuration[] =
   // Interface number, string index, EP notification address and size, EP data address (out, in) and size.
   TUD_CDC_DESCRIPTOR(ITF_NUM_CDC, 4, 0x80 | EPNUM_CDC_NOTIF, 8, EPNUM_CDC_OUT, 0x80 | EPNUM_CDC_IN, TUD_OPT_HIGH_SPEED ? 512 : 64),
   // Interface number, string index, protocol, report descriptor len, EP In address, size & polling interval
-  TUD_HID_DESCRIPTOR(ITF_NUM_KEYBOARD, 5, HID_ITF_PROTOCOL_NONE, sizeof(desc_hid_report), 0x80 | EPNUM_KEYBOARD, CFG_TUD_HID_EP_BUFSIZE, 10)
+  // Boot subclass keeps the keyboard usable in BIOS setup with either report layout
+  TUD_HID_DESCRIPTOR(ITF_NUM_KEYBOARD, 5, HID_ITF_PROTOCOL_KEYBOARD, sizeof(desc_hid_report), 0x80 | EPNUM_KEYBOARD, CFG_TUD_HID_EP_BUFSIZE, PLICK_POLL_MS),
+#if CFG_TUD_MSC
+  // Interface number, string index, EP Out & EP In address, EP size
+  TUD_MSC_DESCRIPTOR(ITF_NUM_MSC, 6, EPNUM_MSC_OUT, 0x80 | EPNUM_MSC_IN, TUD_OPT_HIGH_SPEED ? 512 : 64),
+#endif
 };
 
+_Static_assert(PLICK_POLL_MS == 1 || PLICK_POLL_MS == 2 || PLICK_POLL_MS == 4 || PLICK_POLL_MS == 8 || PLICK_POLL_MS == 10,
+               "PLICK_POLL_MS must be 1, 2, 4, 8 or 10");
+
+// Copy handed to the host, with the polling interval the keymap asks for
+static uint8_t desc_configuration_ram[sizeof(desc_configuration)];
+static uint8_t poll_interval_ms = PLICK_POLL_MS;
+
+bool usb_poll_interval_valid(uint8_t ms)
+{
+  return ms == 1 || ms == 2 || ms == 4 || ms == 8 || ms == 10;
+}
+
+void usb_set_poll_interval(uint8_t ms)
+{
+  if (usb_poll_interval_valid(ms))
+    poll_interval_ms = ms;
+}
+
+uint8_t usb_poll_interval(void)
+{
+  return poll_interval_ms;
+}
+
 // Invoked when received GET CONFIGURATION DESCRIPTOR
 // Application return pointer to descriptor
 // Descriptor contents must exist long enough for transfer to complete
@@ -147,7 +234,9 @@ uint8_t const * tud_descriptor_configuration_cb(uint8_t index)
   (void) index; // for multiple configurations
 
   // This example use the same configuration for both high and full speed mode
-  return desc_configuration;
+  memcpy(desc_configuration_ram, desc_configuration, sizeof(desc_configuration));
+  desc_configuration_ram[KEYBOARD_INTERVAL_OFFSET] = poll_interval_ms;
+  return desc_configuration_ram;
 }
 
 //--------------------------------------------------------------------+
@@ -162,7 +251,8 @@ char const* string_desc_arr [] =
   "TinyUSB Device",              // 2: Product
   (char[20]) {},                 // 3: Serials, should use chip ID
   "TinyUSB CDC",                 // 4: CDC Interface
-  "TinyUSB Keyboard"             // 6: HIDs Interface
+  "TinyUSB Keyboard",            // 5: HIDs Interface
+  "TinyUSB SD Card"              // 6: MSC Interface
 };
 
 static uint16_t _desc_str[32];
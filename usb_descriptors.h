@@ -1,6 +1,32 @@
 #ifndef USB_DESCRIPTORS_H_
 #define USB_DESCRIPTORS_H_
 
+// 1: report protocol uses an NKRO bitmap, 0: 6 key boot layout everywhere
+#ifndef PLICK_NKRO
+#define PLICK_NKRO 1
+#endif
+
+// Keyboard endpoint polling interval in ms, the keymap can override it
+#ifndef PLICK_POLL_MS
+#define PLICK_POLL_MS 1
+#endif
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// 1, 2, 4, 8 and 10 ms are supported. Takes effect on the next enumeration.
+bool usb_poll_interval_valid(uint8_t ms);
+void usb_set_poll_interval(uint8_t ms);
+uint8_t usb_poll_interval(void);
+
+#ifdef __cplusplus
+}
+#endif
+
 enum
 {
   REPORT_ID_KEYBOARD = 1,
@@ -15,7 +41,7 @@ enum
   ITF_NUM_CDC = 0,
   ITF_NUM_CDC_DATA,
   ITF_NUM_KEYBOARD,
-  ITF_NUM_TOTAL
+  ITF_NUM_MSC,  // with CFG_TUD_MSC only, see ITF_NUM_TOTAL
 };
 
 enum